@@ -0,0 +1,119 @@
+/**
+ * arena.c - 요청 단위 아레나와 그 풀
+ *   - arena_acquire: 풀에서 하나 꺼냄 (비었을 때만 새로 Malloc)
+ *   - arena_alloc: 기본 블록에서 bump, 모자라면 그 할당만 따로 Malloc
+ *   - arena_release: 넘친 할당만 해제하고 비운 아레나를 풀에 돌려줌
+ * 요청마다 Malloc한 바이트를 집계 ==> 풀이 데워진 뒤에는 요청당 0에 가까워야 정상.
+ */
+#include "arena.h"
+
+static struct {
+    pthread_mutex_t lock;
+    arena_t* free_list;
+    int pooled; // free_list 길이
+    int created; // 지금 살아 있는 아레나 수 (풀 + 사용 중)
+    // 통계 (lock 보호) - 요청 하나 = acquire부터 release까지
+    unsigned long requests;
+    unsigned long used_bytes; // 요청별 peak의 합
+    unsigned long malloced_bytes; // 요청별 malloced의 합
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+arena_t* arena_acquire(void) {
+    arena_t* arena;
+
+    pthread_mutex_lock(&pool.lock);
+    if ((arena = pool.free_list) != NULL) {
+        pool.free_list = arena->next;
+        pool.pooled--;
+    } else {
+        pool.created++;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (arena == NULL) {
+        arena = Malloc(sizeof(arena_t));
+        arena->base = Malloc(ARENA_SIZE);
+        arena->used = arena->peak = 0;
+        arena->extra = NULL;
+        arena->malloced = sizeof(arena_t) + ARENA_SIZE;
+    }
+    arena->next = NULL;
+    return arena;
+}
+
+/**
+ * arena_release - 요청이 끝남. 아레나에서 받은 포인터는 이제 모두 무효.
+ */
+void arena_release(arena_t* arena) {
+    while (arena->extra) {
+        arena_extra_t* extra = arena->extra;
+        arena->extra = extra->next;
+        Free(extra);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.requests++;
+    pool.used_bytes += arena->peak;
+    pool.malloced_bytes += arena->malloced;
+    arena->used = arena->peak = arena->malloced = 0;
+    if (pool.pooled < ARENA_POOL_MAX) {
+        arena->next = pool.free_list;
+        pool.free_list = arena;
+        pool.pooled++;
+        arena = NULL;
+    } else {
+        pool.created--;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (arena) {
+        Free(arena->base);
+        Free(arena);
+    }
+}
+
+/**
+ * arena_alloc - size 바이트 (ARENA_ALIGN 정렬). 내용은 초기화하지 않음.
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size <= ARENA_SIZE - arena->used) {
+        void* p = arena->base + arena->used;
+        arena->used += size;
+        if (arena->used > arena->peak)
+            arena->peak = arena->used;
+        return p;
+    }
+
+    arena_extra_t* extra = Malloc(sizeof(arena_extra_t) + size);
+    extra->next = arena->extra;
+    arena->extra = extra;
+    arena->malloced += sizeof(arena_extra_t) + size;
+    return extra->data;
+}
+
+/**
+ * arena_mark / arena_reset_to - 잠깐 쓰고 버릴 버퍼용. mark 이후 기본 블록에서 받은 자리를 다시 씀
+ * (넘친 할당은 release 때 해제).
+ */
+size_t arena_mark(arena_t* arena) {
+    return arena->used;
+}
+
+void arena_reset_to(arena_t* arena, size_t mark) {
+    arena->used = mark;
+}
+
+/**
+ * arena_print_stats - 요청당 아레나 사용량과 Malloc 바이트
+ */
+void arena_print_stats(void) {
+    pthread_mutex_lock(&pool.lock);
+    unsigned long requests = pool.requests ? pool.requests : 1;
+    printf("Arena: %lu requests, %.1f KB used/request, %.1f B malloc'd/request, %d arenas (%d pooled)\n",
+           pool.requests, pool.used_bytes / 1024.0 / requests, (double)pool.malloced_bytes / requests,
+           pool.created, pool.pooled);
+    pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,36 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include "csapp.h"
+
+#define ARENA_SIZE (256<<10) // 기본 블록 크기 - 요청 구조체 + 중계 버퍼 + 캐시 조립 버퍼가 들어가는 정도
+#define ARENA_ALIGN 16
+#define ARENA_POOL_MAX 64 // 풀에 남겨둘 최대 아레나 수 (넘게 반납되면 해제 ==> 동시 연결이 줄면 메모리도 돌려줌)
+
+// 기본 블록에 안 들어간 할당 - 따로 Malloc, arena_release 때 해제
+typedef struct arena_extra {
+    struct arena_extra* next;
+    _Alignas(ARENA_ALIGN) char data[]; // arena_alloc이 약속한 정렬 그대로 (헤더 뒤 패딩)
+} arena_extra_t;
+
+/**
+ * 요청 하나 동안 쓰는 bump-pointer 아레나 - 할당은 포인터 증가뿐이고 해제는 요청이 끝날 때 한 번에.
+ * 연결마다 스레드가 새로 뜨므로 스레드별 버퍼 대신 아레나를 풀에서 빌려 쓰고 돌려줌 (Malloc 없이 재사용).
+ */
+typedef struct arena {
+    struct arena* next; // 풀 리스트
+    char* base; // ARENA_SIZE 블록
+    size_t used;
+    size_t peak; // 이번 요청에서 기본 블록을 가장 많이 쓴 양 (arena_reset_to로 되돌려도 남음)
+    size_t malloced; // 이번 요청 동안 Malloc한 바이트 (새 아레나 + 넘친 할당)
+    arena_extra_t* extra;
+} arena_t;
+
+arena_t* arena_acquire(void);
+void arena_release(arena_t* arena);
+void* arena_alloc(arena_t* arena, size_t size);
+size_t arena_mark(arena_t* arena);
+void arena_reset_to(arena_t* arena, size_t mark);
+void arena_print_stats(void);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * coro_bench.c - 코루틴 모드의 문맥 교환 비용과 연결당 메모리를 스레드 모드와 비교
+ *   1) 교환 비용: swapcontext 왕복, coro_yield 왕복 (스케줄러 한 바퀴 + epoll_wait(0) 포함),
+ *      스레드 두 개가 세마포어로 주고받는 왕복
+ *   2) 연결당 메모리: 요청 버퍼(MAXLINE)만큼 스택을 쓰고 대기하는 코루틴/스레드를 N개 띄운 뒤
+ *      VmRSS와 커널 스택(/proc/meminfo KernelStack) 증가량을 N으로 나눔
+ *
+ * 빌드: make bench (coro.c의 가로채기가 필요하므로 CORO_WRAP으로 링크)
+ * 사용: bench/coro_bench [연결 수 (기본 2000)]
+ */
+#include "coro.h"
+
+#define BENCH_SWITCHES 1000000 // 교환 비용 측정 반복 수
+#define BENCH_PARK_MS 3600000 // 메모리 측정 동안 코루틴이 잠드는 시간 (끝날 때까지)
+
+static volatile int yield_done;
+static volatile int parked;
+static sem_t ping, pong;
+static sem_t hold; // 메모리 측정용 스레드들이 끝까지 기다리는 세마포어
+static ucontext_t main_ctx, peer_ctx;
+static char peer_stack[CORO_STACK_SIZE];
+
+static long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/**
+ * status_kb - /proc 파일에서 "name:" 줄의 값 (KB), 없으면 -1
+ */
+static long status_kb(const char *path, const char *name) {
+    char line[MAXLINE];
+    size_t len = strlen(name);
+    long kb = -1;
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+        if (strncmp(line, name, len) == 0 && line[len] == ':') {
+            kb = strtol(line + len + 1, NULL, 10);
+            break;
+        }
+    fclose(fp);
+    return kb;
+}
+
+static void peer_loop(void) {
+    for (;;)
+        swapcontext(&peer_ctx, &main_ctx);
+}
+
+static void yielder(void *arg) {
+    long t0 = now_ns();
+
+    for (int i = 0; i < BENCH_SWITCHES; ++i)
+        coro_yield();
+    printf("%-32s %6.0f ns\n", "coro_yield round trip:", (double)(now_ns() - t0) / BENCH_SWITCHES);
+    yield_done = 1;
+}
+
+static void *ponger(void *arg) {
+    for (int i = 0; i < BENCH_SWITCHES / 10; ++i) {
+        sem_wait(&ping);
+        sem_post(&pong);
+    }
+    return NULL;
+}
+
+/**
+ * touch_request_buffer - client_handler처럼 요청 버퍼 하나만큼 스택을 씀
+ */
+static void touch_request_buffer(void) {
+    char buf[MAXLINE];
+
+    memset(buf, 'x', sizeof(buf));
+    __asm__ volatile("" : : "r"(buf) : "memory"); // 최적화로 지워지지 않게
+}
+
+static void parked_coro(void *arg) {
+    touch_request_buffer();
+    __sync_fetch_and_add(&parked, 1);
+    coro_sleep(BENCH_PARK_MS);
+}
+
+static void *parked_thread(void *arg) {
+    touch_request_buffer();
+    __sync_fetch_and_add(&parked, 1);
+    sem_wait(&hold);
+    return NULL;
+}
+
+static void wait_parked(int n) {
+    while (parked < n)
+        usleep(1000);
+    usleep(100000);
+}
+
+static void report_memory(const char *what, int n, long rss0, long ks0) {
+    long rss = status_kb("/proc/self/status", "VmRSS") - rss0;
+    long ks = status_kb("/proc/meminfo", "KernelStack") - ks0;
+
+    printf("%-7s x %d: RSS +%ld KB (%.1f KB/conn), kernel stacks +%ld KB (%.1f KB/conn)\n",
+           what, n, rss, (double)rss / n, ks, (double)ks / n);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 2000;
+    pthread_t tid;
+    long t0, rss0, ks0;
+
+    if (n <= 0) {
+        fprintf(stderr, "usage: %s [connections]\n", argv[0]);
+        exit(1);
+    }
+
+    /* 1) 교환 비용 */
+    getcontext(&peer_ctx);
+    peer_ctx.uc_stack.ss_sp = peer_stack;
+    peer_ctx.uc_stack.ss_size = sizeof(peer_stack);
+    makecontext(&peer_ctx, peer_loop, 0);
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SWITCHES; ++i)
+        swapcontext(&main_ctx, &peer_ctx);
+    printf("%-32s %6.0f ns\n", "swapcontext round trip:", (double)(now_ns() - t0) / BENCH_SWITCHES);
+
+    coro_start(1, 0);
+    coro_submit(yielder, NULL);
+    while (!yield_done)
+        usleep(1000);
+
+    Sem_init(&ping, 0, 0);
+    Sem_init(&pong, 0, 0);
+    Pthread_create(&tid, NULL, ponger, NULL);
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SWITCHES / 10; ++i) {
+        sem_post(&ping);
+        sem_wait(&pong);
+    }
+    printf("%-32s %6.0f ns\n", "thread sem ping-pong round trip:", (double)(now_ns() - t0) / (BENCH_SWITCHES / 10));
+    Pthread_join(tid, NULL);
+
+    /* 2) 연결당 메모리 (같은 프로세스에서 코루틴 먼저, 스레드는 그 위에 더해서 잼) */
+    rss0 = status_kb("/proc/self/status", "VmRSS");
+    ks0 = status_kb("/proc/meminfo", "KernelStack");
+    for (int i = 0; i < n; ++i)
+        coro_submit(parked_coro, NULL);
+    wait_parked(n);
+    report_memory("coro", n, rss0, ks0);
+
+    parked = 0;
+    Sem_init(&hold, 0, 0);
+    rss0 = status_kb("/proc/self/status", "VmRSS");
+    ks0 = status_kb("/proc/meminfo", "KernelStack");
+    for (int i = 0; i < n; ++i) {
+        Pthread_create(&tid, NULL, parked_thread, NULL);
+        Pthread_detach(tid);
+    }
+    wait_parked(n);
+    report_memory("thread", n, rss0, ks0);
+
+    coro_print_stats();
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * prefork_bench.c - 프록시에 동시 연결 N개로 정해진 시간 동안 요청을 계속 보내 처리량을 잼 (proxy-multiprocess 비교용)
+ *   - 클라이언트 스레드마다 연결 하나씩: connect + 요청 + EOF까지 읽기 + close를 시간이 다 될 때까지 반복
+ *   - 응답 상태 줄이 200이면 성공, 연결 실패나 다른 상태는 오류로 셈
+ * prefork(기본값) / 요청마다 fork(PROXY_PREFORK_WORKERS=0)를 띄워 비교하는 건 bench/prefork_bench.sh.
+ *
+ * 빌드: make bench
+ * 사용: bench/prefork_bench <프록시 포트> <URL> [동시 연결 수 (기본 16)] [초 (기본 5)]
+ */
+#include "csapp.h"
+
+#define BENCH_MAX_CLIENTS 256
+
+static struct sockaddr_in addr;
+static char req[MAXLINE];
+static size_t req_len;
+static long deadline_us;
+static long ok, errors;
+
+static long now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/**
+ * fetch_once - 새 연결로 요청 하나를 보내고 응답을 끝까지 읽음
+ * @return 200 응답을 끝까지 받았으면 1
+ */
+static int fetch_once(void) {
+    char buf[MAXBUF];
+    ssize_t n;
+    int good = -1;
+    int fd = Socket(AF_INET, SOCK_STREAM, 0);
+
+    if (connect(fd, (SA *)&addr, sizeof(addr)) < 0 || write(fd, req, req_len) != (ssize_t)req_len) {
+        Close(fd);
+        return 0;
+    }
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        if (good < 0)
+            good = n >= 12 && strncmp(buf, "HTTP/1.0 200", 12) == 0; // 상태 줄은 첫 read에 들어옴
+    Close(fd);
+    return n == 0 && good == 1;
+}
+
+static void *client_thread(void *arg) {
+    while (now_us() < deadline_us) {
+        if (fetch_once())
+            __sync_fetch_and_add(&ok, 1);
+        else
+            __sync_fetch_and_add(&errors, 1);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    pthread_t tids[BENCH_MAX_CLIENTS];
+    int clients, secs;
+    long start;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <proxy port> <url> [clients] [seconds]\n", argv[0]);
+        exit(1);
+    }
+    clients = argc > 3 ? atoi(argv[3]) : 16;
+    secs = argc > 4 ? atoi(argv[4]) : 5;
+    if (clients <= 0 || clients > BENCH_MAX_CLIENTS || secs <= 0)
+        app_error("prefork_bench: clients must be 1..256 and seconds positive");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(argv[1]));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    req_len = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\n\r\n", argv[2]);
+
+    if (!fetch_once()) // 오리진까지 닿는지 먼저 확인
+        app_error("prefork_bench: first request failed (is the proxy / origin up?)");
+    start = now_us();
+    deadline_us = start + secs * 1000000L;
+    for (int i = 0; i < clients; ++i)
+        Pthread_create(&tids[i], NULL, client_thread, NULL);
+    for (int i = 0; i < clients; ++i)
+        Pthread_join(tids[i], NULL);
+
+    printf("%d clients x %d s: %.0f req/s (%ld ok, %ld errors)\n", clients, secs,
+           ok * 1e6 / (now_us() - start), ok, errors);
+    return errors != 0;
+}
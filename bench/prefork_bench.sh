@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# prefork_bench.sh - proxy-multiprocess의 prefork 워커(기본값)와 예전 요청마다 fork(PROXY_PREFORK_WORKERS=0)를 같은 조건으로 비교
+#   tiny와 proxy-multiprocess를 빈 포트에 띄우고 bench/prefork_bench로 동시 연결 N개를 정해진 시간 동안 보냄.
+#   proxy-multiprocess는 캐시가 없으므로 요청마다 tiny까지 감 (차이는 fork 비용 + select 루프 직렬화).
+#
+# 사용: bench/prefork_bench.sh [동시 연결 수 (기본 16)] [초 (기본 5)] (저장소 최상위에서, make proxy-multiprocess bench 후)
+#
+
+CLIENTS=${1:-16}
+SECS=${2:-5}
+OBJECT=home.html
+
+if [ ! -x ./proxy-multiprocess ] || [ ! -x ./tiny/tiny ] || [ ! -x ./bench/prefork_bench ]; then
+    echo "Error: build first (make proxy-multiprocess bench, cd tiny && make)"
+    exit 1
+fi
+
+tiny_port=`./free-port.sh`
+cd ./tiny
+./tiny ${tiny_port} &> /dev/null &
+tiny_pid=$!
+cd ..
+sleep 0.5
+
+# run_proxy <이름> [환경 변수...] - 그 설정으로 프록시를 띄워 측정하고 내림
+run_proxy() {
+    local name=$1
+    shift
+    local proxy_port=`./free-port.sh`
+
+    env "$@" ./proxy-multiprocess ${proxy_port} &> /dev/null &
+    local proxy_pid=$!
+    sleep 0.5
+    echo "== ${name}"
+    ./bench/prefork_bench ${proxy_port} http://localhost:${tiny_port}/${OBJECT} ${CLIENTS} ${SECS}
+    kill ${proxy_pid} # SIGTERM - 셸이 띄운 백그라운드 작업은 SIGINT를 무시한 채로 시작함 (요청마다 fork 모드는 핸들러가 없음)
+    wait ${proxy_pid} 2> /dev/null
+}
+
+run_proxy "prefork (defaults)"
+run_proxy "fork per request" PROXY_PREFORK_WORKERS=0
+
+kill ${tiny_pid}
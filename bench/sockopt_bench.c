@@ -0,0 +1,125 @@
+/**
+ * sockopt_bench.c - 프록시에 새 연결을 하나씩 맺어 작은 객체를 받는 지연 측정 (sockopt.c 옵션 비교용)
+ *   - 연결마다 connect + 요청 + EOF까지 읽기 + close, 전체 시간을 잼 (p50/p99/평균)
+ *   - fastopen이 1이면 요청을 SYN에 실어 보냄 (sendto MSG_FASTOPEN) ==> 프록시 리스너의 TFO 경로를 탐
+ *   - 전후의 TcpExt TCPFastOpenPassive / TCPFastOpenActive 증가량도 출력 (/proc/net/netstat)
+ * 옵션을 켠 프록시 / 끈 프록시를 띄워 비교하는 건 bench/sockopt_bench.sh.
+ *
+ * 빌드: make bench
+ * 사용: bench/sockopt_bench <프록시 포트> <URL> [연결 수 (기본 2000)] [fastopen (0|1)]
+ */
+#include "csapp.h"
+
+#include <netinet/tcp.h>
+
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN 0x20000000
+#endif
+
+static long now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * netstat_counter - /proc/net/netstat의 TcpExt 카운터 (이름 줄 다음에 값 줄), 없으면 -1
+ */
+static long netstat_counter(const char *name) {
+    char names[MAXBUF], values[MAXBUF];
+    char *np, *vp, *n, *v;
+    long result = -1;
+    FILE *fp = fopen("/proc/net/netstat", "r");
+
+    if (fp == NULL)
+        return -1;
+    while (fgets(names, sizeof(names), fp) && fgets(values, sizeof(values), fp)) {
+        if (strncmp(names, "TcpExt:", 7) != 0)
+            continue;
+        n = strtok_r(names, " \n", &np);
+        v = strtok_r(values, " \n", &vp);
+        while ((n = strtok_r(NULL, " \n", &np)) && (v = strtok_r(NULL, " \n", &vp)))
+            if (strcmp(n, name) == 0) {
+                result = strtol(v, NULL, 10);
+                break;
+            }
+        break;
+    }
+    fclose(fp);
+    return result;
+}
+
+/**
+ * fetch_once - 새 연결로 요청 하나를 보내고 응답을 끝까지 읽음
+ * @return 받은 바이트 수, 실패 시 -1
+ */
+static long fetch_once(struct sockaddr_in *addr, const char *req, size_t req_len, int fastopen) {
+    char buf[MAXBUF];
+    long total = 0;
+    ssize_t n;
+    int fd = Socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fastopen) {
+        /* 쿠키가 없으면 커널이 보통의 SYN으로 보내고 데이터는 연결 뒤에 보냄 */
+        n = sendto(fd, req, req_len, MSG_FASTOPEN, (SA *)addr, sizeof(*addr));
+    } else {
+        n = connect(fd, (SA *)addr, sizeof(*addr)) < 0 ? -1 : write(fd, req, req_len);
+    }
+    if (n != (ssize_t)req_len) {
+        Close(fd);
+        return -1;
+    }
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        total += n;
+    Close(fd);
+    return n < 0 ? -1 : total;
+}
+
+int main(int argc, char **argv) {
+    struct sockaddr_in addr;
+    char req[MAXLINE];
+    int count, fastopen, errors = 0;
+    long *lat, sum = 0, passive0, active0;
+    size_t req_len;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <proxy port> <url> [connections] [fastopen]\n", argv[0]);
+        exit(1);
+    }
+    count = argc > 3 ? atoi(argv[3]) : 2000;
+    fastopen = argc > 4 ? atoi(argv[4]) : 0;
+    if (count <= 0)
+        app_error("sockopt_bench: connections must be positive");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(argv[1]));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    req_len = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\n\r\n", argv[2]);
+    lat = Malloc(count * sizeof(long));
+
+    fetch_once(&addr, req, req_len, fastopen); // 캐시를 채우고 TFO 쿠키를 받아 둠
+    passive0 = netstat_counter("TCPFastOpenPassive");
+    active0 = netstat_counter("TCPFastOpenActive");
+    for (int i = 0; i < count; ++i) {
+        long start = now_us();
+        if (fetch_once(&addr, req, req_len, fastopen) <= 0)
+            ++errors;
+        lat[i] = now_us() - start;
+        sum += lat[i];
+    }
+    qsort(lat, count, sizeof(long), cmp_long);
+
+    printf("%d connections (fastopen %d): p50 %ld us, p99 %ld us, avg %ld us, %d errors\n",
+           count, fastopen, lat[count / 2], lat[count * 99 / 100], sum / count, errors);
+    printf("TCPFastOpenPassive +%ld, TCPFastOpenActive +%ld\n",
+           netstat_counter("TCPFastOpenPassive") - passive0, netstat_counter("TCPFastOpenActive") - active0);
+    Free(lat);
+    return errors != 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# sockopt_bench.sh - 소켓 옵션을 켠 프록시(기본값)와 전부 끈 프록시를 같은 조건으로 비교
+#   tiny와 프록시를 빈 포트에 띄우고 bench/sockopt_bench로 새 연결 N개를 순서대로 보냄
+#   (작은 캐시 객체 ==> 두 번째부터는 캐시 히트, 지연은 연결 수립 + 프록시 처리가 대부분).
+#   클라이언트는 요청을 SYN에 실어 보냄 (MSG_FASTOPEN) - net.ipv4.tcp_fastopen=3 이어야 TFO가 실제로 탐.
+#   루프백은 RTT가 거의 0이라 TFO/DEFER_ACCEPT가 아끼는 왕복은 안 보임 ==> 지연이 있는 링크에서 돌릴 것.
+#
+# 사용: bench/sockopt_bench.sh [연결 수 (기본 2000)] (저장소 최상위에서, make proxy bench 후)
+#
+
+COUNT=${1:-2000}
+OBJECT=home.html
+
+if [ ! -x ./proxy ] || [ ! -x ./tiny/tiny ] || [ ! -x ./bench/sockopt_bench ]; then
+    echo "Error: build first (make proxy bench, cd tiny && make)"
+    exit 1
+fi
+
+echo "net.ipv4.tcp_fastopen = `cat /proc/sys/net/ipv4/tcp_fastopen`"
+
+tiny_port=`./free-port.sh`
+cd ./tiny
+./tiny ${tiny_port} &> /dev/null &
+tiny_pid=$!
+cd ..
+sleep 0.5
+
+# run_proxy <이름> [환경 변수...] - 그 설정으로 프록시를 띄워 측정하고 내림
+run_proxy() {
+    local name=$1
+    shift
+    local proxy_port=`./free-port.sh`
+
+    env "$@" ./proxy ${proxy_port} &> /dev/null &
+    local proxy_pid=$!
+    sleep 0.5
+    echo "== ${name}"
+    ./bench/sockopt_bench ${proxy_port} http://localhost:${tiny_port}/${OBJECT} ${COUNT} 1
+    kill -INT ${proxy_pid}
+    wait ${proxy_pid} 2> /dev/null
+}
+
+run_proxy "tuned (defaults)"
+run_proxy "all options off" PROXY_TCP_NODELAY=0 PROXY_TCP_FASTOPEN=0 PROXY_TCP_DEFER_ACCEPT=0 \
+    PROXY_TCP_NOTSENT_LOWAT=0 PROXY_SO_SNDBUF=0 PROXY_SO_RCVBUF=0
+
+kill ${tiny_pid}
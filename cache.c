@@ -1,9 +1,15 @@
 #include "csapp.h"
 #include "cache.h"
 #include <pthread.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/memfd.h>
 
 /* 전역 상태 */
-// (빔)
+// 캐시 키에서 제거할 쿼리 파라미터 이름들 - cache_init이 기본값으로, main이 바꿈 (스레드가 돌기 전, 이후 읽기 전용)
+static char g_ignored_params_buf[MAXLINE];
+static const char* g_ignored_params[MAX_IGNORED_PARAMS];
+static int g_ignored_param_count = 0;
 
 /* 유틸부 */
 /**
@@ -17,6 +23,44 @@ static int hash_uri(const char* uri) {
     return hash % HASH_SIZE;
 }
 
+/**
+ * now_sec - 단조 증가 시계 기준 현재 시각 (초). 만료 판정 전용.
+ */
+static time_t now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/**
+ * parse_status_code - 응답 첫 줄 "HTTP/1.x 404 Not Found"에서 상태 코드를 뽑음
+ * @return 상태 코드, 파싱 실패 시 0
+ */
+static int parse_status_code(const char* buf, int size) {
+    int i = 0, code = 0;
+
+    while (i < size && buf[i] != ' ' && buf[i] != '\n')
+        i++;
+    while (i < size && buf[i] == ' ')
+        i++;
+    for (int d = 0; d < 3; d++, i++) {
+        if (i >= size || !isdigit((unsigned char)buf[i]))
+            return 0;
+        code = code * 10 + (buf[i] - '0');
+    }
+    return code;
+}
+
+/**
+ * neg_slot - host:port 문자열로 연결 실패 테이블의 슬롯 번호를 구함 (djb2)
+ */
+static int neg_slot(const char* hostport) {
+    unsigned long hash = HASH_VAL;
+    for (int c = *hostport++; c != '\0'; c = *hostport++)
+        hash = ((hash << 5) + hash) + c;
+    return hash % NEG_SLOTS;
+}
+
 /**
  * move_to_front - 해당 캐시를 맨 앞으로
  * 중요! 락은 여기서 관리되지 않음!
@@ -49,18 +93,1046 @@ static void move_to_front_unmanaged(cache_t* cache, cache_entry_t* entry) {
         cache->tail = entry; 
 }
 
+/**
+ * find_header_value - 헤더 블록에서 name 헤더의 값을 찾음 (이름은 대소문자 무시)
+ * 
+ * @param hdrs: "Name: value\r\n"이 반복되는 헤더 블록 (NULL 종결 필요 없음)
+ * @param len_out: 값의 길이 (앞뒤 공백 및 CRLF 제외)
+ * @return 값의 시작 포인터, 없으면 NULL
+ */
+static const char* find_header_value(const char* hdrs, int hdrs_len, const char* name, int name_len, int* len_out) {
+    const char* p = hdrs;
+    const char* end = hdrs + hdrs_len;
+
+    while (p < end) {
+        const char* line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL)
+            line_end = end;
+
+        if (line_end - p > name_len && p[name_len] == ':' && strncasecmp(p, name, name_len) == 0) {
+            const char* v = p + name_len + 1;
+            const char* v_end = line_end;
+            while (v < v_end && (*v == ' ' || *v == '\t'))
+                v++;
+            while (v_end > v && (v_end[-1] == '\r' || v_end[-1] == ' ' || v_end[-1] == '\t'))
+                v_end--;
+            *len_out = v_end - v;
+            return v;
+        }
+        p = line_end + 1;
+    }
+    return NULL;
+}
+
+/**
+ * find_header_end - 응답 버퍼에서 헤더 블록의 길이를 구함 (빈 줄 "\r\n\r\n" 포함)
+ * @return 헤더 길이, 빈 줄이 없으면 size 전체
+ */
+static int find_header_end(const char* buf, int size) {
+    for (int i = 0; i + 3 < size; i++)
+        if (buf[i] == '\r' && buf[i+1] == '\n' && buf[i+2] == '\r' && buf[i+3] == '\n')
+            return i + 4;
+    return size;
+}
+
+/**
+ * parse_response_vary - 응답 헤더의 Vary 값들을 모아 소문자/공백 제거 형태로 vary_out에 저장
+ * Vary 줄이 여러 개면 ','로 이어붙임.
+ * 
+ * @return 0 정상, -1 "Vary: *" (요청마다 다름 ==> 캐시 불가)
+ */
+static int parse_response_vary(const char* buf, int size, char* vary_out) {
+    const char* p = buf;
+    const char* end = buf + find_header_end(buf, size);
+    int n = 0;
+
+    vary_out[0] = '\0';
+    while (p < end) {
+        const char* line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL)
+            line_end = end;
+
+        if (line_end - p > 5 && strncasecmp(p, "Vary:", 5) == 0) {
+            if (n > 0 && vary_out[n-1] != ',')
+                vary_out[n++] = ','; // Vary 줄이 여러 개면 이어붙임
+            for (const char* v = p + 5; v < line_end; v++) {
+                if (*v == ' ' || *v == '\t' || *v == '\r')
+                    continue;
+                if (*v == '*')
+                    return -1;
+                if (*v == ',' && (n == 0 || vary_out[n-1] == ','))
+                    continue;
+                if (n + 2 >= VARY_LEN) // 너무 긴 Vary는 안전하게 캐시 불가 처리
+                    return -1;
+                vary_out[n++] = tolower((unsigned char)*v);
+            }
+        }
+        p = line_end + 1;
+    }
+    if (n > 0 && vary_out[n-1] == ',')
+        n--;
+    vary_out[n] = '\0';
+    return 0;
+}
+
+/**
+ * build_vary_key - Vary에 나열된 요청 헤더 값들을 '\n'으로 이어붙여 변형 키를 만듦
+ * 요청에 해당 헤더가 없으면 빈 값으로 취급.
+ */
+static void build_vary_key(const char* vary, const char* req_hdrs, int req_hdrs_len, char* key_out) {
+    int n = 0;
+    const char* name = vary;
+
+    key_out[0] = '\0';
+    while (*name && n + 2 < VARY_LEN) {
+        int name_len = strcspn(name, ",");
+        int val_len = 0;
+        const char* val = NULL;
+
+        if (req_hdrs != NULL)
+            val = find_header_value(req_hdrs, req_hdrs_len, name, name_len, &val_len);
+        if (val != NULL) {
+            if (n + val_len + 2 >= VARY_LEN)
+                val_len = VARY_LEN - n - 2;
+            memcpy(key_out + n, val, val_len);
+            n += val_len;
+        }
+        key_out[n++] = '\n';
+
+        name += name_len;
+        if (*name == ',')
+            name++;
+    }
+    key_out[n] = '\0';
+}
+
+/**
+ * now_ns - 단조 증가 시계 기준 현재 시각 (ns). 소요 시간 측정용.
+ */
+static unsigned long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+/**
+ * is_compressible - 압축해서 이득을 볼 만한 응답인지 (200 + 텍스트 계열 + 아직 인코딩 안 됨, 전송 인코딩도 없음)
+ */
+static int is_compressible(const char* buf, int hdr_len, int body_len) {
+    int len;
+    const char* type;
+
+    if (body_len < COMPRESS_MIN_SIZE || parse_status_code(buf, hdr_len) != 200)
+        return 0;
+    if (find_header_value(buf, hdr_len, "Content-Encoding", 16, &len) != NULL)
+        return 0;
+    if (find_header_value(buf, hdr_len, "Transfer-Encoding", 17, &len) != NULL) // chunked 등 - 본문이 원래 바이트가 아님
+        return 0;
+    if ((type = find_header_value(buf, hdr_len, "Content-Type", 12, &len)) == NULL)
+        return 0;
+    if (len >= 5 && strncasecmp(type, "text/", 5) == 0)
+        return 1;
+    for (const char* p = type; p < type + len; p++) // application/javascript, json, xml 등
+        if (strncasecmp(p, "javascript", 10) == 0 || strncasecmp(p, "json", 4) == 0 || strncasecmp(p, "xml", 3) == 0)
+            return 1;
+    return 0;
+}
+
+/**
+ * gzip_compress - src를 gzip 스트림으로 압축 (속도 우선 레벨)
+ * @return 압축된 길이, dst_max 안에 못 들어가면 -1
+ */
+static int gzip_compress(const char* src, int len, char* dst, int dst_max) {
+    z_stream zs;
+    int out = -1;
+
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) // 15+16: gzip 포맷
+        return -1;
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = len;
+    zs.next_out = (Bytef*)dst;
+    zs.avail_out = dst_max;
+    if (deflate(&zs, Z_FINISH) == Z_STREAM_END)
+        out = zs.total_out;
+    deflateEnd(&zs);
+    return out;
+}
+
+/**
+ * gzip_decompress - 청크 체인에 나뉘어 담긴 gzip 스트림을 dst에 풀어냄
+ * @return 풀린 길이, 실패 시 -1
+ */
+static int gzip_decompress(const cache_chunk_t* chunk, char* dst, int dst_max) {
+    z_stream zs;
+    int ret = Z_OK;
+    int out = -1;
+
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK)
+        return -1;
+    zs.next_out = (Bytef*)dst;
+    zs.avail_out = dst_max;
+    for (; chunk && ret == Z_OK; chunk = chunk->next) {
+        zs.next_in = (Bytef*)chunk->data;
+        zs.avail_in = chunk->length;
+        ret = inflate(&zs, Z_NO_FLUSH);
+    }
+    if (ret == Z_STREAM_END)
+        out = zs.total_out;
+    inflateEnd(&zs);
+    return out;
+}
+
+/**
+ * accepts_gzip - 요청의 Accept-Encoding에 gzip이 있는지 (q=0으로 거부한 경우 제외)
+ */
+static int accepts_gzip(const char* req_hdrs, int req_hdrs_len) {
+    int len;
+    const char* v;
+
+    if (req_hdrs == NULL || (v = find_header_value(req_hdrs, req_hdrs_len, "Accept-Encoding", 15, &len)) == NULL)
+        return 0;
+    for (const char* p = v; p + 4 <= v + len; p++) {
+        if (strncasecmp(p, "gzip", 4) != 0)
+            continue;
+        const char* q = p + 4;
+        while (q < v + len && *q == ' ')
+            q++;
+        if (q + 4 <= v + len && strncmp(q, ";q=0", 4) == 0 && (q + 4 == v + len || q[4] != '.'))
+            return 0;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * xxh64 - 본문 풀 키로 쓰는 64비트 해시 (xxHash64 알고리즘, seed 0)
+ * 8바이트씩 처리해서 djb2보다 훨씬 빠르고 충돌에도 강함.
+ */
+#define XXH_P1 11400714785074694791ull
+#define XXH_P2 14029467366897019727ull
+#define XXH_P3 1609587929392839161ull
+#define XXH_P4 9650029242287828579ull
+#define XXH_P5 2870177450012600261ull
+#define XXH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static unsigned long long xxh64_round(unsigned long long acc, unsigned long long input) {
+    acc += input * XXH_P2;
+    acc = XXH_ROTL(acc, 31);
+    return acc * XXH_P1;
+}
+
+static unsigned long long xxh64_merge(unsigned long long acc, unsigned long long val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+static unsigned long long xxh64(const char* data, int len) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    unsigned long long h, lane;
+    unsigned int half;
+
+    if (len >= 32) {
+        unsigned long long v1 = XXH_P1 + XXH_P2, v2 = XXH_P2, v3 = 0, v4 = -XXH_P1;
+        do {
+            memcpy(&lane, p, 8);      v1 = xxh64_round(v1, lane);
+            memcpy(&lane, p + 8, 8);  v2 = xxh64_round(v2, lane);
+            memcpy(&lane, p + 16, 8); v3 = xxh64_round(v3, lane);
+            memcpy(&lane, p + 24, 8); v4 = xxh64_round(v4, lane);
+            p += 32;
+        } while (p + 32 <= end);
+        h = XXH_ROTL(v1, 1) + XXH_ROTL(v2, 7) + XXH_ROTL(v3, 12) + XXH_ROTL(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = XXH_P5;
+    }
+    h += (unsigned long long)len;
+
+    for (; p + 8 <= end; p += 8) {
+        memcpy(&lane, p, 8);
+        h ^= xxh64_round(0, lane);
+        h = XXH_ROTL(h, 27) * XXH_P1 + XXH_P4;
+    }
+    if (p + 4 <= end) {
+        memcpy(&half, p, 4);
+        h ^= (unsigned long long)half * XXH_P1;
+        h = XXH_ROTL(h, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * XXH_P5;
+        h = XXH_ROTL(h, 11) * XXH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * new_body - 빈 본문 생성 (청크 없음, refcnt 0)
+ */
+static cache_body_t* new_body(body_state_t state) {
+    cache_body_t* body = Malloc(sizeof(cache_body_t));
+    body->chunks = NULL;
+    body->length = 0;
+    body->state = state;
+    body->pooled = 0;
+    body->charged = 0;
+    body->memfd = -1;
+    body->map = NULL;
+    body->hash = 0;
+    body->refcnt = 0;
+    body->h_next = NULL;
+    return body;
+}
+
+/**
+ * free_body - 본문과 청크들을 해제 (풀/통계는 호출자가 정리)
+ * sendfile로 보내는 중이던 페이지는 소켓이 따로 참조를 잡고 있으므로 바로 닫아도 안전.
+ */
+static void free_body(cache_body_t* body) {
+    cache_chunk_t* c = body->chunks;
+    while (c) {
+        cache_chunk_t* next = c->next;
+        free(c);
+        c = next;
+    }
+    if (body->map) {
+        munmap(body->map, MAX_STREAM_OBJECT_SIZE);
+        close(body->memfd);
+    }
+    free(body);
+}
+
+/**
+ * map_body - 스트리밍 본문용 memfd 저장소를 만들어 붙임 (실패하면 그냥 malloc 청크 사용)
+ * 파일 크기는 최대치로 잡지만 실제 메모리는 쓴 페이지만큼만 씀.
+ */
+static void map_body(cache_body_t* body) {
+    int fd = syscall(SYS_memfd_create, "cache-body", MFD_CLOEXEC); // csapp.h와 _GNU_SOURCE가 충돌해서 직접 호출
+    if (fd < 0)
+        return;
+    if (ftruncate(fd, MAX_STREAM_OBJECT_SIZE) < 0 ||
+        (body->map = mmap(NULL, MAX_STREAM_OBJECT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        body->map = NULL;
+        close(fd);
+        return;
+    }
+    body->memfd = fd;
+}
+
+/**
+ * fill_chunks - data를 CACHE_CHUNK_SIZE 단위 청크 체인으로 본문에 담음 (마지막 청크는 딱 맞는 크기)
+ * 본문 해시도 여기서 계산 - 청크별 xxh64를 이어 붙여 접음.
+ */
+static void fill_chunks(cache_body_t* body, const char* data, int len) {
+    cache_chunk_t** link = &body->chunks;
+    unsigned long long h = len;
+
+    for (int off = 0; off < len; off += CACHE_CHUNK_SIZE) {
+        int n = len - off < CACHE_CHUNK_SIZE ? len - off : CACHE_CHUNK_SIZE;
+        cache_chunk_t* c = Malloc(sizeof(cache_chunk_t) + n);
+        c->data = (char*)(c + 1);
+        memcpy(c->data, data + off, n);
+        c->length = n;
+        c->next = NULL;
+        *link = c;
+        link = &c->next;
+        h = xxh64_merge(h, xxh64(c->data, n));
+    }
+    body->length = len;
+    body->hash = h;
+}
+
+/**
+ * body_equal - 두 본문의 내용이 같은지 (청크 경계가 달라도 비교 가능)
+ */
+static int body_equal(const cache_body_t* a, const cache_body_t* b) {
+    const cache_chunk_t* ca = a->chunks;
+    const cache_chunk_t* cb = b->chunks;
+    int oa = 0, ob = 0;
+
+    if (a->length != b->length)
+        return 0;
+    while (ca && cb) {
+        int n = ca->length - oa < cb->length - ob ? ca->length - oa : cb->length - ob;
+        if (memcmp(ca->data + oa, cb->data + ob, n) != 0)
+            return 0;
+        oa += n;
+        ob += n;
+        if (oa == ca->length) { ca = ca->next; oa = 0; }
+        if (ob == cb->length) { cb = cb->next; ob = 0; }
+    }
+    return 1;
+}
+
+/**
+ * make_variant - 응답 buf로 새 변형을 만듦 (락 밖에서 호출 - 압축과 해시 계산이 여기서 일어남)
+ * 텍스트 응답은 본문을 gzip으로 압축해 보고, 7/8 이하로 줄어들 때만 압축본을 보관.
+ * 본문은 아직 풀에 들어가지 않은 상태 (refcnt 0). vary_key와 next는 호출자가 채움.
+ */
+static cache_variant_t* make_variant(const char* buf, int size) {
+    cache_variant_t* variant = Malloc(sizeof(cache_variant_t));
+    cache_body_t* body = new_body(BODY_COMPLETE);
+    int hdr_len = find_header_end(buf, size);
+    int body_len = size - hdr_len;
+    int comp_len = -1;
+    char* comp = NULL;
+
+    variant->headers = Malloc(hdr_len);
+    memcpy(variant->headers, buf, hdr_len);
+    variant->hdr_length = hdr_len;
+
+    if (is_compressible(buf, hdr_len, body_len)) {
+        comp = Malloc(body_len);
+        comp_len = gzip_compress(buf + hdr_len, body_len, comp, COMPRESS_MAX_SIZE(body_len));
+    }
+
+    if (comp_len > 0) {
+        fill_chunks(body, comp, comp_len);
+        variant->compressed = 1;
+    } else {
+        fill_chunks(body, buf + hdr_len, body_len);
+        variant->compressed = 0;
+    }
+    free(comp);
+
+    variant->body = body;
+    variant->content_length = hdr_len + body->length;
+    variant->raw_length = size;
+
+    variant->expires_at = 0;
+    int status = parse_status_code(buf, size);
+    if (status == 404 || status == 410) // 없는 리소스는 짧게만 기억 (네거티브 캐싱)
+        variant->expires_at = now_sec() + NEG_RESPONSE_TTL;
+    variant->next = NULL;
+    return variant;
+}
+
+/**
+ * intern_body_unmanaged - 본문을 풀에 넣음. 같은 내용이 이미 있으면 새 본문은 버리고 기존 것을 공유.
+ * 해시가 같아도 길이와 실제 바이트까지 비교하므로 충돌해도 잘못 공유되지 않음.
+ * 중요! 락은 여기서 관리되지 않음!
+ * 
+ * @return 풀에 있는 본문 (refcnt 1 증가됨)
+ */
+static cache_body_t* intern_body_unmanaged(cache_t* cache, cache_body_t* body) {
+    int idx = body->hash % BODY_POOL_SIZE;
+
+    for (cache_body_t* b = cache->body_pool[idx]; b; b = b->h_next) {
+        if (b->hash == body->hash && body_equal(b, body)) {
+            free_body(body);
+            __sync_fetch_and_add(&b->refcnt, 1);
+            return b;
+        }
+    }
+
+    body->refcnt = 1;
+    body->pooled = 1;
+    body->h_next = cache->body_pool[idx];
+    cache->body_pool[idx] = body;
+    cache->pooled_body_bytes += body->length;
+    cache->total_cached_bytes += body->length;
+    return body;
+}
+
+/**
+ * body_unref_unmanaged - 본문 참조 하나를 놓음. 마지막 참조면 (풀에 있었으면 풀에서 빼고) 해제.
+ * 중요! 반드시 wrlock 상태에서 호출! (rdlock 하의 참조 증가와 겹치지 않도록)
+ */
+static void body_unref_unmanaged(cache_t* cache, cache_body_t* body) {
+    if (__sync_sub_and_fetch(&body->refcnt, 1) > 0)
+        return;
+
+    if (body->pooled) {
+        cache_body_t** link = &cache->body_pool[body->hash % BODY_POOL_SIZE];
+        while (*link != body)
+            link = &(*link)->h_next;
+        *link = body->h_next;
+        cache->pooled_body_bytes -= body->length;
+        cache->total_cached_bytes -= body->length;
+    }
+    free_body(body);
+}
+
+/**
+ * release_variant_unmanaged - 변형 하나를 해제하고 통계/크기를 갱신
+ * 풀 본문은 마지막 참조가 사라질 때만 풀에서 빼고 해제.
+ * 풀 밖 (스트리밍) 본문은 변형이 크기를 책임지므로 여기서 바로 빼고, 읽는 중인 리더가 있으면 해제만 미룸.
+ * 중요! 락은 여기서 관리되지 않음!
+ */
+static void release_variant_unmanaged(cache_t* cache, cache_variant_t* variant) {
+    cache_body_t* body = variant->body;
+
+    cache->total_cached_bytes -= variant->hdr_length;
+    cache->raw_cached_bytes -= variant->raw_length;
+    if (body->pooled) {
+        cache->logical_body_bytes -= body->length;
+    } else {
+        cache->total_cached_bytes -= body->charged;
+        body->charged = 0;
+    }
+
+    body_unref_unmanaged(cache, body);
+    free(variant->headers);
+    free(variant);
+}
+
+/**
+ * copy_variant_out - 변형 내용을 클라이언트로 보낼 형태로 buf_out에 복사
+ *   - 비압축: 그대로 복사
+ *   - 압축 + 클라이언트가 gzip 허용: 헤더만 고쳐서 (Content-Encoding/Content-Length) 압축본 그대로
+ *   - 압축 + gzip 불가: 본문을 풀어서 원래 응답 그대로
+ * buf_out은 MAX_OBJECT_SIZE 이상이어야 함. 중요! rdlock 이상을 잡은 상태에서 호출!
+ * 
+ * @return 0 성공, -1 압축 해제 실패
+ */
+static int copy_variant_out(cache_t* cache, cache_entry_t* entry, cache_variant_t* variant, 
+                            const char* req_hdrs, int req_hdrs_len, char* buf_out, int* size_out) {
+    if (!variant->compressed) {
+        int n = variant->hdr_length;
+        memcpy(buf_out, variant->headers, n);
+        for (cache_chunk_t* c = variant->body->chunks; c; c = c->next) {
+            memcpy(buf_out + n, c->data, c->length);
+            n += c->length;
+        }
+        *size_out = n;
+        return 0;
+    }
+
+    int comp_len = variant->body->length;
+    if (accepts_gzip(req_hdrs, req_hdrs_len)) {
+        // 헤더를 줄 단위로 복사하되 Content-Length와 끝의 빈 줄은 빼고, gzip용 헤더를 덧붙임
+        // Vary에는 Accept-Encoding이 있어야 함 (없으면 새 줄로, 있는 Vary 줄에는 덧붙임)
+        const char* p = variant->headers;
+        const char* end = variant->headers + variant->hdr_length;
+        int need_vary = strstr(entry->vary, "accept-encoding") == NULL && strcmp(entry->vary, "*") != 0;
+        int n = 0;
+        while (p < end) {
+            const char* line_end = memchr(p, '\n', end - p);
+            int line_len = (line_end ? line_end + 1 : end) - p;
+            if (need_vary && strncasecmp(p, "Vary:", 5) == 0) {
+                int value_len = line_len;
+                while (value_len > 5 && strchr("\r\n \t", p[value_len-1]))
+                    value_len--;
+                memcpy(buf_out + n, p, value_len);
+                n += value_len;
+                n += sprintf(buf_out + n, "%sAccept-Encoding\r\n", value_len > 5 ? ", " : " ");
+                need_vary = 0;
+            } else if (!(line_len <= 2 || strncasecmp(p, "Content-Length:", 15) == 0)) {
+                memcpy(buf_out + n, p, line_len);
+                n += line_len;
+            }
+            p += line_len;
+        }
+        n += sprintf(buf_out + n, "Content-Encoding: gzip\r\nContent-Length: %d\r\n%s\r\n", 
+                     comp_len, need_vary ? "Vary: Accept-Encoding\r\n" : "");
+        for (cache_chunk_t* c = variant->body->chunks; c; c = c->next) {
+            memcpy(buf_out + n, c->data, c->length);
+            n += c->length;
+        }
+        *size_out = n;
+        __sync_fetch_and_add(&cache->gzip_hits, 1);
+        return 0;
+    }
+
+    unsigned long start = now_ns();
+    memcpy(buf_out, variant->headers, variant->hdr_length);
+    int body_len = gzip_decompress(variant->body->chunks, buf_out + variant->hdr_length, 
+                                   variant->raw_length - variant->hdr_length);
+    if (body_len < 0)
+        return -1;
+    *size_out = variant->hdr_length + body_len;
+    __sync_fetch_and_add(&cache->inflate_ns, now_ns() - start);
+    __sync_fetch_and_add(&cache->inflate_hits, 1);
+    return 0;
+}
+
+/**
+ * free_entry - 캐시 객체와 그 변형들을 전부 해제 (공유 본문은 참조만 감소)
+ * 중요! 락은 여기서 관리되지 않음!
+ */
+static void free_entry(cache_t* cache, cache_entry_t* entry) {
+    cache_variant_t* v = entry->variants;
+    while (v) {
+        cache_variant_t* next = v->next;
+        release_variant_unmanaged(cache, v);
+        v = next;
+    }
+    free(entry);
+}
+
+/**
+ * ban_matches - 퍼지 규칙이 캐시 객체에 해당하는지 판정
+ */
+static int ban_matches(const cache_ban_t* ban, const cache_entry_t* entry) {
+    switch (ban->type) {
+    case PURGE_EXACT:
+        return strcmp(entry->uri, ban->pattern) == 0;
+    case PURGE_PREFIX:
+        return strncmp(entry->uri, ban->pattern, strlen(ban->pattern)) == 0;
+    case PURGE_HOST: {
+        // "http://host:port/path"에서 host:port 부분만 비교
+        const char* host = strstr(entry->uri, "://");
+        host = host ? host + 3 : entry->uri;
+        size_t len = strcspn(host, "/");
+        return len == strlen(ban->pattern) && strncasecmp(host, ban->pattern, len) == 0;
+    }
+    case PURGE_TAG: {
+        size_t len = strlen(ban->pattern);
+        for (const char* t = entry->tags; *t; ) {
+            size_t tlen = strcspn(t, " ");
+            if (tlen == len && strncmp(t, ban->pattern, len) == 0)
+                return 1;
+            t += tlen;
+            t += strspn(t, " ");
+        }
+        return 0;
+    }
+    }
+    return 0;
+}
+
+/**
+ * entry_banned - 객체가 마지막 검증 이후 추가된 퍼지 규칙에 걸리는지 확인
+ * 규칙은 gen 오름차순이므로 뒤에서부터 entry->gen보다 새로운 것만 봄.
+ * 중요! 락은 여기서 관리되지 않음!
+ */
+static int entry_banned_unmanaged(cache_t* cache, cache_entry_t* entry) {
+    for (int i = cache->ban_count - 1; i >= 0 && cache->bans[i].gen > entry->gen; i--)
+        if (ban_matches(&cache->bans[i], entry))
+            return 1;
+    return 0;
+}
+
+/**
+ * sweep_bans_unmanaged - 쌓인 퍼지 규칙을 모든 객체에 한 번에 적용하고 규칙 목록을 비움
+ * 중요! 락은 여기서 관리되지 않음!
+ */
+static void sweep_bans_unmanaged(cache_t* cache) {
+    cache_entry_t* curr = cache->head;
+    while (curr) {
+        cache_entry_t* next = curr->next;
+        if (entry_banned_unmanaged(cache, curr))
+            cache_remove_by_entry_unmanaged(cache, curr);
+        else
+            curr->gen = cache->generation;
+        curr = next;
+    }
+    cache->ban_count = 0;
+}
+
 /**
  * evict_lru - 해당 캐시를 퇴출
+ * 맨 끝 객체가 여러 청크짜리 스트리밍 본문 하나뿐이면 통째로 버리지 않고 마지막 청크만 잘라냄.
+ * 잘린 본문은 앞부분만 남은 BODY_PARTIAL 상태가 됨 (통째 응답으로는 미스).
+ * 읽거나 채우는 중인 본문 (refcnt > 1)은 자르지 않고 객체를 통째로 퇴출.
  * 중요! 락은 여기서 관리되지 않음!
  */
 static void evict_lru_unmanaged(cache_t* cache) {
     cache_entry_t* entry = cache->tail;
-    if (entry)
+    if (entry == NULL)
+        return;
+
+    cache_body_t* body = entry->variants ? entry->variants->body : NULL;
+    if (entry->variant_count == 1 && !body->pooled && body->refcnt == 1 && 
+        body->state != BODY_FILLING && body->chunks && body->chunks->next) {
+        cache_chunk_t* prev = body->chunks;
+        while (prev->next->next)
+            prev = prev->next;
+        int n = prev->next->length;
+        if (body->map) // 잘라낸 구간의 페이지를 실제로 돌려줌
+            madvise(prev->next->data, CACHE_CHUNK_SIZE, MADV_REMOVE);
+
+        pthread_mutex_lock(&cache->fill_lock);
+        free(prev->next);
+        prev->next = NULL;
+        body->length -= n;
+        body->state = BODY_PARTIAL;
+        pthread_mutex_unlock(&cache->fill_lock);
+
+        body->charged -= n;
+        entry->variants->content_length -= n;
+        entry->variants->raw_length -= n;
+        entry->content_length -= n;
+        cache->total_cached_bytes -= n;
+        cache->raw_cached_bytes -= n;
+        return;
+    }
+    cache_remove_by_entry_unmanaged(cache, entry);
+}
+
+
+/**
+ * hex_val - 16진수 문자 하나의 값, 16진수가 아니면 -1
+ */
+static int hex_val(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * copy_pct_normalized - src[0..len)을 퍼센트 인코딩 정규화하며 dst에 복사
+ * unreserved 문자(ALPHA / DIGIT / - . _ ~)의 %XX는 원래 문자로 풀고, 나머지 %xx는 대문자 16진수로.
+ * @return dst에 쓴 바이트 수 (dst_max를 넘기면 -1)
+ */
+static int copy_pct_normalized(char* dst, int dst_max, const char* src, int len) {
+    static const char hex[] = "0123456789ABCDEF";
+    int n = 0;
+
+    for (int i = 0; i < len; i++) {
+        if (n + 3 >= dst_max)
+            return -1;
+        if (src[i] == '%' && i + 2 < len && hex_val(src[i+1]) >= 0 && hex_val(src[i+2]) >= 0) {
+            int c = hex_val(src[i+1]) * 16 + hex_val(src[i+2]);
+            if (isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+                dst[n++] = c;
+            } else {
+                dst[n++] = '%';
+                dst[n++] = hex[c >> 4];
+                dst[n++] = hex[c & 15];
+            }
+            i += 2;
+        } else {
+            dst[n++] = src[i];
+        }
+    }
+    return n;
+}
+
+/**
+ * is_ignored_param - 쿼리 파라미터 이름이 무시 목록에 있는지 ('*'로 끝나는 항목은 접두어 일치)
+ */
+static int is_ignored_param(const char* name, int name_len) {
+    for (int i = 0; i < g_ignored_param_count; i++) {
+        const char* ig = g_ignored_params[i];
+        int ig_len = strlen(ig);
+        if (ig_len > 0 && ig[ig_len-1] == '*') {
+            if (name_len >= ig_len - 1 && strncasecmp(name, ig, ig_len - 1) == 0)
+                return 1;
+        } else if (name_len == ig_len && strncasecmp(name, ig, ig_len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * insert_variant_unmanaged - 미리 만든 변형을 uri 객체에 연결, 리스트 갱신
+ * 응답의 Vary가 기존 객체와 다르면 기존 변형들은 전부 버리고 새로 시작.
+ * 완성된 본문은 풀에 넣고, 채우는 중인 본문은 풀 밖에 두고 참조만 하나 잡음.
+ * 중요! 반드시 외부에서 락 관리!
+ * 
+ * @return 1 저장함, 0 "Vary: *" 응답이라 저장 안 함 (variant 해제는 호출자 몫)
+ */
+static int insert_variant_unmanaged(cache_t* cache, const char* uri, const char* req_hdrs, int req_hdrs_len, cache_variant_t* variant){
+    char vary[VARY_LEN];
+    char vary_key[VARY_LEN];
+
+    const char* buf = variant->headers;
+    int size = variant->content_length;
+
+    // 얼리 리턴 - Vary: * 면 캐시 불가
+    if (parse_response_vary(buf, variant->hdr_length, vary) < 0)
+        return 0;
+    build_vary_key(vary, req_hdrs, req_hdrs_len, vary_key);
+
+    // Vary 정책이 바뀌었으면 이전 변형들은 의미가 없으므로 통째로 삭제
+    cache_entry_t* entry = cache_lookup(cache, uri, 0, 0);
+    if (entry != NULL && strcmp(entry->vary, vary) != 0){
+        cache_remove_by_entry_unmanaged(cache, entry);
+        entry = NULL;
+    }
+
+    // 같은 키의 이전 변형 있으면 삭제, 변형 수가 꽉 찼으면 가장 오래 안 쓴 변형(맨 끝) 삭제
+    if (entry != NULL){
+        cache_variant_t** link = &entry->variants;
+        while (*link && strcmp((*link)->vary_key, vary_key) != 0)
+            link = &(*link)->next;
+        if (*link == NULL && entry->variant_count >= MAX_VARIANTS){
+            link = &entry->variants;
+            while ((*link)->next)
+                link = &(*link)->next;
+        }
+        if (*link != NULL){
+            cache_variant_t* old = *link;
+            *link = old->next;
+            entry->variant_count--;
+            entry->content_length -= old->content_length;
+            release_variant_unmanaged(cache, old);
+        }
+        move_to_front_unmanaged(cache, entry); // 퇴출 정책에 자기 자신이 걸리지 않도록
+    }
+        
+    // 퇴출 정책
+    cache_evict_policy_unmanaged(cache, size);
+    if (entry != NULL)
+        entry = cache_lookup(cache, uri, 0, 0); // 그래도 퇴출됐을 수 있으므로 다시 확인
+    
+    // 새 객체 생성
+    if (entry == NULL){
+        entry = Malloc(sizeof(cache_entry_t));
+        strcpy(entry->uri, uri);
+        strcpy(entry->vary, vary);
+        entry->gen = cache->generation;
+        entry->variants = NULL;
+        entry->variant_count = 0;
+        entry->content_length = 0;
+        entry->prev = NULL;
+        entry->next = NULL;
+        entry->h_next = NULL;
+    
+        // 이중 연결 리스트
+        entry->next = cache->head;
+        if (cache->head)
+            cache->head->prev = entry;
+        cache->head = entry;
+        if (cache->tail == NULL)
+            cache->tail = entry;
+
+        // 해시 테이블 체이닝
+        int hashed_index = hash_uri(uri);
+        entry->h_next = cache->hashtable[hashed_index];
+        cache->hashtable[hashed_index] = entry;
+    }
+
+    // 태그 퍼지용 Surrogate-Key는 가장 최근 응답 기준
+    int tags_len = 0;
+    const char* tags = find_header_value(buf, variant->hdr_length, "Surrogate-Key", 13, &tags_len);
+    if (tags_len >= TAGS_LEN)
+        tags_len = TAGS_LEN - 1;
+    memcpy(entry->tags, tags ? tags : "", tags ? tags_len : 0);
+    entry->tags[tags ? tags_len : 0] = '\0';
+
+    // 본문은 풀에 넣어서 같은 내용이면 공유 (스트리밍 중인 본문은 내용이 아직 없으므로 제외)
+    if (variant->body->state == BODY_COMPLETE)
+        variant->body = intern_body_unmanaged(cache, variant->body);
+    else
+        __sync_fetch_and_add(&variant->body->refcnt, 1);
+
+    // 새 변형은 변형 목록 맨 앞에
+    strcpy(variant->vary_key, vary_key);
+    variant->next = entry->variants;
+    entry->variants = variant;
+    entry->variant_count++;
+    entry->content_length += size;
+
+    // 사이즈 (퇴출 정책은 실제 보관 바이트 기준 ==> 압축/공유한 만큼 더 많이 담김)
+    // 본문 바이트는 intern_body_unmanaged()에서 새로 풀에 들어갈 때만 더해짐 (스트리밍 본문은 청크 단위로)
+    cache->total_cached_bytes += variant->hdr_length;
+    cache->raw_cached_bytes += variant->raw_length;
+    if (variant->body->pooled)
+        cache->logical_body_bytes += variant->body->length;
+    return 1;
+}
+
+/**
+ * discard_variant - 캐시에 들어가지 못한 새 변형을 해제
+ */
+static void discard_variant(cache_variant_t* variant) {
+    free_body(variant->body);
+    free(variant->headers);
+    free(variant);
+}
+
+/**
+ * lookup_fresh_variant_unmanaged - uri + 요청 헤더에 맞는 변형을 찾되, 퍼지/만료된 건 미스
+ * 중요! rdlock 이상을 잡은 상태에서 호출!
+ * 
+ * @param banned: 퍼지 규칙에 걸렸으면 1 (호출자가 wrlock에서 실제 삭제)
+ */
+static cache_variant_t* lookup_fresh_variant_unmanaged(cache_t* cache, const char* uri, const char* req_hdrs, int req_hdrs_len,
+                                                       cache_entry_t** entry_out, int* banned) {
+    cache_entry_t* entry = cache_lookup(cache, uri, 0, 0); // NO internal lock, NO LRU 업데이트.
+    cache_variant_t* variant;
+
+    *banned = 0;
+    *entry_out = entry;
+    if (entry && entry->gen < cache->generation && entry_banned_unmanaged(cache, entry)) {
+        *banned = 1;
+        return NULL;
+    }
+    variant = entry ? cache_lookup_variant(entry, req_hdrs, req_hdrs_len, 0) : NULL;
+    if (variant && variant->expires_at && variant->expires_at <= now_sec()) // 만료된 네거티브 응답은 미스 취급
+        return NULL;
+    return variant;
+}
+
+/**
+ * find_fill_variant_unmanaged - 채우는 중인 본문을 가진 변형이 아직 캐시에 붙어 있는지 찾음
+ * 중요! 락은 여기서 관리되지 않음!
+ * 
+ * @return 변형 (퇴출/퍼지/교체로 떨어져 나갔으면 NULL)
+ */
+static cache_variant_t* find_fill_variant_unmanaged(cache_t* cache, cache_fill_t* fill, cache_entry_t** entry_out) {
+    cache_entry_t* entry = cache_lookup(cache, fill->uri, 0, 0);
+    for (cache_variant_t* v = entry ? entry->variants : NULL; v; v = v->next) {
+        if (v->body == fill->body) {
+            *entry_out = entry;
+            return v;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * remove_variant_unmanaged - 객체에서 변형 하나를 빼고 해제. 변형이 다 없어지면 객체도 제거.
+ * 중요! 락은 여기서 관리되지 않음!
+ */
+static void remove_variant_unmanaged(cache_t* cache, cache_entry_t* entry, cache_variant_t* variant) {
+    cache_variant_t** link = &entry->variants;
+    while (*link != variant)
+        link = &(*link)->next;
+    *link = variant->next;
+    entry->variant_count--;
+    entry->content_length -= variant->content_length;
+    release_variant_unmanaged(cache, variant);
+
+    if (entry->variant_count == 0)
         cache_remove_by_entry_unmanaged(cache, entry);
 }
 
 
 /* 구현부 */
+/**
+ * cache_set_ignored_params - 캐시 키에서 뺄 쿼리 파라미터 목록 설정 (콤마 구분, 예: "utm_*,fbclid")
+ * 스레드들이 돌기 전에 (main에서) 한 번만 호출할 것.
+ */
+void cache_set_ignored_params(const char *csv) {
+    char* save_p;
+
+    strncpy(g_ignored_params_buf, csv, sizeof(g_ignored_params_buf) - 1);
+    g_ignored_params_buf[sizeof(g_ignored_params_buf) - 1] = '\0';
+    g_ignored_param_count = 0;
+    for (char* name = strtok_r(g_ignored_params_buf, ", ", &save_p); 
+         name && g_ignored_param_count < MAX_IGNORED_PARAMS; 
+         name = strtok_r(NULL, ", ", &save_p))
+        g_ignored_params[g_ignored_param_count++] = name;
+}
+
+/**
+ * cache_normalize_uri - 캐시 키로 쓸 정규화된 URI를 만듦 (힙 할당 없음)
+ *   - scheme과 host는 소문자로
+ *   - 기본 포트(http:80, https:443) 제거
+ *   - 경로/쿼리의 퍼센트 인코딩 정규화, 빈 경로는 "/"
+ *   - 무시 목록의 쿼리 파라미터(utm_* 등) 제거, 나머지는 정렬
+ *   - #fragment 제거
+ * 예: "HTTP://Example.COM:80/a?utm_source=x&b=2&a=1" ==> "http://example.com/a?a=1&b=2"
+ * 
+ * @param uri: 원본 요청 URI
+ * @param key_out: 결과 버퍼
+ * @param key_max: 결과 버퍼 크기
+ * @return 1 성공, 0 실패 (너무 길면 원본 그대로 복사하고 0)
+ */
+int cache_normalize_uri(const char *uri, char *key_out, size_t key_max) {
+    const char* scheme_end = strstr(uri, "://");
+    int n = 0;
+
+    if (scheme_end == NULL || strlen(uri) >= key_max)
+        goto fallback;
+
+    // 1. scheme (소문자)
+    for (const char* p = uri; p < scheme_end; p++)
+        key_out[n++] = tolower((unsigned char)*p);
+    memcpy(key_out + n, "://", 3);
+    n += 3;
+
+    // 2. host[:port] (소문자, 기본 포트 제거)
+    const char* host = scheme_end + 3;
+    int host_len = strcspn(host, "/?#");
+    int copy_len = host_len;
+    const char* colon = memchr(host, ':', host_len);
+    if (colon != NULL) {
+        int scheme_len = scheme_end - uri;
+        const char* port = colon + 1;
+        int port_len = host + host_len - port;
+        if ((scheme_len == 4 && strncasecmp(uri, "http", 4) == 0 && port_len == 2 && strncmp(port, "80", 2) == 0) ||
+            (scheme_len == 5 && strncasecmp(uri, "https", 5) == 0 && port_len == 3 && strncmp(port, "443", 3) == 0) ||
+            port_len == 0)
+            copy_len = colon - host;
+    }
+    for (int i = 0; i < copy_len; i++)
+        key_out[n++] = tolower((unsigned char)host[i]);
+
+    // 3. 경로 (퍼센트 인코딩 정규화)
+    const char* path = host + host_len;
+    int path_len = strcspn(path, "?#");
+    if (path_len == 0) {
+        key_out[n++] = '/';
+    } else {
+        int w = copy_pct_normalized(key_out + n, key_max - n, path, path_len);
+        if (w < 0)
+            goto fallback;
+        n += w;
+    }
+
+    // 4. 쿼리 - 무시 목록 제거 후 정렬 (fragment는 버림)
+    const char* query = path + path_len;
+    if (*query == '?') {
+        const char* params[MAX_QUERY_PARAMS];
+        int param_lens[MAX_QUERY_PARAMS];
+        int count = 0;
+
+        query++;
+        int query_len = strcspn(query, "#");
+        for (const char* p = query; p < query + query_len; ) {
+            int len = strcspn(p, "&#");
+            int name_len = strcspn(p, "=&#");
+            if (len > 0 && !is_ignored_param(p, name_len)) {
+                if (count == MAX_QUERY_PARAMS)
+                    goto fallback;
+                // 삽입 정렬 - 파라미터 수가 적어서 충분
+                int i = count++;
+                while (i > 0) {
+                    int cmp_len = param_lens[i-1] < len ? param_lens[i-1] : len;
+                    int cmp = strncmp(params[i-1], p, cmp_len);
+                    if (cmp < 0 || (cmp == 0 && param_lens[i-1] <= len))
+                        break;
+                    params[i] = params[i-1];
+                    param_lens[i] = param_lens[i-1];
+                    i--;
+                }
+                params[i] = p;
+                param_lens[i] = len;
+            }
+            p += len;
+            if (*p == '&')
+                p++;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (n + 1 >= key_max)
+                goto fallback;
+            key_out[n++] = (i == 0) ? '?' : '&';
+            int w = copy_pct_normalized(key_out + n, key_max - n, params[i], param_lens[i]);
+            if (w < 0)
+                goto fallback;
+            n += w;
+        }
+    }
+
+    key_out[n] = '\0';
+    return 1;
+
+fallback:
+    // 정규화할 수 없는 형태면 원본 그대로를 키로 사용
+    strncpy(key_out, uri, key_max - 1);
+    key_out[key_max - 1] = '\0';
+    return 0;
+}
+
 /**
  * cache_init - 캐시 전체 체계 초기화
  */
@@ -68,8 +1140,26 @@ void cache_init(cache_t* cache) {
     cache->head = NULL;
     cache->tail = NULL;
     cache->total_cached_bytes = 0;
+    cache_set_ignored_params(DEFAULT_IGNORED_PARAMS); // 워커 스레드가 읽기만 하도록 여기서 미리
     memset(cache->hashtable, 0, sizeof(cache->hashtable)); // 해당 포인터에서 sizeof(cache->hashtable)만큼을 0(NULL)로 초기화.
     pthread_rwlock_init(&cache->ptrwlock, NULL);
+
+    cache->generation = 0;
+    cache->ban_count = 0;
+    cache->raw_cached_bytes = 0;
+    cache->gzip_hits = 0;
+    cache->inflate_hits = 0;
+    cache->inflate_ns = 0;
+    memset(cache->body_pool, 0, sizeof(cache->body_pool));
+    cache->logical_body_bytes = 0;
+    cache->pooled_body_bytes = 0;
+    cache->sendfile_bytes = 0;
+    cache->copied_stream_bytes = 0;
+
+    memset(cache->neg_table, 0, sizeof(cache->neg_table));
+    pthread_mutex_init(&cache->neg_lock, NULL);
+    pthread_mutex_init(&cache->fill_lock, NULL);
+    pthread_cond_init(&cache->fill_cond, NULL);
 }
 
 /**
@@ -81,49 +1171,75 @@ void cache_deinit(cache_t *cache) {
     cache_entry_t *curr = cache->head;
     while (curr) {
         cache_entry_t *next = curr->next;
-        free(curr->content);
-        free(curr);
+        free_entry(cache, curr);
         curr = next;
     }
 
     cache->head = NULL;
     cache->tail = NULL;
     cache->total_cached_bytes = 0;
+    cache->raw_cached_bytes = 0;
     memset(cache->hashtable, 0, sizeof(cache->hashtable));
 
     pthread_rwlock_unlock(&cache->ptrwlock);
     pthread_rwlock_destroy(&cache->ptrwlock);
+    pthread_mutex_destroy(&cache->neg_lock);
+    pthread_mutex_destroy(&cache->fill_lock);
+    pthread_cond_destroy(&cache->fill_cond);
 }
 
 /**
  * cache_get - 캐시에서 URI에 해당하는 객체를 찾고, 존재할 경우 buf_out에 복사함
  * 내부적으로 락을 획득하며, LRU 업데이트도 수행함.
+ * URI에 Vary가 걸려 있으면 요청 헤더 값으로 맞는 변형을 고름.
  * 
  * @param uri 요청한 URI
+ * @param req_hdrs 클라이언트 요청 헤더 블록 (Vary 매칭용, NULL 가능)
  * @param buf_out 캐시된 콘텐츠가 복사될 버퍼
  * @param size_out 콘텐츠 길이
  * @return 성공(1), 실패(0)
  */
-int cache_get(cache_t *cache, const char *uri, char *buf_out, int *size_out){
+int cache_get(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, char *buf_out, int *size_out){
     cache_entry_t* entry;
+    cache_variant_t* variant;
+
+    int banned;
 
     // Read lock으로 lookup만 진행
     pthread_rwlock_rdlock(&cache->ptrwlock);
-    entry = cache_lookup(cache, uri, 0, 0); // NO internal lock, NO LRU 업데이트.
-    if (!entry) {
+    variant = lookup_fresh_variant_unmanaged(cache, uri, req_hdrs, req_hdrs_len, &entry, &banned);
+    // 퍼지 규칙에 걸린 객체는 미스 취급하고 wrlock에서 실제 삭제
+    if (banned) {
+        pthread_rwlock_unlock(&cache->ptrwlock);
+        pthread_rwlock_wrlock(&cache->ptrwlock);
+        entry = cache_lookup(cache, uri, 0, 0);
+        if (entry && entry_banned_unmanaged(cache, entry))
+            cache_remove_by_entry_unmanaged(cache, entry);
+        pthread_rwlock_unlock(&cache->ptrwlock);
+        return 0;
+    }
+    // 버퍼 하나에 통째로 줄 수 있는 완성본만 (큰 객체나 채우는 중인 객체는 cache_open_stream으로)
+    if (!variant || variant->body->state != BODY_COMPLETE || variant->raw_length > MAX_OBJECT_SIZE) {
         pthread_rwlock_unlock(&cache->ptrwlock);
         return 0;
     }
 
-    // 콘텐츠 복사
-    memcpy(buf_out, entry->content, entry->content_length);
-    *size_out = entry->content_length;
+    // 콘텐츠 복사 (압축본이면 gzip 그대로 또는 풀어서)
+    if (copy_variant_out(cache, entry, variant, req_hdrs, req_hdrs_len, buf_out, size_out) < 0) {
+        pthread_rwlock_unlock(&cache->ptrwlock);
+        return 0;
+    }
     pthread_rwlock_unlock(&cache->ptrwlock);
 
     // LRU 이동은 별도의 wrlock에서 수행
-    // 락 승격 문제는 없지만, rdlock해제→wrlock획득 이 사이에 내용이 바뀌면 문제 소지는 있음
+    // rdlock해제→wrlock획득 사이에 퇴출됐을 수도 있으므로 다시 찾아서 이동.
     pthread_rwlock_wrlock(&cache->ptrwlock);
-    move_to_front_unmanaged(cache, entry);
+    entry = cache_lookup(cache, uri, 0, 1);
+    if (entry) {
+        cache_lookup_variant(entry, req_hdrs, req_hdrs_len, 1);
+        if (!entry_banned_unmanaged(cache, entry)) // 다음 조회부터는 지금까지의 규칙 검사 생략
+            entry->gen = cache->generation;
+    }
     pthread_rwlock_unlock(&cache->ptrwlock);
 
     return 1; // 찾으면 1
@@ -133,9 +1249,11 @@ int cache_get_v1(cache_t *cache, const char *uri, char *buf_out, int *size_out){
     cache_entry_t* entry = cache_lookup(cache, uri, 0, 0); // LRU 업데이트도 cache_get에서 직접.
     int result = 0; // 1 찾음; 0 없음.
 
-    if(entry){
-        memcpy(buf_out, entry->content, entry->content_length);
-        *size_out = entry->content_length;
+    cache_variant_t* variant = entry ? cache_lookup_variant(entry, NULL, 0, 1) : NULL;
+    if (variant && (variant->body->state != BODY_COMPLETE || variant->raw_length > MAX_OBJECT_SIZE))
+        variant = NULL;
+
+    if(variant && copy_variant_out(cache, entry, variant, NULL, 0, buf_out, size_out) == 0){
         move_to_front_unmanaged(cache, entry);  
         result = 1;
     }
@@ -146,73 +1264,474 @@ int cache_get_v1(cache_t *cache, const char *uri, char *buf_out, int *size_out){
 
 /**
  * cache_put - 캐시에 새 객체 저장
- * 내부에서 직접 읽기 락 사용!
+ * 내부에서 직접 쓰기 락 사용!
  * 
  * @param cache: 캐시 포인터
  * @param uri: 요청 URI (key)
- * @param buf: 응답 본문 (payload)
- * @param size: 응답 본문 크기
+ * @param req_hdrs: 클라이언트 요청 헤더 블록 (Vary 변형 키 계산용, NULL 가능)
+ * @param buf: 응답 (헤더 + 본문)
+ * @param size: 응답 크기
  * @return void
  */
-void cache_put(cache_t *cache, const char *uri, const char *buf, int size) {
+void cache_put(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, const char *buf, int size) {
     if (size > MAX_OBJECT_SIZE)
         return;
 
+    cache_variant_t* variant = make_variant(buf, size); // 압축은 락 밖에서
+
     pthread_rwlock_wrlock(&cache->ptrwlock);
-    cache_insert_unmanaged(cache, uri, buf, size);
+    int stored = insert_variant_unmanaged(cache, uri, req_hdrs, req_hdrs_len, variant);
     pthread_rwlock_unlock(&cache->ptrwlock);
+    if (!stored)
+        discard_variant(variant);
 }
 
 /**
- * cache_insert_unmanaged - buf를 기반으로 새 캐시 생성, 리스트 갱신
- * 중요! 반드시 외부에서 락 관리!
+ * cache_fill_begin - MAX_OBJECT_SIZE를 넘는 응답을 받으면서 청크 단위로 캐시 시작
+ * 헤더만 가진 변형을 바로 캐시에 넣으므로, 같은 객체를 요청한 다른 클라이언트는
+ * 오리진을 다시 부르지 않고 cache_open_stream으로 채워지는 대로 따라 읽을 수 있음.
+ * 내부에서 직접 쓰기 락 사용!
+ * 
+ * @param hdrs: 응답 헤더 블록 (빈 줄 포함)
+ * @return 채우기 핸들, 캐시할 수 없으면 NULL
+ */
+cache_fill_t* cache_fill_begin(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, const char *hdrs, int hdr_len) {
+    cache_variant_t* variant = Malloc(sizeof(cache_variant_t));
+
+    variant->headers = Malloc(hdr_len);
+    memcpy(variant->headers, hdrs, hdr_len);
+    variant->hdr_length = hdr_len;
+    variant->body = new_body(BODY_FILLING);
+    variant->body->refcnt = 1; // 채우는 쪽 참조 (변형 참조는 insert에서)
+    map_body(variant->body);
+    variant->content_length = hdr_len; // 본문 크기는 cache_fill_end에서 반영
+    variant->raw_length = hdr_len;
+    variant->compressed = 0;
+    variant->expires_at = 0;
+    variant->next = NULL;
+
+    pthread_rwlock_wrlock(&cache->ptrwlock);
+    int stored = insert_variant_unmanaged(cache, uri, req_hdrs, req_hdrs_len, variant);
+    pthread_rwlock_unlock(&cache->ptrwlock);
+    if (!stored) {
+        discard_variant(variant);
+        return NULL;
+    }
+
+    cache_fill_t* fill = Malloc(sizeof(cache_fill_t));
+    strcpy(fill->uri, uri);
+    fill->body = variant->body;
+    fill->tail = NULL;
+    return fill;
+}
+
+/**
+ * cache_fill_append - 받은 본문 조각을 채우는 중인 본문 뒤에 붙임
+ * 새 청크가 필요할 때만 wrlock을 잡고 퇴출 정책을 돌려 청크 하나 크기만큼 미리 자리를 잡음.
+ * 이미 캐시에서 떨어져 나간 본문이어도 따라 읽는 리더를 위해 계속 채움.
+ * 
+ * @return 0 성공, -1 MAX_STREAM_OBJECT_SIZE 초과 (호출자는 cache_fill_end(.., 0)로 포기)
+ */
+int cache_fill_append(cache_t *cache, cache_fill_t *fill, const char *buf, int n) {
+    cache_body_t* body = fill->body;
+
+    if (body->length + n > MAX_STREAM_OBJECT_SIZE)
+        return -1;
+
+    while (n > 0) {
+        if (fill->tail == NULL || fill->tail->length == CACHE_CHUNK_SIZE) {
+            cache_entry_t* entry;
+            cache_chunk_t* c;
+            if (body->map) { // 앞 청크들은 꽉 차 있으므로 새 청크는 매핑의 body->length 위치
+                c = Malloc(sizeof(cache_chunk_t));
+                c->data = body->map + body->length;
+            } else {
+                c = Malloc(sizeof(cache_chunk_t) + CACHE_CHUNK_SIZE);
+                c->data = (char*)(c + 1);
+            }
+            c->next = NULL;
+            c->length = 0;
+
+            pthread_rwlock_wrlock(&cache->ptrwlock);
+            if (find_fill_variant_unmanaged(cache, fill, &entry)) {
+                move_to_front_unmanaged(cache, entry); // 퇴출 정책에 자기 자신이 걸리지 않도록
+                cache_evict_policy_unmanaged(cache, CACHE_CHUNK_SIZE);
+                if (find_fill_variant_unmanaged(cache, fill, &entry)) {
+                    body->charged += CACHE_CHUNK_SIZE;
+                    cache->total_cached_bytes += CACHE_CHUNK_SIZE;
+                }
+            }
+            pthread_rwlock_unlock(&cache->ptrwlock);
+
+            pthread_mutex_lock(&cache->fill_lock);
+            if (fill->tail)
+                fill->tail->next = c;
+            else
+                body->chunks = c;
+            pthread_mutex_unlock(&cache->fill_lock);
+            fill->tail = c;
+        }
+
+        // 리더는 length까지만 읽으므로 그 뒤에 복사하는 건 락 없이
+        int m = CACHE_CHUNK_SIZE - fill->tail->length;
+        if (m > n)
+            m = n;
+        memcpy(fill->tail->data + fill->tail->length, buf, m);
+
+        pthread_mutex_lock(&cache->fill_lock);
+        fill->tail->length += m;
+        body->length += m;
+        pthread_cond_broadcast(&cache->fill_cond);
+        pthread_mutex_unlock(&cache->fill_lock);
+
+        buf += m;
+        n -= m;
+    }
+    return 0;
+}
+
+/**
+ * cache_fill_end - 채우기 종료. 성공이면 본문 크기를 캐시 크기에 확정 반영, 실패면 변형을 버림.
+ * 따라 읽던 리더들은 여기서 깨어나 끝(0) 또는 실패(-1)를 받음.
+ * 내부에서 직접 쓰기 락 사용! fill은 여기서 해제됨.
+ * 
+ * @param ok: 1 본문을 끝까지 받음, 0 중간에 실패
+ */
+void cache_fill_end(cache_t *cache, cache_fill_t *fill, int ok) {
+    cache_body_t* body = fill->body;
+    cache_entry_t* entry;
+
+    pthread_rwlock_wrlock(&cache->ptrwlock);
+    pthread_mutex_lock(&cache->fill_lock);
+    body->state = ok ? BODY_COMPLETE : BODY_ABORTED;
+    pthread_cond_broadcast(&cache->fill_cond);
+    pthread_mutex_unlock(&cache->fill_lock);
+
+    cache_variant_t* variant = find_fill_variant_unmanaged(cache, fill, &entry);
+    if (variant && ok) {
+        // 청크 단위로 미리 잡아둔 크기를 실제 크기로 정산
+        variant->content_length += body->length;
+        variant->raw_length += body->length;
+        entry->content_length += body->length;
+        cache->raw_cached_bytes += body->length;
+        cache->total_cached_bytes = cache->total_cached_bytes - body->charged + body->length;
+        body->charged = body->length;
+    } else if (variant) {
+        remove_variant_unmanaged(cache, entry, variant);
+    }
+    body_unref_unmanaged(cache, body); // 채우는 쪽 참조
+    pthread_rwlock_unlock(&cache->ptrwlock);
+
+    free(fill);
+}
+
+/**
+ * inflate_body - 압축 본문을 풀어서 리더 전용 임시 본문으로 만듦 (풀 밖, 크기 계산에도 안 들어감)
+ * @return 임시 본문 (refcnt 1), 실패 시 NULL
+ */
+static cache_body_t* inflate_body(cache_variant_t* variant) {
+    int max = variant->raw_length - variant->hdr_length;
+    char* raw = Malloc(max > 0 ? max : 1);
+    int len = gzip_decompress(variant->body->chunks, raw, max);
+    cache_body_t* body = NULL;
+
+    if (len >= 0) {
+        body = new_body(BODY_COMPLETE);
+        fill_chunks(body, raw, len);
+        body->refcnt = 1;
+    }
+    free(raw);
+    return body;
+}
+
+/**
+ * cache_open_stream - 캐시된 객체를 복사 없이 청크 단위로 읽기 시작 (일반 히트, 큰 객체, Range 응답용)
+ * 아직 채우는 중인 객체도 열 수 있으며, 이때는 채워지는 속도에 맞춰 따라 읽음.
+ * 실패한 본문은 미스. 본문 참조를 잡으므로 읽는 중에 퇴출돼도 안전.
+ * 내부에서 직접 락 사용!
+ * 
+ * @param flags: CACHE_STREAM_PARTIAL - 퇴출로 앞부분만 남은 본문도 열어 줌 (avail_length까지만 읽힘)
+ *               CACHE_STREAM_INFLATE - 압축본은 풀어서 원래 본문으로 줌 (없으면 압축본은 미스)
+ * @return 리더 (헤더 사본 포함), 없으면 NULL
+ */
+cache_reader_t* cache_open_stream(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, int flags) {
+    cache_entry_t* entry;
+    cache_variant_t* variant;
+    cache_body_t* body;
+    int banned, len;
+
+    pthread_rwlock_rdlock(&cache->ptrwlock);
+    variant = lookup_fresh_variant_unmanaged(cache, uri, req_hdrs, req_hdrs_len, &entry, &banned);
+    if (!variant || variant->body->state == BODY_ABORTED || (variant->body->state == BODY_PARTIAL && !(flags & CACHE_STREAM_PARTIAL)) ||
+        (variant->compressed && !(flags & CACHE_STREAM_INFLATE))) {
+        pthread_rwlock_unlock(&cache->ptrwlock);
+        return NULL;
+    }
+    if (variant->compressed) { // 압축본은 작은 완성본뿐이므로 여기서 한 번에 풀어 둠
+        if ((body = inflate_body(variant)) == NULL) {
+            pthread_rwlock_unlock(&cache->ptrwlock);
+            return NULL;
+        }
+    } else {
+        body = variant->body;
+        __sync_fetch_and_add(&body->refcnt, 1);
+    }
+
+    cache_reader_t* reader = Malloc(sizeof(cache_reader_t));
+    reader->headers = Malloc(variant->hdr_length);
+    memcpy(reader->headers, variant->headers, variant->hdr_length);
+    reader->hdr_length = variant->hdr_length;
+    reader->body = body;
+    reader->chunk = NULL;
+    reader->chunk_off = 0;
+
+    // 상태는 wrlock 하에서만 바뀌므로 rdlock 동안은 고정
+    const char* cl = find_header_value(variant->headers, variant->hdr_length, "Content-Length", 14, &len);
+    if (body->state == BODY_COMPLETE)
+        reader->object_length = body->length;
+    else
+        reader->object_length = cl ? strtol(cl, NULL, 10) : -1; // 헤더 블록은 빈 줄로 끝나므로 strtol이 넘어가지 않음
+    reader->avail_length = body->state == BODY_PARTIAL ? body->length : reader->object_length;
+    int useless = reader->object_length < 0 && body->state == BODY_PARTIAL; // 원래 크기를 모르는 잘린 본문은 쓸 데가 없음
+    pthread_rwlock_unlock(&cache->ptrwlock);
+
+    if (useless) {
+        cache_stream_close(cache, reader);
+        return NULL;
+    }
+
+    pthread_rwlock_wrlock(&cache->ptrwlock);
+    entry = cache_lookup(cache, uri, 0, 1); // LRU 업데이트
+    if (entry && !entry_banned_unmanaged(cache, entry)) // 다음 조회부터는 지금까지의 규칙 검사 생략
+        entry->gen = cache->generation;
+    pthread_rwlock_unlock(&cache->ptrwlock);
+
+    return reader;
+}
+
+/**
+ * cache_stream_seek - 리더의 읽기 위치를 본문 offset으로 옮김 (앞뒤 어느 쪽이든)
+ * 채우는 중인 본문이면 offset까지 채워질 때까지 기다림.
+ * 
+ * @return 0 성공, -1 offset이 본문 밖 (잘린 본문의 뒷부분이거나 채우다 실패)
+ */
+int cache_stream_seek(cache_t *cache, cache_reader_t *reader, long offset) {
+    cache_body_t* body = reader->body;
+    int ret = -1;
+
+    pthread_mutex_lock(&cache->fill_lock);
+    for (;;) {
+        cache_chunk_t* c = body->chunks;
+        long off = offset;
+        while (c && off >= c->length && c->next) {
+            off -= c->length;
+            c = c->next;
+        }
+        if (c ? off <= c->length : off == 0) {
+            reader->chunk = c;
+            reader->chunk_off = off;
+            ret = 0;
+            break;
+        }
+        if (body->state != BODY_FILLING)
+            break;
+        pthread_cond_wait(&cache->fill_cond, &cache->fill_lock);
+    }
+    pthread_mutex_unlock(&cache->fill_lock);
+    return ret;
+}
+
+/**
+ * cache_stream_read - 본문의 다음 조각을 가리킴 (복사 없음, 다음 호출 전까지 유효)
+ * 아직 안 채워진 부분이면 채워질 때까지 기다림.
+ * 
+ * @param data_out: 조각 시작 주소
+ * @return 조각 길이, 0 본문 끝, -1 채우다 실패
+ */
+ssize_t cache_stream_read(cache_t *cache, cache_reader_t *reader, const char **data_out) {
+    cache_body_t* body = reader->body;
+    ssize_t n;
+
+    pthread_mutex_lock(&cache->fill_lock);
+    for (;;) {
+        if (reader->chunk == NULL) {
+            reader->chunk = body->chunks;
+            reader->chunk_off = 0;
+        } else if (reader->chunk_off == reader->chunk->length && reader->chunk->next) {
+            reader->chunk = reader->chunk->next;
+            reader->chunk_off = 0;
+        }
+
+        n = reader->chunk ? reader->chunk->length - reader->chunk_off : 0;
+        if (n > 0 || body->state == BODY_COMPLETE || body->state == BODY_PARTIAL)
+            break;
+        if (body->state == BODY_ABORTED) {
+            n = -1;
+            break;
+        }
+        pthread_cond_wait(&cache->fill_cond, &cache->fill_lock);
+    }
+    if (n > 0) {
+        *data_out = reader->chunk->data + reader->chunk_off;
+        reader->chunk_off += n;
+    }
+    pthread_mutex_unlock(&cache->fill_lock);
+    return n;
+}
+
+/**
+ * cache_stream_send - 본문의 다음 조각을 fd로 직접 보냄 (cache_stream_read + 전송)
+ * memfd에 담긴 큰 본문은 sendfile로 커널 안에서 바로 소켓으로 (유저 공간 복사 없음), 그 외엔 write.
+ * 본문은 뒤에 붙기만 하고 이미 쓴 바이트는 바뀌지 않으므로 전송 완료를 따로 기다릴 필요 없음.
+ * 
+ * @param max: 이번에 보낼 최대 바이트 수 (-1이면 제한 없음)
+ * @return 보낸 바이트 수, 0 본문 끝, -1 채우다 실패 또는 전송 오류
+ */
+ssize_t cache_stream_send(cache_t *cache, cache_reader_t *reader, int fd, long max) {
+    cache_body_t* body = reader->body;
+    const char* data;
+    ssize_t n = cache_stream_read(cache, reader, &data);
+
+    if (n <= 0)
+        return n;
+    if (max >= 0 && n > max) { // 안 보낸 만큼 위치를 되돌림 (리더만 쓰는 값이라 락 불필요)
+        reader->chunk_off -= n - max;
+        n = max;
+    }
+
+    if (body->map) {
+        off_t off = data - body->map;
+        for (ssize_t left = n, m; left > 0; left -= m) {
+            if ((m = sendfile(fd, body->memfd, &off, left)) <= 0) {
+                if (m < 0 && errno == EINTR) {
+                    m = 0;
+                    continue;
+                }
+                return -1;
+            }
+        }
+        __sync_fetch_and_add(&cache->sendfile_bytes, n);
+    } else {
+        if (rio_writen(fd, (void*)data, n) != n)
+            return -1;
+        __sync_fetch_and_add(&cache->copied_stream_bytes, n);
+    }
+    return n;
+}
+
+/**
+ * cache_stream_send_response - 막 연 리더의 헤더와 본문 전체를 fd로 보냄 (캐시 히트 응답)
+ * 메모리 청크에 담긴 완성본은 헤더 + 청크들을 iovec으로 묶어 writev 한 번에 (버퍼에 모으는 복사 없음).
+ * memfd 본문이나 채우는 중인 본문은 헤더를 MSG_MORE로 보내 첫 sendfile 조각과 같은 세그먼트로 나가게 함.
+ * 
+ * @return 0 성공, -1 본문이 끊김 또는 전송 오류
+ */
+int cache_stream_send_response(cache_t *cache, cache_reader_t *reader, int fd) {
+    struct iovec iov[2 + MAX_STREAM_OBJECT_SIZE / CACHE_CHUNK_SIZE];
+    cache_body_t* body = reader->body;
+    int complete, cnt = 0;
+    ssize_t n;
+
+    pthread_mutex_lock(&cache->fill_lock);
+    complete = body->state == BODY_COMPLETE;
+    pthread_mutex_unlock(&cache->fill_lock);
+
+    if (complete && body->map == NULL) {
+        iov[cnt].iov_base = reader->headers;
+        iov[cnt++].iov_len = reader->hdr_length;
+        for (cache_chunk_t* c = body->chunks; c; c = c->next) {
+            iov[cnt].iov_base = c->data;
+            iov[cnt++].iov_len = c->length;
+        }
+        if (rio_writev(fd, iov, cnt) < 0)
+            return -1;
+        __sync_fetch_and_add(&cache->copied_stream_bytes, body->length);
+        return 0;
+    }
+
+    for (int off = 0; off < reader->hdr_length; off += n) {
+        if ((n = send(fd, reader->headers + off, reader->hdr_length - off, MSG_MORE)) <= 0) {
+            if (n < 0 && errno == EINTR) {
+                n = 0;
+                continue;
+            }
+            return -1;
+        }
+    }
+    while ((n = cache_stream_send(cache, reader, fd, -1)) > 0)
+        ;
+    return n < 0 ? -1 : 0;
+}
+
+/**
+ * cache_stream_close - 리더를 닫고 본문 참조를 놓음 (이미 퇴출된 본문이면 여기서 해제됨)
+ */
+void cache_stream_close(cache_t *cache, cache_reader_t *reader) {
+    pthread_rwlock_wrlock(&cache->ptrwlock);
+    body_unref_unmanaged(cache, reader->body);
+    pthread_rwlock_unlock(&cache->ptrwlock);
+
+    free(reader->headers);
+    free(reader);
+}
+
+/**
+ * cache_put_connect_failure - 오리진(host:port) 연결 실패를 NEG_CONNECT_TTL 동안 기억
+ * 같은 슬롯에 다른 host:port가 있으면 덮어씀. 내부에서 neg_lock 사용.
+ */
+void cache_put_connect_failure(cache_t *cache, const char *hostname, const char *port) {
+    char key[NEG_KEY_LEN];
+    snprintf(key, sizeof(key), "%s:%s", hostname, port);
+    neg_entry_t* slot = &cache->neg_table[neg_slot(key)];
+
+    pthread_mutex_lock(&cache->neg_lock);
+    strcpy(slot->hostport, key);
+    slot->expires_at = now_sec() + NEG_CONNECT_TTL;
+    pthread_mutex_unlock(&cache->neg_lock);
+}
+
+/**
+ * cache_connect_failed - 최근에 연결 실패한 오리진인지 확인
+ * 죽은 오리진으로의 요청 폭주를 connect 타임아웃 없이 바로 실패시키기 위함.
+ * 
+ * @return 1 최근 실패 기록 있음 (아직 유효), 0 없음
+ */
+int cache_connect_failed(cache_t *cache, const char *hostname, const char *port) {
+    char key[NEG_KEY_LEN];
+    int failed = 0;
+    snprintf(key, sizeof(key), "%s:%s", hostname, port);
+    neg_entry_t* slot = &cache->neg_table[neg_slot(key)];
+
+    pthread_mutex_lock(&cache->neg_lock);
+    if (strcmp(slot->hostport, key) == 0) {
+        if (slot->expires_at > now_sec())
+            failed = 1;
+        else
+            slot->hostport[0] = '\0'; // 만료 ==> 슬롯 비움
+    }
+    pthread_mutex_unlock(&cache->neg_lock);
+    return failed;
+}
+
+/**
+ * cache_insert_unmanaged - buf를 기반으로 새 캐시(변형) 생성, 리스트 갱신
+ * 중요! 반드시 외부에서 락 관리! (압축까지 락 안에서 하므로 보통은 cache_put 사용)
  * 
  * @param cache: 캐시 포인터
  * @param uri: 요청 URI (key)
- * @param buf: 응답 본문 (payload)
- * @param size: 응답 본문 크기
+ * @param req_hdrs: 클라이언트 요청 헤더 블록 (NULL 가능)
+ * @param buf: 응답 (헤더 + 본문)
+ * @param size: 응답 크기
  * @return void
  */
-void cache_insert_unmanaged(cache_t* cache, const char* uri, const char* buf, int size){
+void cache_insert_unmanaged(cache_t* cache, const char* uri, const char* req_hdrs, int req_hdrs_len, const char* buf, int size){
     // 얼리 리턴 - 사이즈 맞는 경우만
     if (size > MAX_OBJECT_SIZE)
         return;
 
-    // 이전꺼 있으면 삭제
-    cache_entry_t* entry = cache_lookup(cache, uri, 0, 0);
-    if (entry != NULL){
-        cache_remove_by_entry_unmanaged(cache, entry);
-        entry = NULL;
-    }
-        
-    // 퇴출 정책
-    cache_evict_policy_unmanaged(cache, size);
-    
-    // 새 객체 생성
-    cache_entry_t* new_entry = Malloc(sizeof(cache_entry_t));
-    strcpy(new_entry->uri, uri);
-    new_entry->content = Malloc(size);
-    memcpy(new_entry->content, buf, size);
-    new_entry->content_length = size;
-    new_entry->prev = NULL;
-    new_entry->next = NULL;
-    new_entry->h_next = NULL;
-    
-    // 이중 연결 리스트
-    new_entry->next = cache->head;
-    if (cache->head)
-        cache->head->prev = new_entry;
-    cache->head = new_entry;
-    if (cache->tail == NULL)
-        cache->tail = new_entry;
-
-    // 해시 테이블 체이닝
-    int hashed_index = hash_uri(uri);
-    new_entry->h_next = cache->hashtable[hashed_index];
-    cache->hashtable[hashed_index] = new_entry;
-
-    // 사이즈
-    cache->total_cached_bytes += size;
+    cache_variant_t* variant = make_variant(buf, size);
+    if (!insert_variant_unmanaged(cache, uri, req_hdrs, req_hdrs_len, variant))
+        discard_variant(variant);
 }
 
 /**
@@ -254,9 +1773,7 @@ void cache_remove_by_entry_unmanaged(cache_t* cache, cache_entry_t* entry){
         curr = curr->h_next;
     }
     
-    cache->total_cached_bytes -= entry->content_length;
-    free(entry->content);
-    free(entry);
+    free_entry(cache, entry); // 크기/통계는 변형 해제 시 갱신
 }
 
 /**
@@ -286,6 +1803,38 @@ cache_entry_t* cache_lookup(cache_t* cache, const char* uri, const int internal_
     return entry;
 }
 
+/**
+ * cache_lookup_variant - 캐시 객체에서 요청 헤더에 맞는 변형을 찾음
+ * Vary가 없는 객체는 변형이 하나뿐이라 키 계산 없이 바로 반환 (O(1)).
+ * 
+ * @param entry: 캐시 객체 포인터
+ * @param req_hdrs: 클라이언트 요청 헤더 블록 (NULL 가능)
+ * @param update_mru: 1이면 찾은 변형을 변형 목록 맨 앞으로 (반드시 wrlock 상태에서만!)
+ * @return 찾은 변형, 없으면 NULL
+ */
+cache_variant_t* cache_lookup_variant(cache_entry_t* entry, const char* req_hdrs, int req_hdrs_len, const int update_mru){
+    char vary_key[VARY_LEN];
+
+    if (entry->vary[0] == '\0')
+        return entry->variants;
+
+    build_vary_key(entry->vary, req_hdrs, req_hdrs_len, vary_key);
+
+    cache_variant_t* prev = NULL;
+    cache_variant_t* v = entry->variants;
+    while (v && strcmp(v->vary_key, vary_key) != 0){
+        prev = v;
+        v = v->next;
+    }
+
+    if (v && prev && update_mru){
+        prev->next = v->next;
+        v->next = entry->variants;
+        entry->variants = v;
+    }
+    return v;
+}
+
 /**
  * cache_remove - uri 기반으로 캐시에서 제거
  * 락을 내부에서 직접 관리!
@@ -306,6 +1855,34 @@ void cache_remove(cache_t* cache, const char* uri) {
     pthread_rwlock_unlock(&cache->ptrwlock);
 }
 
+/**
+ * cache_ban - host/prefix/tag 퍼지를 규칙으로만 등록 (지연 삭제)
+ * 실제 삭제는 각 객체가 다음에 조회될 때, 또는 규칙이 MAX_BANS개 쌓였을 때 한꺼번에.
+ * 수천 개 객체를 지우더라도 여기서는 락을 아주 잠깐만 잡음.
+ * 락을 내부에서 직접 관리!
+ * 
+ * @param cache: 캐시 포인터
+ * @param type: 퍼지 종류 (PURGE_EXACT도 허용하지만 보통은 cache_remove 사용)
+ * @param pattern: host:port, URI 접두어, 또는 태그
+ * @return 이 퍼지의 세대 번호
+ */
+unsigned long cache_ban(cache_t* cache, purge_type_t type, const char* pattern) {
+    unsigned long gen;
+
+    pthread_rwlock_wrlock(&cache->ptrwlock);
+    if (cache->ban_count == MAX_BANS)
+        sweep_bans_unmanaged(cache);
+
+    cache_ban_t* ban = &cache->bans[cache->ban_count++];
+    ban->type = type;
+    strncpy(ban->pattern, pattern, MAXLINE - 1);
+    ban->pattern[MAXLINE - 1] = '\0';
+    ban->gen = gen = ++cache->generation;
+    pthread_rwlock_unlock(&cache->ptrwlock);
+
+    return gen;
+}
+
 /**
  * cache_evict_policy_unmanaged - 정책 기반으로 퇴출
  * 중요! 얘는 락을 관리하지 않음!
@@ -343,10 +1920,36 @@ void debug_print_cache(cache_t* cache) {
 
     cache_entry_t* curr = cache->head;
     while (curr != NULL) {
-        printf("URI: %-60s | Size: %d bytes\n", curr->uri, curr->content_length);
+        printf("URI: %-60s | Size: %d bytes | Variants: %d\n", curr->uri, curr->content_length, curr->variant_count);
         curr = curr->next;
     }
     printf("========== End of Cache =========\n");
 
     pthread_rwlock_unlock(&cache->ptrwlock);
 }
+
+/**
+ * cache_print_stats - 캐시 통계 출력
+ *   - 실효 용량 배수: 압축 전 기준 바이트 / 실제 보관 바이트
+ *   - 히트당 압축 해제 비용: 압축 해제 총 시간 / 압축 해제 히트 수
+ * 
+ * @param cache: 캐시 포인터
+ */
+void cache_print_stats(cache_t* cache) {
+    pthread_rwlock_rdlock(&cache->ptrwlock);
+
+    printf("====== Cache Stats ======\n");
+    printf("Stored bytes: %zu (raw %zu, capacity gain x%.2f)\n", cache->total_cached_bytes, cache->raw_cached_bytes,
+           cache->total_cached_bytes ? (double)cache->raw_cached_bytes / cache->total_cached_bytes : 1.0);
+    printf("Compressed hits: gzip passthrough %lu, inflated %lu (avg %.1f us/hit)\n", cache->gzip_hits, cache->inflate_hits,
+           cache->inflate_hits ? cache->inflate_ns / 1000.0 / cache->inflate_hits : 0.0);
+    printf("Body pool: %zu bytes stored for %zu bytes referenced (dedup x%.2f, saved %zu bytes)\n",
+           cache->pooled_body_bytes, cache->logical_body_bytes,
+           cache->pooled_body_bytes ? (double)cache->logical_body_bytes / cache->pooled_body_bytes : 1.0,
+           cache->logical_body_bytes - cache->pooled_body_bytes);
+    printf("Stream hits: %zu bytes via sendfile (zero-copy), %zu bytes copied\n",
+           cache->sendfile_bytes, cache->copied_stream_bytes);
+    printf("=========================\n");
+
+    pthread_rwlock_unlock(&cache->ptrwlock);
+}
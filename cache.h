@@ -5,6 +5,8 @@
 
 #include <signal.h>
 #include <assert.h>
+#include <time.h>
+#include <zlib.h>
 
 #define MAX_CACHE_SIZE (1<<20) // 1메가
 #define MAX_OBJECT_SIZE (100<<10) // 100킬로
@@ -13,18 +15,131 @@
 #define HASH_SIZE 13 // 소수로 충돌 최소화
 #define HASH_VAL 5381l // 소수로 충돌 최소화
 
-// 하나의 캐시 객체
+#define MAX_VARIANTS 4 // URI 하나당 보관할 최대 변형(variant) 수
+#define VARY_LEN 512 // Vary 헤더 이름 목록 및 변형 키의 최대 길이
+
+#define NEG_RESPONSE_TTL 10 // 404/410 응답의 네거티브 캐시 유효시간 (초)
+#define NEG_CONNECT_TTL 5 // 오리진 연결 실패의 네거티브 캐시 유효시간 (초)
+#define NEG_SLOTS 64 // 연결 실패 테이블 슬롯 수 (충돌 시 덮어씀)
+#define NEG_KEY_LEN 272 // host:port 최대 길이
+
+#define MAX_BANS 32 // 지연 퍼지(ban) 목록 최대 길이 - 꽉 차면 한 번에 전체 정리
+#define TAGS_LEN 256 // 응답 Surrogate-Key 헤더 (공백 구분 태그들) 최대 길이
+
+#define COMPRESS_MIN_SIZE 1024 // 이보다 작은 본문은 압축 안 함
+#define COMPRESS_MAX_SIZE(len) ((len) - (len) / 8) // 압축 결과가 원본의 7/8 이하일 때만 압축본 보관 (최소 128바이트 이득 ==> gzip 헤더 재작성분보다 큼)
+
+#define BODY_POOL_SIZE 61 // 본문 풀 해시 버킷 수 (소수)
+
+#define CACHE_CHUNK_SIZE (16<<10) // 본문 청크 크기 (16킬로)
+#define MAX_STREAM_OBJECT_SIZE (MAX_CACHE_SIZE / 2) // 청크 스트리밍으로 캐시할 수 있는 최대 본문 크기
+
+// cache_open_stream 플래그
+#define CACHE_STREAM_PARTIAL 0x1 // 퇴출로 앞부분만 남은 본문도 열기
+#define CACHE_STREAM_INFLATE 0x2 // 압축본도 풀어서 열기 (없으면 압축본은 미스 ==> cache_get으로)
+
+#define MAX_QUERY_PARAMS 64 // 키 정규화 시 정렬할 수 있는 최대 쿼리 파라미터 수
+#define MAX_IGNORED_PARAMS 32 // 키에서 제거할 쿼리 파라미터 이름 최대 개수
+#define DEFAULT_IGNORED_PARAMS "utm_*,fbclid,gclid" // '*'로 끝나면 접두어 일치
+
+// 퍼지 종류
+typedef enum {
+    PURGE_EXACT,  // URI 정확히 일치 - 즉시 삭제
+    PURGE_HOST,   // 같은 host(:port)의 모든 객체
+    PURGE_PREFIX, // URI가 pattern으로 시작하는 모든 객체
+    PURGE_TAG     // 응답 Surrogate-Key에 pattern 태그가 있는 모든 객체
+} purge_type_t;
+
+// 지연 퍼지 규칙 - 이 세대(gen) 이전에 검증된 객체에만 적용
+typedef struct {
+    purge_type_t type;
+    char pattern[MAXLINE];
+    unsigned long gen;
+} cache_ban_t;
+
+// 본문 상태 - 변경은 반드시 ptrwlock(wr)과 fill_lock을 둘 다 잡고
+typedef enum {
+    BODY_COMPLETE, // 다 채워짐
+    BODY_FILLING,  // 오리진에서 받아 채우는 중 - 리더는 채워지는 대로 따라 읽음
+    BODY_PARTIAL,  // 퇴출로 뒤쪽 청크가 잘려 앞부분만 남음
+    BODY_ABORTED   // 채우다 실패
+} body_state_t;
+
+// 본문 청크 - 본문은 청크들의 체인으로 보관
+typedef struct cache_chunk {
+    struct cache_chunk* next;
+    int length; // 채워진 바이트 수 (채우는 중인 마지막 청크는 계속 증가)
+    char* data; // 보통 CACHE_CHUNK_SIZE, 한 번에 만든 본문의 마지막 청크는 딱 맞는 크기
+                // memfd 본문이면 본문 매핑 안, 아니면 청크 구조체 바로 뒤
+} cache_chunk_t;
+
+// 캐시된 본문 - 작은 완성 본문은 풀에서 공유 (content-addressed), 스트리밍한 큰 본문은 풀 밖
+typedef struct cache_body {
+    cache_chunk_t* chunks; // 보관 형태의 본문 (압축본 또는 원본)
+    int length;
+    body_state_t state;
+    int pooled; // 1이면 본문 풀에 있음
+    size_t charged; // 풀 밖 본문이 total_cached_bytes에 반영한 바이트 (채우는 중엔 청크 단위로 미리 잡음)
+    int memfd; // 큰 (스트리밍) 본문의 저장소 - 히트 시 sendfile로 복사 없이 전송. 없으면 -1
+    char* map; // memfd 매핑 (MAX_STREAM_OBJECT_SIZE 크기, 쓴 페이지만 메모리 차지)
+    unsigned long long hash; // 청크들의 xxh64 - 풀 키
+    int refcnt; // 변형 + 스트리밍 리더 + 채우는 쪽 (증가는 원자적, 0 판정은 wrlock 하에서)
+    struct cache_body* h_next; // 풀 해시 버킷 내 체이닝
+} cache_body_t;
+
+// 하나의 응답 변형 - 같은 URI라도 Vary에 지정된 요청 헤더 값이 다르면 별개의 응답
+typedef struct cache_variant {
+    char vary_key[VARY_LEN]; // Vary 대상 요청 헤더 값들을 이어붙인 키 (Vary 없으면 "")
+    char* headers; // 응답 헤더 (빈 줄 포함, 항상 비압축) - 변형마다 따로 보관
+    int hdr_length;
+    cache_body_t* body; // 응답 본문 - 본문 풀에서 공유
+    int content_length; // hdr_length + body->length (공유 여부와 무관한 논리 크기)
+    int raw_length; // 압축 풀었을 때의 전체 응답 길이
+    int compressed; // 1이면 본문이 gzip 스트림으로 보관됨
+    time_t expires_at; // 만료 시각 (CLOCK_MONOTONIC 초), 0이면 만료 없음 - 404/410 같은 네거티브 응답용
+
+    struct cache_variant* next; // 같은 URI 내 다음 변형 (최근 사용 순)
+} cache_variant_t;
+
+// 하나의 캐시 객체 (URI 단위)
 typedef struct cache_entry {
     char uri[MAXLINE]; // 캐시된 요청 URI (key)
-    //char content[MAX_OBJECT_SIZE]; // 실제 데이터 ==> 이 사이즈 때문에 스택메모리에 넣지 말 것.
-    char* content; // 실제 데이터 ==> 이 사이즈 때문에 스택메모리에 넣지 말 것.
-    int content_length;
+    char vary[VARY_LEN]; // 응답의 Vary 헤더 (소문자, 공백 제거, 예: "accept-encoding,accept-language")
+    cache_variant_t* variants; // 변형 목록 - 대부분 1개라서 첫 노드에서 바로 히트 (O(1))
+    int variant_count;
+    int content_length; // 모든 변형의 content_length 합
+    char tags[TAGS_LEN]; // 응답의 Surrogate-Key (태그 퍼지용)
+    unsigned long gen; // 이 세대까지의 퍼지 규칙과는 무관함이 확인됨
 
     struct cache_entry* prev; // LRU 이전 노드
     struct cache_entry* next; // LRU 다음 노드
     struct cache_entry* h_next; // 해시 테이블 내 체이닝
 } cache_entry_t;
 
+// 큰 객체를 오리진에서 받으면서 청크 단위로 채우는 핸들
+typedef struct {
+    char uri[MAXLINE];
+    cache_body_t* body;
+    cache_chunk_t* tail; // 지금 채우는 청크
+} cache_fill_t;
+
+// 캐시된 본문을 청크 단위로 읽어 가는 핸들 (채우는 중인 본문도 따라 읽음)
+typedef struct {
+    char* headers; // 응답 헤더 사본 (읽는 동안 변형이 퇴출돼도 안전)
+    int hdr_length;
+    cache_body_t* body; // 참조 하나를 잡고 있음
+    cache_chunk_t* chunk; // 지금 읽는 청크 (NULL이면 아직 시작 전)
+    int chunk_off;
+    long object_length; // 전체 본문 크기 (채우는 중이면 Content-Length 기준, 모르면 -1)
+    long avail_length; // 이 리더로 읽을 수 있는 본문 크기 (잘린 본문은 남은 앞부분, 그 외엔 object_length)
+} cache_reader_t;
+
+// 오리진 연결 실패 기록 (host:port 단위)
+typedef struct {
+    char hostport[NEG_KEY_LEN]; // "host:port", 빈 문자열이면 빈 슬롯
+    time_t expires_at; // 만료 시각 (CLOCK_MONOTONIC 초)
+} neg_entry_t;
+
 // 캐시 전체 구조
 typedef struct {
     cache_entry_t* head; // LRU 리스트의 head (가장 최근)
@@ -34,20 +149,63 @@ typedef struct {
     size_t total_cached_bytes; // 현재 총 캐시된 바이트 수
 
     pthread_rwlock_t ptrwlock; // 동시 접근 제어 (read-write lock)
+
+    unsigned long generation; // 퍼지 세대 번호 - 퍼지 요청마다 1 증가
+    cache_ban_t bans[MAX_BANS]; // 아직 전체 적용 안 된 지연 퍼지 규칙들 (gen 오름차순)
+    int ban_count;
+
+    // 통계 (cache_print_stats) - rdlock 하에서도 갱신하므로 원자적 덧셈 사용
+    size_t raw_cached_bytes; // 압축 전 기준 총 바이트 ==> raw / total = 압축으로 늘어난 실효 용량 배수
+    unsigned long gzip_hits; // 압축본을 gzip 그대로 보낸 히트 수
+    unsigned long inflate_hits; // 압축 해제해서 보낸 히트 수
+    unsigned long inflate_ns; // 압축 해제에 쓴 총 시간 (ns)
+
+    pthread_mutex_t fill_lock; // 채우는 중인 본문의 청크 목록/길이/상태 보호
+    pthread_cond_t fill_cond; // 본문이 더 채워지면 broadcast
+    size_t sendfile_bytes; // 스트리밍 히트 중 sendfile로 (복사 없이) 보낸 바이트
+    size_t copied_stream_bytes; // 스트리밍 히트 중 write로 복사해서 보낸 바이트
+
+    cache_body_t* body_pool[BODY_POOL_SIZE]; // 본문 풀 (해시 버킷)
+    size_t logical_body_bytes; // 변형들이 참조하는 본문 바이트 합 (중복 포함)
+    size_t pooled_body_bytes; // 실제 보관 중인 본문 바이트 합 ==> logical / pooled = 중복 제거율
+
+    neg_entry_t neg_table[NEG_SLOTS]; // 연결 실패 네거티브 캐시 - 고정 크기, 할당 없음
+    pthread_mutex_t neg_lock; // neg_table 전용 락 (본 캐시 락과 경합하지 않도록 분리)
 } cache_t;
 
 // === 캐시 관련 API ===
 void cache_init(cache_t* cache); 
 void cache_deinit(cache_t* cache); // 캐시 전체의 메모리 해제
 cache_entry_t* cache_lookup(cache_t* cache, const char* uri, const int use_lock, const int update_lru);  // O(1) 탐색 - TODO: pthread_rwlock_unlock() 어디서 할지 나중에 결정할 것!
-void cache_insert_unmanaged(cache_t* cache, const char* uri, const char* buf, int size); // 삽입
+cache_variant_t* cache_lookup_variant(cache_entry_t* entry, const char* req_hdrs, int req_hdrs_len, const int update_mru); // Vary 기반 변형 탐색
+void cache_insert_unmanaged(cache_t* cache, const char* uri, const char* req_hdrs, int req_hdrs_len, const char* buf, int size); // 삽입
 void cache_evict_policy_unmanaged(cache_t* cache, int required_size); // 필요시 LRU 제거
 inline int cache_size(cache_t* cache); // 현재 총 캐시 바이트 수
 void cache_remove(cache_t* cache, const char* uri); // 명시적 삭제 - URI로
+unsigned long cache_ban(cache_t* cache, purge_type_t type, const char* pattern); // 지연 퍼지 - host/prefix/tag
 void cache_remove_by_entry_unmanaged(cache_t* cache, cache_entry_t* entry); // 명시적 삭제 - cache_entry_t로
 void debug_print_cache(cache_t* cache); // LRU 순서대로 출력 (디버깅)
+void cache_print_stats(cache_t* cache); // 압축/중복 제거 효과 등 통계 출력
 // 이하 함수들의 주석은 cache.c 참조.
-int cache_get(cache_t *cache, const char *uri, char *buf_out, int *size_out);
-void cache_put(cache_t *cache, const char *uri, const char *buf, int size);
+// req_hdrs: 클라이언트 요청 헤더 블록 ("Name: value\r\n" 반복), Vary 매칭에 사용
+int cache_get(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, char *buf_out, int *size_out);
+void cache_put(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, const char *buf, int size);
+// 캐시 키 정규화 (cache_get/cache_put 전에 요청당 한 번)
+int cache_normalize_uri(const char *uri, char *key_out, size_t key_max);
+void cache_set_ignored_params(const char *csv);
+// 큰 객체 청크 스트리밍 - 채우는 쪽 (cache_put이 못 받는 MAX_OBJECT_SIZE 초과 응답)
+cache_fill_t* cache_fill_begin(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, const char *hdrs, int hdr_len);
+int cache_fill_append(cache_t *cache, cache_fill_t *fill, const char *buf, int n);
+void cache_fill_end(cache_t *cache, cache_fill_t *fill, int ok);
+// 큰 객체 청크 스트리밍 - 읽는 쪽 (cache_get이 못 주는 큰 객체나 채우는 중인 객체)
+cache_reader_t* cache_open_stream(cache_t *cache, const char *uri, const char *req_hdrs, int req_hdrs_len, int flags);
+int cache_stream_seek(cache_t *cache, cache_reader_t *reader, long offset);
+ssize_t cache_stream_read(cache_t *cache, cache_reader_t *reader, const char **data_out);
+ssize_t cache_stream_send(cache_t *cache, cache_reader_t *reader, int fd, long max);
+int cache_stream_send_response(cache_t *cache, cache_reader_t *reader, int fd);
+void cache_stream_close(cache_t *cache, cache_reader_t *reader);
+// 오리진 연결 실패 네거티브 캐시
+void cache_put_connect_failure(cache_t *cache, const char *hostname, const char *port);
+int cache_connect_failed(cache_t *cache, const char *hostname, const char *port);
 
 #endif /* __CACHE_H__ */
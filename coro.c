@@ -0,0 +1,599 @@
+/**
+ * coro.c - 연결마다 스택 있는 코루틴 + 스케줄러 스레드마다 epoll 하나
+ *   - 연결 처리 코드(client_handler 이하)는 그대로: 블로킹 호출처럼 보이지만 코루틴 안에서는
+ *     링커 --wrap으로 가로챈 read/write/writev/send/sendfile/connect/poll이 EAGAIN에서 epoll에 fd를 걸고 양보.
+ *   - fd는 코루틴 안에서 처음 쓸 때 논블로킹으로 바꾸고 표시 (hooked). 처음부터 논블로킹이던 fd는
+ *     호출한 쪽이 EAGAIN을 직접 다루는 것이므로 건드리지 않음 (resolver_connect, 터널 릴레이).
+ *   - 조건 변수/세마포어 대기는 스레드를 막으면 같은 스레드의 다른 코루틴(깨워줄 쪽일 수도)이 못 돌므로
+ *     락을 풀고 CORO_SYNC_POLL_MS 쉬었다가 돌아옴 (가짜 깨어남 ==> 호출한 쪽 루프가 조건을 다시 확인).
+ *     pthread_join도 같은 방식 (pthread_tryjoin_np가 EBUSY면 쉬었다가 다시).
+ *   - 가로채지 않는 것: select ==> 그동안 그 스케줄러가 멈춤 (coro.h 참고). getaddrinfo는 리졸버가
+ *     코루틴 안에서 비동기 조회로 돌림 (resolver.c lookup_for_connect).
+ * 코루틴은 만든 스케줄러에서만 돎 (옮겨 다니지 않음) ==> __thread 변수와 errno가 그대로 유효.
+ * 작업 훔치기: 새 연결은 스케줄러마다 있는 대기 큐(아직 스택이 없는 코루틴)에 들어가고, 주인은 앞에서
+ *   CORO_TAKE_BATCH개씩 꺼내 시작함. 할 일이 없어 잠들려는 스케줄러는 다른 스케줄러 큐의 뒤쪽 절반을 가져감
+ *   ==> 느린 요청(큰 미스, getaddrinfo, 느린 원서버)이 스레드를 잡고 있는 동안 뒤에 쌓인 연결을 다른 스레드가 처리.
+ *   이미 시작한 코루틴은 훔치지 않음: fd가 그 스케줄러의 epoll에 걸려 있고, 컴파일된 코드가 errno 주소
+ *   (__errno_location)를 스레드가 바뀌어도 그대로 쓸 수 있음 ==> 시작한 곳에서 끝까지 (캐시 지역성도 유지).
+ */
+#include "coro.h"
+
+#include <limits.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+typedef struct sched {
+    int epfd;
+    int wakefd; // eventfd - 새 코루틴이 넘어왔음 (epoll data.ptr == NULL)
+    pthread_mutex_t lock; // queue_*
+    coro_t* queue_head; // 넘겨받았지만 아직 시작 안 한 코루틴 (주인은 앞에서, 훔치는 쪽은 뒤에서)
+    coro_t* queue_tail;
+    int queue_len; // 잠들기 전 훔칠 곳을 고를 때는 락 없이 읽음 (힌트)
+    int idle; // epoll_wait에서 잠들려는 중 ==> coro_submit이 깨워서 훔치게 함
+    coro_t* ready_head; // 실행 대기열 (이 스레드만 씀)
+    coro_t* ready_tail;
+    coro_t* sleepers; // 시간 대기 (짧음 - 선형 탐색)
+    coro_t* current; // 지금 도는 코루틴 (NULL이면 스케줄러 자신)
+    ucontext_t main_ctx;
+    char* stacks[CORO_STACK_POOL]; // 다 쓴 스택 (mmap/munmap을 줄임)
+    int nstacks;
+    unsigned long switches; // 코루틴으로 들어간 횟수
+    unsigned long stolen; // 다른 스케줄러 큐에서 가져온 코루틴 수
+} sched_t;
+
+static struct {
+    sched_t* scheds;
+    int count;
+    int steal; // 작업 훔치기 사용 (PROXY_CORO_STEAL)
+    unsigned long next; // 라운드 로빈
+    // 통계 (__sync로 갱신)
+    unsigned long spawned;
+    unsigned long active;
+    unsigned long stack_peak; // 스택에서 실제로 건드린 최대 바이트 (mincore)
+} coros;
+
+static __thread sched_t* t_sched; // NULL이면 스케줄러 스레드가 아님 ==> 가로챈 호출은 원래대로
+static unsigned char hooked[CORO_MAX_FDS]; // 코루틴이 논블로킹으로 바꾼 fd (close에서 지움)
+static long page_size;
+
+ssize_t __real_read(int fd, void* buf, size_t count);
+ssize_t __real_write(int fd, const void* buf, size_t count);
+ssize_t __real_writev(int fd, const struct iovec* iov, int iovcnt);
+ssize_t __real_send(int fd, const void* buf, size_t len, int flags);
+ssize_t __real_sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+int __real_connect(int fd, const struct sockaddr* addr, socklen_t addrlen);
+int __real_poll(struct pollfd* fds, nfds_t nfds, int timeout);
+int __real_close(int fd);
+int __real_pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+int __real_sem_wait(sem_t* sem);
+int __real_pthread_join(pthread_t thread, void** retval);
+int pthread_tryjoin_np(pthread_t thread, void** retval); // csapp.h와 _GNU_SOURCE가 충돌해서 직접 선언
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000l + ts.tv_nsec / 1000000;
+}
+
+/* 이하 sched_* / stack_* 함수는 그 스케줄러 스레드에서만 호출 (락 없음) */
+
+static char* stack_get(sched_t* s) {
+    char* stack;
+
+    if (s->nstacks > 0)
+        return s->stacks[--s->nstacks];
+    stack = mmap(NULL, page_size + CORO_STACK_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED)
+        unix_error("stack_get: mmap error");
+    if (mprotect(stack, page_size, PROT_NONE) < 0) // 맨 아래 가드 페이지 - 넘치면 SIGSEGV (옆 스택을 덮지 않음)
+        unix_error("stack_get: mprotect error");
+    return stack;
+}
+
+/**
+ * stack_put - 다 쓴 스택을 풀로 (건드린 페이지 수를 mincore로 재서 최대값 기록)
+ */
+static void stack_put(sched_t* s, char* stack) {
+    unsigned char vec[CORO_STACK_SIZE / 4096 + 1];
+    unsigned long touched = 0;
+
+    if (mincore(stack + page_size, CORO_STACK_SIZE, vec) == 0) {
+        for (long i = 0; i < CORO_STACK_SIZE / page_size; ++i)
+            touched += (vec[i] & 1) * page_size;
+        if (touched > coros.stack_peak)
+            coros.stack_peak = touched; // 통계일 뿐이라 경쟁은 무시
+    }
+    if (s->nstacks < CORO_STACK_POOL)
+        s->stacks[s->nstacks++] = stack;
+    else
+        munmap(stack, page_size + CORO_STACK_SIZE);
+}
+
+static void sched_ready(sched_t* s, coro_t* co) {
+    if (co->queued)
+        return;
+    co->queued = 1;
+    co->next = NULL;
+    if (s->ready_tail)
+        s->ready_tail->next = co;
+    else
+        s->ready_head = co;
+    s->ready_tail = co;
+}
+
+static void sched_sleep_cancel(sched_t* s, coro_t* co) {
+    for (coro_t** p = &s->sleepers; *p; p = &(*p)->sleep_next) {
+        if (*p == co) {
+            *p = co->sleep_next;
+            break;
+        }
+    }
+    co->wake_at = 0;
+}
+
+static void coro_entry(void) {
+    coro_t* co = t_sched->current;
+    co->fn(co->arg);
+    co->done = 1; // 돌아가면 uc_link(스케줄러)로
+}
+
+static void sched_resume(sched_t* s, coro_t* co) {
+    co->queued = 0;
+    s->current = co;
+    s->switches++;
+    swapcontext(&s->main_ctx, &co->ctx);
+    s->current = NULL;
+    if (co->done) {
+        stack_put(s, co->stack);
+        Free(co);
+        __sync_fetch_and_sub(&coros.active, 1);
+    }
+}
+
+/* 코루틴에서 스케줄러로 (누가 sched_ready 해줄 때까지 안 돌아옴) */
+static void coro_switch_out(void) {
+    coro_t* co = t_sched->current;
+    swapcontext(&co->ctx, &t_sched->main_ctx);
+}
+
+/**
+ * coro_park - 깨워줄 것(fd 등록)을 걸어둔 뒤 양보. timeout_ms >= 0이면 그 시간 뒤에도 깨어남.
+ */
+static void coro_park(int timeout_ms) {
+    sched_t* s = t_sched;
+    coro_t* co = s->current;
+
+    if (timeout_ms >= 0) {
+        co->wake_at = now_ms() + timeout_ms;
+        co->sleep_next = s->sleepers;
+        s->sleepers = co;
+    }
+    coro_switch_out();
+    if (co->wake_at)
+        sched_sleep_cancel(s, co); // fd로 먼저 깨어남
+}
+
+/**
+ * coro_wait_fd - fd가 events가 될 때까지 양보 (EPOLLONESHOT - 한 번 깨우면 자동으로 꺼짐)
+ * 가짜로 깨어날 수 있음 ==> 호출한 쪽은 다시 시도하고 또 EAGAIN이면 다시 기다림.
+ */
+static void coro_wait_fd(int fd, unsigned events) {
+    sched_t* s = t_sched;
+    struct epoll_event ev = { .events = events | EPOLLONESHOT, .data.ptr = s->current };
+
+    if (epoll_ctl(s->epfd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+        (errno != ENOENT || epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)) {
+        coro_park(CORO_SYNC_POLL_MS); // epoll에 못 거는 fd ==> 잠깐 쉬고 다시 시도
+        return;
+    }
+    coro_park(-1);
+}
+
+/**
+ * sched_start - 넘겨받은 코루틴에 스택을 붙여 실행 대기열로 (여기서부터 이 스케줄러 소속)
+ */
+static void sched_start(sched_t* s, coro_t* co) {
+    co->sched = s;
+    co->stack = stack_get(s);
+    getcontext(&co->ctx);
+    co->ctx.uc_stack.ss_sp = co->stack + page_size;
+    co->ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+    co->ctx.uc_link = &s->main_ctx;
+    makecontext(&co->ctx, coro_entry, 0);
+    sched_ready(s, co);
+}
+
+/**
+ * sched_take_own - 자기 큐 앞에서 CORO_TAKE_BATCH개까지 시작 (나머지는 큐에 남아 훔쳐갈 수 있음)
+ */
+static void sched_take_own(sched_t* s) {
+    coro_t* list;
+    int n = 0;
+
+    pthread_mutex_lock(&s->lock);
+    list = s->queue_head;
+    for (coro_t* co = list; co && n < CORO_TAKE_BATCH; co = co->next) {
+        s->queue_head = co->next;
+        n++;
+    }
+    if (s->queue_head == NULL)
+        s->queue_tail = NULL;
+    s->queue_len -= n;
+    pthread_mutex_unlock(&s->lock);
+
+    while (n-- > 0) {
+        coro_t* co = list;
+        list = co->next;
+        sched_start(s, co);
+    }
+}
+
+/**
+ * sched_steal - 가장 많이 쌓인 다른 스케줄러 큐에서 뒤쪽 절반(적어도 하나)을 가져와 시작
+ * 주인이 제일 늦게 꺼낼 연결부터 가져감 ==> 주인은 앞쪽을 그대로 이어서 처리.
+ * @return 가져온 코루틴 수
+ */
+static int sched_steal(sched_t* s) {
+    sched_t* victim = NULL;
+    coro_t* list = NULL;
+    int n = 0;
+
+    for (int i = 0; i < coros.count; ++i) {
+        sched_t* o = &coros.scheds[i];
+        if (o != s && o->queue_len > 0 && (victim == NULL || o->queue_len > victim->queue_len))
+            victim = o;
+    }
+    if (victim == NULL)
+        return 0;
+
+    pthread_mutex_lock(&victim->lock);
+    int take = (victim->queue_len + 1) / 2;
+    if (take > 0) {
+        // 뒤에서 take개 = 앞에서 queue_len - take개 건너뛴 다음부터
+        coro_t* prev = NULL;
+        list = victim->queue_head;
+        for (int skip = victim->queue_len - take; skip > 0; --skip) {
+            prev = list;
+            list = list->next;
+        }
+        if (prev)
+            prev->next = NULL;
+        else
+            victim->queue_head = NULL;
+        victim->queue_tail = prev;
+        victim->queue_len -= take;
+        n = take;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    while (list) {
+        coro_t* co = list;
+        list = co->next;
+        sched_start(s, co);
+    }
+    s->stolen += n;
+    return n;
+}
+
+static void* sched_thread(void* arg) {
+    sched_t* s = arg;
+    struct epoll_event events[CORO_MAX_EVENTS];
+
+    pthread_detach(pthread_self());
+    t_sched = s;
+    while (1) {
+        int timeout = -1;
+        if (s->ready_head || s->queue_len > 0) {
+            timeout = 0;
+        } else if (coros.steal && (__sync_lock_test_and_set(&s->idle, 1), sched_steal(s) > 0)) {
+            // idle 표시를 먼저 ==> 표시 뒤에 들어온 연결은 coro_submit이 깨워줌 (놓치지 않음)
+            s->idle = 0;
+            timeout = 0;
+        } else if (s->sleepers) {
+            long now = now_ms(), first = s->sleepers->wake_at;
+            for (coro_t* co = s->sleepers->sleep_next; co; co = co->sleep_next)
+                if (co->wake_at < first)
+                    first = co->wake_at;
+            timeout = first > now ? first - now : 0;
+        }
+
+        int n = epoll_wait(s->epfd, events, CORO_MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+            unix_error("sched_thread: epoll_wait error");
+        s->idle = 0;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t count;
+                if (__real_read(s->wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                    unix_error("sched_thread: eventfd read error");
+            } else {
+                sched_ready(s, events[i].data.ptr);
+            }
+        }
+        if (s->queue_len > 0)
+            sched_take_own(s);
+        else if (coros.steal && !s->ready_head && n > 0)
+            sched_steal(s); // 깨운 쪽이 바쁜 스케줄러에 넘긴 연결
+        if (s->sleepers) {
+            long now = now_ms();
+            for (coro_t** p = &s->sleepers; *p;) {
+                coro_t* co = *p;
+                if (co->wake_at <= now) {
+                    *p = co->sleep_next;
+                    co->wake_at = 0;
+                    sched_ready(s, co);
+                } else {
+                    p = &co->sleep_next;
+                }
+            }
+        }
+
+        // 지금 준비된 것만 한 바퀴 (돌면서 양보한 코루틴은 다음 바퀴 - epoll도 한 번씩 보게)
+        coro_t* run = s->ready_head;
+        s->ready_head = s->ready_tail = NULL;
+        while (run) {
+            coro_t* co = run;
+            run = co->next;
+            sched_resume(s, co);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * coro_start - 스케줄러 스레드 nthreads개 시작 (0이면 안 띄움 ==> coro_submit이 -1)
+ * @param steal 0이 아니면 잠들려는 스케줄러가 다른 스케줄러의 대기 큐를 훔쳐 감
+ */
+void coro_start(int nthreads, int steal) {
+    pthread_t tid;
+
+    if (nthreads <= 0)
+        return;
+    page_size = sysconf(_SC_PAGESIZE);
+    coros.scheds = Calloc(nthreads, sizeof(sched_t));
+    for (int i = 0; i < nthreads; ++i) {
+        sched_t* s = &coros.scheds[i];
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+
+        if ((s->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            unix_error("coro_start: epoll_create1 error");
+        if ((s->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            unix_error("coro_start: eventfd error");
+        if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->wakefd, &ev) < 0)
+            unix_error("coro_start: epoll_ctl error");
+        pthread_mutex_init(&s->lock, NULL);
+        if (pthread_create(&tid, NULL, sched_thread, s) != 0)
+            posix_error(errno, "coro_start: pthread_create error");
+    }
+    coros.steal = steal;
+    coros.count = nthreads;
+}
+
+/**
+ * coro_submit - fn(arg)를 코루틴으로 돌림 (라운드 로빈으로 고른 스케줄러 큐로 - 그 전에 다른 스케줄러가 훔쳐갈 수 있음,
+ *   스택은 시작하는 스케줄러가 붙임)
+ * @return 0 넘김, 스케줄러가 없으면 -1 (호출한 쪽이 스레드로 처리)
+ */
+int coro_submit(void (*fn)(void* arg), void* arg) {
+    coro_t* co;
+    sched_t* s;
+    uint64_t one = 1;
+
+    if (coros.count == 0)
+        return -1;
+    co = Calloc(1, sizeof(coro_t));
+    co->fn = fn;
+    co->arg = arg;
+    s = &coros.scheds[__sync_fetch_and_add(&coros.next, 1) % coros.count];
+    __sync_fetch_and_add(&coros.spawned, 1);
+    __sync_fetch_and_add(&coros.active, 1);
+
+    pthread_mutex_lock(&s->lock);
+    co->next = NULL;
+    if (s->queue_tail)
+        s->queue_tail->next = co;
+    else
+        s->queue_head = co;
+    s->queue_tail = co;
+    s->queue_len++;
+    pthread_mutex_unlock(&s->lock);
+    if (__real_write(s->wakefd, &one, sizeof(one)) < 0)
+        unix_error("coro_submit: eventfd write error");
+
+    // 받은 스케줄러가 다른 코루틴을 돌리는 중이면 잠든 스케줄러 하나를 깨워 가져가게 함
+    if (coros.steal && !s->idle) {
+        for (int i = 0; i < coros.count; ++i) {
+            sched_t* o = &coros.scheds[i];
+            if (o != s && o->idle && __sync_bool_compare_and_swap(&o->idle, 1, 0)) {
+                if (__real_write(o->wakefd, &one, sizeof(one)) < 0)
+                    unix_error("coro_submit: eventfd write error");
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+int coro_running(void) {
+    return t_sched != NULL && t_sched->current != NULL;
+}
+
+/**
+ * coro_yield - 다른 준비된 코루틴과 epoll 이벤트를 한 번 돌린 뒤 이어서 (코루틴 밖이면 아무것도 안 함)
+ */
+void coro_yield(void) {
+    if (!coro_running())
+        return;
+    sched_ready(t_sched, t_sched->current);
+    coro_switch_out();
+}
+
+/**
+ * coro_sleep - ms 동안 양보 (코루틴 밖이면 그냥 잠)
+ */
+void coro_sleep(int ms) {
+    if (!coro_running()) {
+        usleep(ms * 1000);
+        return;
+    }
+    coro_park(ms);
+}
+
+/**
+ * coro_print_stats - 코루틴 통계 (훔쳐 온 수, 문맥 교환 수, 스택에서 실제로 쓴 최대 크기)
+ */
+void coro_print_stats(void) {
+    unsigned long switches = 0, stolen = 0;
+
+    for (int i = 0; i < coros.count; ++i) {
+        switches += coros.scheds[i].switches;
+        stolen += coros.scheds[i].stolen;
+    }
+    printf("Coroutine: %d schedulers, %lu spawned, %lu stolen, %lu active, %lu switches, stack peak %lu KB of %d KB\n",
+           coros.count, coros.spawned, stolen, coros.active, switches, coros.stack_peak >> 10, CORO_STACK_SIZE >> 10);
+}
+
+/*
+ * 가로챈 호출들 (Makefile의 -Wl,--wrap=...) - 코루틴 밖이거나 hook_fd가 0이면 원래 호출 그대로.
+ */
+
+/**
+ * hook_fd - 코루틴 안에서 이 fd를 양보하는 방식으로 다룰지 (처음 보는 블로킹 fd는 논블로킹으로 바꿈)
+ */
+static int hook_fd(int fd) {
+    int flags;
+
+    if (!coro_running() || fd < 0 || fd >= CORO_MAX_FDS)
+        return 0;
+    if (hooked[fd])
+        return 1;
+    if ((flags = fcntl(fd, F_GETFL)) < 0 || (flags & O_NONBLOCK))
+        return 0; // 처음부터 논블로킹 ==> 호출한 쪽이 EAGAIN을 다룸
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return 0;
+    hooked[fd] = 1;
+    return 1;
+}
+
+#define CORO_RETRY(fd, events, call) do { \
+    ssize_t rc_; \
+    if (!hook_fd(fd)) \
+        return call; \
+    while ((rc_ = call) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) \
+        coro_wait_fd(fd, events); \
+    return rc_; \
+} while (0)
+
+ssize_t __wrap_read(int fd, void* buf, size_t count) {
+    CORO_RETRY(fd, EPOLLIN, __real_read(fd, buf, count));
+}
+
+ssize_t __wrap_write(int fd, const void* buf, size_t count) {
+    CORO_RETRY(fd, EPOLLOUT, __real_write(fd, buf, count));
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec* iov, int iovcnt) {
+    CORO_RETRY(fd, EPOLLOUT, __real_writev(fd, iov, iovcnt));
+}
+
+ssize_t __wrap_send(int fd, const void* buf, size_t len, int flags) {
+    CORO_RETRY(fd, EPOLLOUT, __real_send(fd, buf, len, flags));
+}
+
+ssize_t __wrap_sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+    CORO_RETRY(out_fd, EPOLLOUT, __real_sendfile(out_fd, in_fd, offset, count));
+}
+
+int __wrap_connect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    socklen_t len = sizeof(int);
+    int err;
+
+    if (!hook_fd(fd))
+        return __real_connect(fd, addr, addrlen);
+    if (__real_connect(fd, addr, addrlen) == 0)
+        return 0;
+    if (errno != EINPROGRESS)
+        return -1;
+    do
+        coro_wait_fd(fd, EPOLLOUT);
+    while (__real_poll(&pfd, 1, 0) == 0);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        return -1;
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * __wrap_poll - 코루틴이면 fd들을 epoll에 걸고 (timeout이 있으면 그 시간까지) 양보. 깨어나면 등록을 지우고 다시 확인.
+ */
+int __wrap_poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+    long deadline = timeout >= 0 ? now_ms() + timeout : -1;
+    int rc;
+
+    if (!coro_running())
+        return __real_poll(fds, nfds, timeout);
+    while ((rc = __real_poll(fds, nfds, 0)) == 0) {
+        long left = deadline < 0 ? -1 : deadline - now_ms();
+        if (deadline >= 0 && left <= 0)
+            break;
+        for (nfds_t i = 0; i < nfds; ++i) {
+            struct epoll_event ev = { .events = EPOLLONESHOT, .data.ptr = t_sched->current };
+            if (fds[i].events & POLLIN)
+                ev.events |= EPOLLIN;
+            if (fds[i].events & POLLOUT)
+                ev.events |= EPOLLOUT;
+            if (fds[i].fd >= 0 && epoll_ctl(t_sched->epfd, EPOLL_CTL_MOD, fds[i].fd, &ev) < 0)
+                epoll_ctl(t_sched->epfd, EPOLL_CTL_ADD, fds[i].fd, &ev);
+        }
+        coro_park(left < 0 || left > INT_MAX ? -1 : left);
+        for (nfds_t i = 0; i < nfds; ++i) // 남은 등록이 나중에 엉뚱한 때 이 코루틴을 깨우지 않게
+            if (fds[i].fd >= 0)
+                epoll_ctl(t_sched->epfd, EPOLL_CTL_DEL, fds[i].fd, NULL);
+    }
+    return rc;
+}
+
+int __wrap_close(int fd) {
+    if (fd >= 0 && fd < CORO_MAX_FDS)
+        hooked[fd] = 0;
+    return __real_close(fd);
+}
+
+int __wrap_pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    if (!coro_running())
+        return __real_pthread_cond_wait(cond, mutex);
+    pthread_mutex_unlock(mutex);
+    coro_park(CORO_SYNC_POLL_MS);
+    pthread_mutex_lock(mutex);
+    return 0;
+}
+
+int __wrap_sem_wait(sem_t* sem) {
+    if (!coro_running())
+        return __real_sem_wait(sem);
+    while (sem_trywait(sem) < 0) {
+        if (errno != EAGAIN && errno != EINTR)
+            return -1;
+        coro_park(CORO_SYNC_POLL_MS);
+    }
+    return 0;
+}
+
+int __wrap_pthread_join(pthread_t thread, void** retval) {
+    int rc;
+
+    if (!coro_running())
+        return __real_pthread_join(thread, retval);
+    while ((rc = pthread_tryjoin_np(thread, retval)) == EBUSY)
+        coro_park(CORO_SYNC_POLL_MS);
+    return rc;
+}
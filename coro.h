@@ -0,0 +1,55 @@
+#ifndef __CORO_H__
+#define __CORO_H__
+
+#include "csapp.h"
+
+#include <ucontext.h>
+
+#define CORO_THREADS 0 // 기본 스케줄러 스레드 수 (PROXY_CORO_THREADS) - 0이면 예전처럼 연결마다 스레드
+#define CORO_STACK_SIZE (64<<10) // 코루틴 스택 (아래에 가드 페이지 하나 더) - 실제로 차지하는 건 건드린 페이지만
+                                // 요청 경로의 큰 버퍼는 req->arena에 있어야 함 (stack peak 통계로 확인)
+#define CORO_STACK_POOL 256 // 스케줄러마다 다시 쓰려고 남겨두는 스택 수
+#define CORO_MAX_EVENTS 256 // epoll_wait 한 번에 받는 이벤트 수
+#define CORO_MAX_FDS 65536 // 훅 대상 fd 번호 상한 (넘는 fd는 그냥 블로킹)
+#define CORO_SYNC_POLL_MS 1 // 조건 변수/세마포어 대기를 양보로 바꿀 때 다시 확인하는 간격
+#define CORO_STEAL 1 // 작업 훔치기 (PROXY_CORO_STEAL) - 0이면 넘겨받은 스케줄러가 끝까지 처리
+#define CORO_TAKE_BATCH 4 // 스케줄러가 한 바퀴에 자기 큐에서 시작하는 새 코루틴 수 (남은 건 훔쳐갈 수 있음)
+
+struct sched;
+
+/*
+ * 알려진 한계 (PROXY_CORO_THREADS > 0일 때):
+ *   - pthread_cond_wait/sem_wait/pthread_join은 진짜로 깨워주는 쪽이 없음. 코루틴은 CORO_SYNC_POLL_MS마다
+ *     다시 확인하므로 signal/post/스레드 종료에서 최대 그만큼 늦게 깨어남 (스트리밍 캐시 리더가 채우는 쪽을
+ *     따라갈 때 청크마다 최대 1ms, 세그먼트 스레드를 기다릴 때도 마찬가지). 그동안 스케줄러는 다른 코루틴을 돌림.
+ *   - select(tunnel_relay)는 가로채지 않음 ==> 호출 동안 그 스케줄러의 코루틴 전부가 멈춤.
+ *     시작 전 코루틴은 다른 스케줄러가 훔쳐 갈 수 있지만 이미 시작한 것은 기다려야 함.
+ *     (리졸버 캐시 미스는 resolver_open_clientfd가 조회 스레드 + eventfd + poll로 기다리므로 멈추지 않음)
+ *   - 비용 측정은 bench/coro_bench.c (make bench).
+ */
+
+/**
+ * 코루틴 하나 - 연결 하나를 처리하는 함수가 자기 스택에서 돎.
+ * 블로킹처럼 보이는 호출(read/write/connect/poll...)이 EAGAIN이면 epoll에 fd를 걸고 스케줄러로 돌아감.
+ */
+typedef struct coro {
+    ucontext_t ctx;
+    char* stack; // mmap 영역 (가드 페이지 포함)
+    void (*fn)(void* arg);
+    void* arg;
+    struct sched* sched; // 이 코루틴을 돌리는 스케줄러 (옮겨 다니지 않음 ==> TLS, errno 그대로 유효)
+    struct coro* next; // 실행 대기열 / 시작 전 대기 큐
+    struct coro* sleep_next; // 시간 대기 리스트
+    long wake_at; // 시간 대기 만료 (밀리초, 0이면 없음)
+    int queued; // 실행 대기열에 있음 (같은 묶음의 중복 이벤트 무시)
+    int done;
+} coro_t;
+
+void coro_start(int nthreads, int steal);
+int coro_submit(void (*fn)(void* arg), void* arg);
+int coro_running(void);
+void coro_yield(void);
+void coro_sleep(int ms);
+void coro_print_stats(void);
+
+#endif
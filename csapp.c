@@ -792,6 +792,90 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n)
 }
 /* $end rio_writen */
 
+/*
+ * rio_sendv - Write every byte described by an iovec array (unbuffered).
+ *    flags < 0 uses writev; otherwise sendmsg with those flags (sockets
+ *    only). The array is consumed in place on short writes.
+ */
+/* $begin rio_sendv */
+static ssize_t rio_sendv(int fd, struct iovec *iov, int iovcnt, int flags) 
+{
+    ssize_t total = 0;
+    ssize_t nwritten;
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    while (iovcnt > 0) {
+	if (iov->iov_len == 0) {  /* Skip empty entries */
+	    iov++;
+	    iovcnt--;
+	    continue;
+	}
+	if (flags < 0)
+	    nwritten = writev(fd, iov, iovcnt < UIO_MAXIOV ? iovcnt : UIO_MAXIOV);
+	else {
+	    msg.msg_iov = iov;
+	    msg.msg_iovlen = iovcnt < UIO_MAXIOV ? iovcnt : UIO_MAXIOV;
+	    nwritten = sendmsg(fd, &msg, flags);
+	}
+	if (nwritten <= 0) {
+	    if (errno == EINTR)  /* Interrupted by sig handler return */
+		continue;        /* and call writev() again */
+	    else
+		return -1;       /* errno set by writev() */
+	}
+	total += nwritten;
+	while (iovcnt > 0 && nwritten >= (ssize_t)iov->iov_len) {
+	    nwritten -= iov->iov_len;
+	    iov++;
+	    iovcnt--;
+	}
+	if (iovcnt > 0) {    /* Partially written entry */
+	    iov->iov_base = (char *)iov->iov_base + nwritten;
+	    iov->iov_len -= nwritten;
+	}
+    }
+    return total;
+}
+/* $end rio_sendv */
+
+/*
+ * rio_writev - Robustly write every byte described by an iovec array
+ *    with as few writev calls as possible (unbuffered). The array is
+ *    consumed in place on short writes.
+ */
+/* $begin rio_writev */
+ssize_t rio_writev(int fd, struct iovec *iov, int iovcnt) 
+{
+    return rio_sendv(fd, iov, iovcnt, -1);
+}
+/* $end rio_writev */
+
+
+/* 
+ * rio_fill - Refill the internal buffer if it is empty. Unread bytes
+ *    are first moved to the front so that the next read() can append
+ *    after them (needed when a line straddles the end of the buffer).
+ *    Returns the number of unread bytes, 0 on EOF, -1 on error.
+ */
+/* $begin rio_fill */
+static ssize_t rio_fill(rio_t *rp)
+{
+    ssize_t n;
+
+    if (rp->rio_bufptr != rp->rio_base) {  /* Compact */
+	memmove(rp->rio_base, rp->rio_bufptr, rp->rio_cnt);
+	rp->rio_bufptr = rp->rio_base;
+    }
+    while ((n = read(rp->rio_fd, rp->rio_base + rp->rio_cnt, 
+		     rp->rio_size - rp->rio_cnt)) < 0) {
+	if (errno != EINTR) /* Interrupted by sig handler return */
+	    return -1;
+    }
+    rp->rio_cnt += n;
+    return n == 0 ? 0 : rp->rio_cnt;
+}
+/* $end rio_fill */
 
 /* 
  * rio_read - This is a wrapper for the Unix read() function that
@@ -806,17 +890,10 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
 {
     int cnt;
 
-    while (rp->rio_cnt <= 0) {  /* Refill if buf is empty */
-	rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, 
-			   sizeof(rp->rio_buf));
-	if (rp->rio_cnt < 0) {
-	    if (errno != EINTR) /* Interrupted by sig handler return */
-		return -1;
-	}
-	else if (rp->rio_cnt == 0)  /* EOF */
-	    return 0;
-	else 
-	    rp->rio_bufptr = rp->rio_buf; /* Reset buffer ptr */
+    if (rp->rio_cnt <= 0) {  /* Refill if buf is empty */
+	ssize_t rc = rio_fill(rp);
+	if (rc <= 0)
+	    return rc;
     }
 
     /* Copy min(n, rp->rio_cnt) bytes from internal buf to user buf */
@@ -835,15 +912,31 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
  */
 /* $begin rio_readinitb */
 void rio_readinitb(rio_t *rp, int fd) 
+{
+    rio_readinitbuf(rp, fd, rp->rio_buf, RIO_BUFSIZE);
+}
+/* $end rio_readinitb */
+
+/*
+ * rio_readinitbuf - Like rio_readinitb, but read through a caller-supplied
+ *    buffer of the given size (e.g. a larger one for bulk transfers).
+ *    The buffer must outlive the rio_t.
+ */
+/* $begin rio_readinitbuf */
+void rio_readinitbuf(rio_t *rp, int fd, char *buf, size_t size) 
 {
     rp->rio_fd = fd;  
     rp->rio_cnt = 0;  
-    rp->rio_bufptr = rp->rio_buf;
+    rp->rio_base = buf;
+    rp->rio_size = size;
+    rp->rio_bufptr = buf;
 }
-/* $end rio_readinitb */
+/* $end rio_readinitbuf */
 
 /*
  * rio_readnb - Robustly read n bytes (buffered)
+ *    Once the internal buffer is drained, requests at least as large as
+ *    the buffer are read straight into the user buffer.
  */
 /* $begin rio_readnb */
 ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n) 
@@ -853,7 +946,11 @@ ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n)
     char *bufp = usrbuf;
     
     while (nleft > 0) {
-	if ((nread = rio_read(rp, bufp, nleft)) < 0) 
+	if (rp->rio_cnt <= 0 && nleft >= rp->rio_size)
+	    nread = rio_readn(rp->rio_fd, bufp, nleft);
+	else
+	    nread = rio_read(rp, bufp, nleft);
+	if (nread < 0) 
             return -1;          /* errno set by read() */ 
 	else if (nread == 0)
 	    break;              /* EOF */
@@ -866,36 +963,329 @@ ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n)
 
 /* 
  * rio_readlineb - Robustly read a text line (buffered)
+ *    Scans the internal buffer with memchr and copies whole runs at once.
  */
 /* $begin rio_readlineb */
 ssize_t rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen) 
 {
-    int n, rc;
-    char c, *bufp = usrbuf;
-
-    for (n = 1; n < maxlen; n++) { 
-        if ((rc = rio_read(rp, &c, 1)) == 1) {
-	    *bufp++ = c;
-	    if (c == '\n') {
-                n++;
-     		break;
-            }
-	} else if (rc == 0) {
-	    if (n == 1)
-		return 0; /* EOF, no data read */
-	    else
-		break;    /* EOF, some data was read */
-	} else
-	    return -1;	  /* Error */
+    size_t n = 0;
+    char *bufp = usrbuf;
+
+    while (n + 1 < maxlen) { 
+	if (rp->rio_cnt <= 0) {
+	    ssize_t rc = rio_fill(rp);
+	    if (rc < 0)
+		return -1;	  /* Error */
+	    if (rc == 0)
+		break;    /* EOF */
+	}
+	size_t cnt = maxlen - 1 - n;
+	if (cnt > (size_t)rp->rio_cnt)
+	    cnt = rp->rio_cnt;
+	char *nl = memchr(rp->rio_bufptr, '\n', cnt);
+	if (nl)
+	    cnt = nl - rp->rio_bufptr + 1;
+	memcpy(bufp + n, rp->rio_bufptr, cnt);
+	rp->rio_bufptr += cnt;
+	rp->rio_cnt -= cnt;
+	n += cnt;
+	if (nl)
+	    break;
     }
-    *bufp = 0;
-    return n-1;
+    bufp[n] = 0;
+    return n;
 }
 /* $end rio_readlineb */
 
+/*
+ * rio_peekb - Return a pointer to the unread bytes in the internal buffer
+ *    without copying (refilling first if it is empty). The bytes stay
+ *    unread until rio_consumeb().
+ *    Returns the number of bytes available, 0 on EOF, -1 on error.
+ */
+/* $begin rio_peekb */
+ssize_t rio_peekb(rio_t *rp, const char **bufp) 
+{
+    if (rp->rio_cnt <= 0) {
+	ssize_t rc = rio_fill(rp);
+	if (rc <= 0)
+	    return rc;
+    }
+    *bufp = rp->rio_bufptr;
+    return rp->rio_cnt;
+}
+/* $end rio_peekb */
+
+/*
+ * rio_peeklineb - Like rio_peekb, but for the next text line: returns its
+ *    length including the '\n'. A line that does not fit in the buffer,
+ *    or a last line without '\n' at EOF, is returned as far as it goes.
+ *    The line is not NUL-terminated.
+ */
+/* $begin rio_peeklineb */
+ssize_t rio_peeklineb(rio_t *rp, const char **linep) 
+{
+    char *nl;
+    ssize_t rc;
+
+    while ((nl = memchr(rp->rio_bufptr, '\n', rp->rio_cnt)) == NULL) {
+	if ((size_t)rp->rio_cnt == rp->rio_size)
+	    break;        /* Line longer than the buffer */
+	if ((rc = rio_fill(rp)) < 0)
+	    return -1;
+	if (rc == 0)
+	    break;        /* EOF */
+    }
+    *linep = rp->rio_bufptr;
+    return nl ? nl - rp->rio_bufptr + 1 : rp->rio_cnt;
+}
+/* $end rio_peeklineb */
+
+/*
+ * rio_consumeb - Mark n peeked bytes as read
+ */
+/* $begin rio_consumeb */
+void rio_consumeb(rio_t *rp, size_t n) 
+{
+    if (n > (size_t)rp->rio_cnt)
+	n = rp->rio_cnt;
+    rp->rio_bufptr += n;
+    rp->rio_cnt -= n;
+}
+/* $end rio_consumeb */
+
+/*
+ * Non-blocking variants - for descriptors with O_NONBLOCK set, driven by
+ * select/poll/epoll. Unfinished work stays in the caller's state (the rio
+ * buffer for reads, *offp for writes) and -1 with errno == EAGAIN means
+ * "call again when the descriptor is ready". They never call unix_error,
+ * and writes use MSG_NOSIGNAL so a closed peer cannot kill the process.
+ * (rio_peekb and rio_peeklineb already behave this way.)
+ */
+
+/*
+ * rio_readb_nb - Read whatever is buffered or available now, up to n bytes
+ *    Returns the byte count, 0 on EOF, -1 on error or EAGAIN.
+ */
+/* $begin rio_readb_nb */
+ssize_t rio_readb_nb(rio_t *rp, void *usrbuf, size_t n) 
+{
+    return rio_read(rp, usrbuf, n);
+}
+/* $end rio_readb_nb */
+
+/*
+ * rio_readlineb_nb - Non-blocking rio_readlineb: a line is returned only
+ *    once it is complete (or fills the rio buffer, or is ended by EOF).
+ *    Until then the partial line is kept in the rio buffer across calls.
+ *    A line longer than maxlen-1 is truncated like rio_readlineb does,
+ *    the rest is returned by the next call.
+ */
+/* $begin rio_readlineb_nb */
+ssize_t rio_readlineb_nb(rio_t *rp, void *usrbuf, size_t maxlen) 
+{
+    const char *line;
+    ssize_t n;
+
+    if ((n = rio_peeklineb(rp, &line)) <= 0)
+	return n;                  /* EOF, error or EAGAIN */
+    if ((size_t)n > maxlen - 1)
+	n = maxlen - 1;
+    memcpy(usrbuf, line, n);
+    ((char *)usrbuf)[n] = 0;
+    rio_consumeb(rp, n);
+    return n;
+}
+/* $end rio_readlineb_nb */
+
+/*
+ * rio_writen_nb - Write usrbuf[*offp, n) until done or the descriptor
+ *    would block, advancing *offp. Start with *offp == 0 and call again
+ *    with the same buffer when the descriptor is writable.
+ *    Returns the bytes still unwritten (0 when done), -1 on error.
+ */
+/* $begin rio_writen_nb */
+ssize_t rio_writen_nb(int fd, void *usrbuf, size_t n, size_t *offp) 
+{
+    char *bufp = usrbuf;
+    ssize_t nwritten;
+
+    while (*offp < n) {
+	nwritten = send(fd, bufp + *offp, n - *offp, MSG_NOSIGNAL);
+	if (nwritten < 0 && errno == ENOTSOCK)  /* Pipes, files */
+	    nwritten = write(fd, bufp + *offp, n - *offp);
+	if (nwritten < 0) {
+	    if (errno == EINTR)  /* Interrupted by sig handler return */
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		break;
+	    return -1;           /* errno set by write() */
+	}
+	*offp += nwritten;
+    }
+    return n - *offp;
+}
+/* $end rio_writen_nb */
+
+/*
+ * The Wio package - a coalescing buffered writer. Small writes (header
+ *    lines) collect in the buffer; it goes out in one system call when
+ *    it fills, together with the first large write (a body), or on an
+ *    explicit flush. Sockets are written with sendmsg so the kernel can
+ *    be told that more data follows (MSG_MORE) and keep headers and body
+ *    in the same segments; other descriptors fall back to writev.
+ */
+
+/*
+ * wio_writeinitb - Associate a descriptor with a write buffer
+ */
+/* $begin wio_writeinitb */
+void wio_writeinitb(wio_t *wp, int fd) 
+{
+    wp->wio_fd = fd;
+    wp->wio_cnt = 0;
+    wp->wio_issock = 1;  /* Until sendmsg says otherwise */
+}
+/* $end wio_writeinitb */
+
+/*
+ * wio_sendv - Write an iovec array, hinting MSG_MORE if more is coming
+ */
+/* $begin wio_sendv */
+static ssize_t wio_sendv(wio_t *wp, struct iovec *iov, int iovcnt, int more) 
+{
+    ssize_t rc;
+
+    if (wp->wio_issock) {
+	rc = rio_sendv(wp->wio_fd, iov, iovcnt, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+	if (rc >= 0 || errno != ENOTSOCK)
+	    return rc;
+	wp->wio_issock = 0;  /* Pipe or file: nothing was written */
+    }
+    return rio_writev(wp->wio_fd, iov, iovcnt);
+}
+/* $end wio_sendv */
+
+/*
+ * wio_flushb - Write out everything buffered; this is the end of the
+ *    data for now, so the kernel may send a partial segment.
+ *    Returns the bytes written, -1 on error.
+ */
+/* $begin wio_flushb */
+ssize_t wio_flushb(wio_t *wp) 
+{
+    struct iovec iov = { wp->wio_buf, wp->wio_cnt };
+    ssize_t rc = wio_sendv(wp, &iov, 1, 0);
+
+    wp->wio_cnt = 0;
+    return rc;
+}
+/* $end wio_flushb */
+
+/*
+ * wio_flushmoreb - Like wio_flushb, for when the caller is about to send
+ *    the rest outside of wio (sendfile, splice, a forked CGI writing to
+ *    the socket): the buffered bytes are held back to share a segment.
+ */
+/* $begin wio_flushmoreb */
+ssize_t wio_flushmoreb(wio_t *wp) 
+{
+    struct iovec iov = { wp->wio_buf, wp->wio_cnt };
+    ssize_t rc = wio_sendv(wp, &iov, 1, 1);
+
+    wp->wio_cnt = 0;
+    return rc;
+}
+/* $end wio_flushmoreb */
+
+/*
+ * wio_writeb - Buffered write of n bytes. Writes that fit are only
+ *    copied; a write that does not fit goes out together with the
+ *    buffered bytes in one writev (large ones are not copied at all).
+ *    Returns n, or -1 on error.
+ */
+/* $begin wio_writeb */
+ssize_t wio_writeb(wio_t *wp, const void *usrbuf, size_t n) 
+{
+    if (n <= WIO_BUFSIZE - (size_t)wp->wio_cnt) {
+	memcpy(wp->wio_buf + wp->wio_cnt, usrbuf, n);
+	wp->wio_cnt += n;
+	return n;
+    }
+    if (n < WIO_BUFSIZE / 2) {  /* Small: make room and keep gathering */
+	if (wio_flushmoreb(wp) < 0)
+	    return -1;
+	memcpy(wp->wio_buf, usrbuf, n);
+	wp->wio_cnt = n;
+	return n;
+    }
+
+    struct iovec iov[2] = {{ wp->wio_buf, wp->wio_cnt }, { (void *)usrbuf, n }};
+    ssize_t rc = wio_sendv(wp, iov, 2, 0);
+    wp->wio_cnt = 0;
+    return rc < 0 ? -1 : (ssize_t)n;
+}
+/* $end wio_writeb */
+
+/*
+ * wio_vprintfb - printf into the write buffer (flushing first if needed)
+ *    Returns the formatted length, or -1 on error.
+ */
+/* $begin wio_vprintfb */
+static ssize_t wio_vprintfb(wio_t *wp, const char *fmt, va_list ap) 
+{
+    va_list ap2;
+    int n;
+
+    va_copy(ap2, ap);
+    n = vsnprintf(wp->wio_buf + wp->wio_cnt, WIO_BUFSIZE - wp->wio_cnt, fmt, ap);
+    if (n >= 0 && n < WIO_BUFSIZE - wp->wio_cnt) {  /* Fit */
+	wp->wio_cnt += n;
+	va_end(ap2);
+	return n;
+    }
+
+    /* Did not fit: format again into a buffer of the right size */
+    char *tmp = n < 0 ? NULL : malloc(n + 1);
+    ssize_t rc = -1;
+    if (tmp != NULL) {
+	vsnprintf(tmp, n + 1, fmt, ap2);
+	rc = wio_writeb(wp, tmp, n);
+	free(tmp);
+    }
+    va_end(ap2);
+    return rc;
+}
+/* $end wio_vprintfb */
+
+/* $begin wio_printfb */
+ssize_t wio_printfb(wio_t *wp, const char *fmt, ...) 
+{
+    va_list ap;
+    ssize_t rc;
+
+    va_start(ap, fmt);
+    rc = wio_vprintfb(wp, fmt, ap);
+    va_end(ap);
+    return rc;
+}
+/* $end wio_printfb */
+
 /**********************************
  * Wrappers for robust I/O routines
  **********************************/
+
+/*
+ * peer_gone - The connection is dead (peer closed or reset it, or it
+ *     was shut down by a timeout). A server should drop that one
+ *     connection, not exit: these wrappers return -1 / quietly stop
+ *     instead of calling unix_error.
+ */
+static int peer_gone(void)
+{
+    return errno == EPIPE || errno == ECONNRESET || errno == ETIMEDOUT || errno == ENOTCONN;
+}
+
 ssize_t Rio_readn(int fd, void *ptr, size_t nbytes) 
 {
     ssize_t n;
@@ -907,20 +1297,31 @@ ssize_t Rio_readn(int fd, void *ptr, size_t nbytes)
 
 void Rio_writen(int fd, void *usrbuf, size_t n) 
 {
-    if (rio_writen(fd, usrbuf, n) != n)
+    if (rio_writen(fd, usrbuf, n) != n && !peer_gone())
 	unix_error("Rio_writen error");
 }
 
+void Rio_writev(int fd, struct iovec *iov, int iovcnt) 
+{
+    if (rio_writev(fd, iov, iovcnt) < 0 && !peer_gone())
+	unix_error("Rio_writev error");
+}
+
 void Rio_readinitb(rio_t *rp, int fd)
 {
     rio_readinitb(rp, fd);
 } 
 
+void Rio_readinitbuf(rio_t *rp, int fd, char *buf, size_t size)
+{
+    rio_readinitbuf(rp, fd, buf, size);
+} 
+
 ssize_t Rio_readnb(rio_t *rp, void *usrbuf, size_t n) 
 {
     ssize_t rc;
 
-    if ((rc = rio_readnb(rp, usrbuf, n)) < 0)
+    if ((rc = rio_readnb(rp, usrbuf, n)) < 0 && !peer_gone())
 	unix_error("Rio_readnb error");
     return rc;
 }
@@ -929,11 +1330,69 @@ ssize_t Rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen)
 {
     ssize_t rc;
 
-    if ((rc = rio_readlineb(rp, usrbuf, maxlen)) < 0)
+    if ((rc = rio_readlineb(rp, usrbuf, maxlen)) < 0 && !peer_gone())
 	unix_error("Rio_readlineb error");
     return rc;
 } 
 
+ssize_t Rio_peekb(rio_t *rp, const char **bufp) 
+{
+    ssize_t rc;
+
+    if ((rc = rio_peekb(rp, bufp)) < 0 && !peer_gone())
+	unix_error("Rio_peekb error");
+    return rc;
+} 
+
+ssize_t Rio_peeklineb(rio_t *rp, const char **linep) 
+{
+    ssize_t rc;
+
+    if ((rc = rio_peeklineb(rp, linep)) < 0 && !peer_gone())
+	unix_error("Rio_peeklineb error");
+    return rc;
+} 
+
+void Rio_consumeb(rio_t *rp, size_t n)
+{
+    rio_consumeb(rp, n);
+} 
+
+void Wio_writeinitb(wio_t *wp, int fd)
+{
+    wio_writeinitb(wp, fd);
+} 
+
+void Wio_writeb(wio_t *wp, const void *usrbuf, size_t n)
+{
+    if (wio_writeb(wp, usrbuf, n) < 0 && !peer_gone())
+	unix_error("Wio_writeb error");
+} 
+
+void Wio_printfb(wio_t *wp, const char *fmt, ...)
+{
+    va_list ap;
+    ssize_t rc;
+
+    va_start(ap, fmt);
+    rc = wio_vprintfb(wp, fmt, ap);
+    va_end(ap);
+    if (rc < 0 && !peer_gone())
+	unix_error("Wio_printfb error");
+} 
+
+void Wio_flushb(wio_t *wp)
+{
+    if (wio_flushb(wp) < 0 && !peer_gone())
+	unix_error("Wio_flushb error");
+} 
+
+void Wio_flushmoreb(wio_t *wp)
+{
+    if (wio_flushmoreb(wp) < 0 && !peer_gone())
+	unix_error("Wio_flushmoreb error");
+} 
+
 /******************************** 
  * Client/server helper functions
  ********************************/
@@ -20,6 +20,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <math.h>
 #include <pthread.h>
@@ -47,10 +48,23 @@ typedef struct {
     int rio_fd;                /* Descriptor for this internal buf */
     int rio_cnt;               /* Unread bytes in internal buf */
     char *rio_bufptr;          /* Next unread byte in internal buf */
+    char *rio_base;            /* Buffer in use (rio_buf or caller's) */
+    size_t rio_size;           /* Size of rio_base */
     char rio_buf[RIO_BUFSIZE]; /* Internal buffer */
 } rio_t;
 /* $end rio_t */
 
+/* Persistent state for the buffered writer (Wio) package */
+/* $begin wio_t */
+#define WIO_BUFSIZE 8192
+typedef struct {
+    int wio_fd;                /* Descriptor for this internal buf */
+    int wio_cnt;               /* Buffered bytes not yet written */
+    int wio_issock;            /* 0 once sendmsg failed with ENOTSOCK */
+    char wio_buf[WIO_BUFSIZE]; /* Internal buffer */
+} wio_t;
+/* $end wio_t */
+
 /* External variables */
 extern int h_errno;    /* Defined by BIND for DNS errors */ 
 extern char **environ; /* Defined by libc */
@@ -175,16 +189,39 @@ void V(sem_t *sem);
 /* Rio (Robust I/O) package */
 ssize_t rio_readn(int fd, void *usrbuf, size_t n);
 ssize_t rio_writen(int fd, void *usrbuf, size_t n);
+ssize_t rio_writev(int fd, struct iovec *iov, int iovcnt);
 void rio_readinitb(rio_t *rp, int fd); 
+void rio_readinitbuf(rio_t *rp, int fd, char *buf, size_t size); 
 ssize_t	rio_readnb(rio_t *rp, void *usrbuf, size_t n);
 ssize_t	rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen);
+ssize_t	rio_peekb(rio_t *rp, const char **bufp);
+ssize_t	rio_peeklineb(rio_t *rp, const char **linep);
+void rio_consumeb(rio_t *rp, size_t n);
+ssize_t	rio_readb_nb(rio_t *rp, void *usrbuf, size_t n);
+ssize_t	rio_readlineb_nb(rio_t *rp, void *usrbuf, size_t maxlen);
+ssize_t	rio_writen_nb(int fd, void *usrbuf, size_t n, size_t *offp);
+void wio_writeinitb(wio_t *wp, int fd);
+ssize_t	wio_writeb(wio_t *wp, const void *usrbuf, size_t n);
+ssize_t	wio_printfb(wio_t *wp, const char *fmt, ...);
+ssize_t	wio_flushb(wio_t *wp);
+ssize_t	wio_flushmoreb(wio_t *wp);
 
 /* Wrappers for Rio package */
 ssize_t Rio_readn(int fd, void *usrbuf, size_t n);
 void Rio_writen(int fd, void *usrbuf, size_t n);
+void Rio_writev(int fd, struct iovec *iov, int iovcnt);
 void Rio_readinitb(rio_t *rp, int fd); 
+void Rio_readinitbuf(rio_t *rp, int fd, char *buf, size_t size); 
 ssize_t Rio_readnb(rio_t *rp, void *usrbuf, size_t n);
 ssize_t Rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen);
+ssize_t Rio_peekb(rio_t *rp, const char **bufp);
+ssize_t Rio_peeklineb(rio_t *rp, const char **linep);
+void Rio_consumeb(rio_t *rp, size_t n);
+void Wio_writeinitb(wio_t *wp, int fd);
+void Wio_writeb(wio_t *wp, const void *usrbuf, size_t n);
+void Wio_printfb(wio_t *wp, const char *fmt, ...);
+void Wio_flushb(wio_t *wp);
+void Wio_flushmoreb(wio_t *wp);
 
 /* Reentrant protocol-independent client/server helpers */
 int open_clientfd(char *hostname, char *port);
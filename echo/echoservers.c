@@ -1,23 +1,37 @@
 /* 
  * echoservers.c - A concurrent echo server based on select
+ *    Client sockets are non-blocking: a partial line waits in the rio
+ *    buffer, and a reply the client is not reading fast enough waits in
+ *    pending[] while that client's input is paused.
  */
 /* $begin echoserversmain */
 #include "csapp.h"
 
+typedef struct { /* an echoed line not yet fully written */
+    char *buf;
+    size_t len;
+    size_t off;
+} pending_t;
+
 typedef struct { /* represents a pool of connected descriptors */ //line:conc:echoservers:beginpool
     int maxfd;        /* largest descriptor in read_set */   
     fd_set read_set;  /* set of all active descriptors */
+    fd_set write_set; /* descriptors with a pending reply */
     fd_set ready_set; /* subset of descriptors ready for reading  */
+    fd_set ready_write_set; /* subset of descriptors ready for writing */
     int nready;       /* number of ready descriptors from select */   
     int maxi;         /* highwater index into client array */
     int clientfd[FD_SETSIZE];    /* set of active descriptors */
     rio_t clientrio[FD_SETSIZE]; /* set of active read buffers */
+    pending_t pending[FD_SETSIZE]; /* replies blocked on a full socket */
 } pool; //line:conc:echoservers:endpool
 
 /* $end echoserversmain */
 void init_pool(int listenfd, pool *p);
 void add_client(int connfd, pool *p);
 void check_clients(pool *p);
+static void echo_lines(pool *p, int i);
+static void remove_client(pool *p, int i);
 /* $begin echoserversmain */
 
 int g_total_bytes_received = 0; /* counts total bytes received by server */
@@ -42,7 +56,8 @@ int main(int argc, char **argv){
     while (1) {
 		/* Wait for listening/connected descriptor(s) to become ready */
 		pool.ready_set = pool.read_set;
-		pool.nready = Select(pool.maxfd+1, &pool.ready_set, NULL, NULL, NULL);
+		pool.ready_write_set = pool.write_set;
+		pool.nready = Select(pool.maxfd+1, &pool.ready_set, &pool.ready_write_set, NULL, NULL);
 
 		/* If listening descriptor ready, add new client to pool */
 		if (FD_ISSET(listenfd, &pool.ready_set)) { //line:conc:echoservers:listenfdready
@@ -68,6 +83,7 @@ void init_pool(int listenfd, pool *p){
     /* Initially, listenfd is only member of select read set */
     p->maxfd = listenfd;            //line:conc:echoservers:begininit
     FD_ZERO(&p->read_set);
+    FD_ZERO(&p->write_set);
     FD_SET(listenfd, &p->read_set); //line:conc:echoservers:endinit
 }
 /* $end init_pool */
@@ -82,6 +98,8 @@ void add_client(int connfd, pool *p) {
 			/* Add connected descriptor to the pool */
 			p->clientfd[i] = connfd;                 //line:conc:echoservers:beginaddclient
 			Rio_readinitb(&p->clientrio[i], connfd); //line:conc:echoservers:endaddclient
+			p->pending[i].buf = NULL;
+			fcntl(connfd, F_SETFL, fcntl(connfd, F_GETFL, 0) | O_NONBLOCK);
 
 			/* Add the descriptor to descriptor set */
 			FD_SET(connfd, &p->read_set); //line:conc:echoservers:addconnfd
@@ -103,29 +121,84 @@ void add_client(int connfd, pool *p) {
 /* $begin check_clients */
 void check_clients(pool *p) {
     int i, connfd, n;
-    char buf[MAXLINE]; 
-    rio_t rio;
 
     for (i = 0; (i <= p->maxi) && (p->nready > 0); i++) {
 		connfd = p->clientfd[i];
-		rio = p->clientrio[i];
+		if (connfd < 0)
+			continue;
 
-		/* If the descriptor is ready, echo a text line from it */
-		if ((connfd > 0) && (FD_ISSET(connfd, &p->ready_set))) { 
+		/* Finish a reply that blocked earlier, then resume reading */
+		if (FD_ISSET(connfd, &p->ready_write_set)) {
+			pending_t *pd = &p->pending[i];
 			p->nready--;
-			if ((n = Rio_readlineb(&rio, buf, MAXLINE)) != 0) {
-				g_total_bytes_received += n; //line:conc:echoservers:beginecho
-				printf("Server received %d (%d total) bytes on fd %d\n", 
-				n, g_total_bytes_received, connfd);
-				Rio_writen(connfd, buf, n); //line:conc:echoservers:endecho
-			} else {  
-			/* EOF detected, remove descriptor from pool */
-				Close(connfd); //line:conc:echoservers:closeconnfd
-				FD_CLR(connfd, &p->read_set); //line:conc:echoservers:beginremove
-				p->clientfd[i] = -1;          //line:conc:echoservers:endremove
+			n = rio_writen_nb(connfd, pd->buf, pd->len, &pd->off);
+			if (n < 0) {
+				remove_client(p, i);
+				continue;
 			}
+			if (n > 0)
+				continue;
+			Free(pd->buf);
+			pd->buf = NULL;
+			FD_CLR(connfd, &p->write_set);
+			FD_SET(connfd, &p->read_set);
+			/* Lines that arrived while paused may already sit in the rio buffer */
+			echo_lines(p, i);
+			continue;
+		}
+
+		/* If the descriptor is ready, echo every complete line it has */
+		if (FD_ISSET(connfd, &p->ready_set)) { 
+			p->nready--;
+			echo_lines(p, i);
 		}
     }
 }
 /* $end check_clients */
 
+/* echo_lines - Echo every complete line of client i (buffered or on the
+ *    socket) until it would block, its reply blocks, or it goes away */
+static void echo_lines(pool *p, int i) {
+    int connfd = p->clientfd[i];
+    rio_t *rio = &p->clientrio[i]; /* by pointer: the buffer state must persist */
+    char buf[MAXLINE]; 
+    int n;
+
+    while ((n = rio_readlineb_nb(rio, buf, MAXLINE)) > 0) {
+		size_t off = 0;
+		g_total_bytes_received += n; //line:conc:echoservers:beginecho
+		printf("Server received %d (%d total) bytes on fd %d\n", 
+		n, g_total_bytes_received, connfd);
+		ssize_t left = rio_writen_nb(connfd, buf, n, &off); //line:conc:echoservers:endecho
+		if (left < 0) { /* Write error: the client is gone */
+			remove_client(p, i);
+			return;
+		}
+		if (left > 0) { /* Client is slow: keep the rest, pause its input */
+			pending_t *pd = &p->pending[i];
+			pd->len = left;
+			pd->off = 0;
+			pd->buf = Malloc(left);
+			memcpy(pd->buf, buf + off, left);
+			FD_CLR(connfd, &p->read_set);
+			FD_SET(connfd, &p->write_set);
+			return;
+		}
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		remove_client(p, i); /* EOF or error detected, remove descriptor from pool */
+}
+
+/* remove_client - Close a client and drop it from the pool */
+static void remove_client(pool *p, int i) {
+    int connfd = p->clientfd[i];
+
+    Close(connfd); //line:conc:echoservers:closeconnfd
+    FD_CLR(connfd, &p->read_set); //line:conc:echoservers:beginremove
+    FD_CLR(connfd, &p->write_set);
+    p->clientfd[i] = -1;          //line:conc:echoservers:endremove
+    if (p->pending[i].buf) {
+		Free(p->pending[i].buf);
+		p->pending[i].buf = NULL;
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * http_header_gen.c - HTTP_KNOWN_HEADERS의 완전 해시 표를 만드는 빌드용 도구
+ * 충돌이 없는 (표 크기, 곱수) 조합을 작은 것부터 찾아 http_header_table.h를 표준 출력으로 씀.
+ * 사용: ./http_header_gen > http_header_table.h (Makefile이 알아서 함)
+ */
+#include <stdio.h>
+#include <string.h>
+#include "http_parser.h"
+
+#define HTTP_HDR_ENTRY(id, name) { #id, name },
+static const struct {
+    const char* id;
+    const char* name;
+} known[] = { HTTP_KNOWN_HEADERS(HTTP_HDR_ENTRY) };
+#undef HTTP_HDR_ENTRY
+
+#define KNOWN_COUNT (int)(sizeof(known) / sizeof(known[0]))
+#define MAX_TABLE_SIZE 256
+#define MAX_MUL 64
+
+static unsigned hash_of(const char* name, unsigned mul_len, unsigned mul_first, unsigned size) {
+    int len = strlen(name);
+    return HTTP_HEADER_HASH(len, name[0], name[len - 1], mul_len, mul_first, size);
+}
+
+int main(void) {
+    int slot_of[MAX_TABLE_SIZE];
+
+    for (unsigned size = 8; size <= MAX_TABLE_SIZE; size <<= 1) {
+        for (unsigned mul_len = 1; mul_len < MAX_MUL; ++mul_len) {
+            for (unsigned mul_first = 1; mul_first < MAX_MUL; ++mul_first) {
+                int ok = 1;
+                memset(slot_of, -1, sizeof(slot_of));
+                for (int i = 0; i < KNOWN_COUNT && ok; ++i) {
+                    unsigned h = hash_of(known[i].name, mul_len, mul_first, size);
+                    if (slot_of[h] >= 0)
+                        ok = 0;
+                    slot_of[h] = i;
+                }
+                if (!ok)
+                    continue;
+
+                printf("/* http_header_table.h - http_header_gen이 빌드 때 생성 (직접 고치지 말 것) */\n");
+                printf("#define HTTP_HASH_SIZE %u\n", size);
+                printf("#define HTTP_HASH_MUL_LEN %u\n", mul_len);
+                printf("#define HTTP_HASH_MUL_FIRST %u\n\n", mul_first);
+                printf("static const struct {\n    const char* name;\n    int len;\n    http_header_id_t id;\n"
+                       "} http_header_table[HTTP_HASH_SIZE] = {\n");
+                for (unsigned h = 0; h < size; ++h) {
+                    if (slot_of[h] < 0)
+                        printf("    { NULL, 0, HTTP_HDR_OTHER },\n");
+                    else
+                        printf("    { \"%s\", %d, HTTP_HDR_%s },\n", known[slot_of[h]].name,
+                               (int)strlen(known[slot_of[h]].name), known[slot_of[h]].id);
+                }
+                printf("};\n");
+                return 0;
+            }
+        }
+    }
+    fprintf(stderr, "http_header_gen: no perfect hash up to %d slots\n", MAX_TABLE_SIZE);
+    return 1;
+}
@@ -0,0 +1,283 @@
+/**
+ * http_parser.c - 읽기 버퍼 위에서 바로 동작하는 증분 HTTP 요청 헤드 파서
+ */
+#include "http_parser.h"
+#include "http_header_table.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * 줄 스캐너 - [p, end)에서 첫 '\n'을 찾으면서 그 앞의 첫 ':'도 같은 패스에서 기록 (*colon이 NULL일 때만)
+ * 시작할 때 CPU를 보고 AVX2 / SSE2 / 스칼라 중 하나를 고름.
+ * @return '\n' 위치, 없으면 NULL
+ */
+typedef const char* (*line_scan_fn)(const char* p, const char* end, const char** colon);
+
+static const char* scan_line_scalar(const char* p, const char* end, const char** colon) {
+    const char* nl = memchr(p, '\n', end - p);
+
+    if (*colon == NULL)
+        *colon = memchr(p, ':', (nl ? nl : end) - p);
+    return nl;
+}
+
+#if defined(__x86_64__)
+/* 벡터 한 블록의 '\n', ':' 비트마스크 처리 - 줄이 끝났으면 1 */
+static inline int scan_masks(const char* p, unsigned m_nl, unsigned m_colon, const char** colon, const char** nl) {
+    if (*colon == NULL && m_colon) {
+        unsigned before = m_nl ? m_colon & ((m_nl & -m_nl) - 1) : m_colon; // '\n' 앞의 ':'만
+        if (before)
+            *colon = p + __builtin_ctz(before);
+    }
+    if (m_nl) {
+        *nl = p + __builtin_ctz(m_nl);
+        return 1;
+    }
+    return 0;
+}
+
+static const char* scan_line_sse2(const char* p, const char* end, const char** colon) {
+    const __m128i v_nl = _mm_set1_epi8('\n');
+    const __m128i v_colon = _mm_set1_epi8(':');
+    const char* nl;
+
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned m_nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, v_nl));
+        unsigned m_colon = _mm_movemask_epi8(_mm_cmpeq_epi8(v, v_colon));
+        if (scan_masks(p, m_nl, m_colon, colon, &nl))
+            return nl;
+    }
+    return scan_line_scalar(p, end, colon);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_line_avx2(const char* p, const char* end, const char** colon) {
+    const __m256i v_nl = _mm256_set1_epi8('\n');
+    const __m256i v_colon = _mm256_set1_epi8(':');
+    const char* nl;
+
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned m_nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_nl));
+        unsigned m_colon = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_colon));
+        if (scan_masks(p, m_nl, m_colon, colon, &nl))
+            return nl;
+    }
+    return scan_line_sse2(p, end, colon);
+}
+#endif
+
+static line_scan_fn scan_line = scan_line_scalar;
+
+/**
+ * pick_line_scanner - 프로세스 시작 때 한 번 CPU 기능을 보고 스캐너 선택
+ * PROXY_HTTP_SCAN=scalar|sse2 로 낮은 단계를 강제할 수 있음 (비교 측정용)
+ */
+__attribute__((constructor))
+static void pick_line_scanner(void) {
+#if defined(__x86_64__)
+    const char* force = getenv("PROXY_HTTP_SCAN");
+
+    __builtin_cpu_init();
+    if (force && !strcmp(force, "scalar"))
+        scan_line = scan_line_scalar;
+    else if ((force && !strcmp(force, "sse2")) || !__builtin_cpu_supports("avx2"))
+        scan_line = scan_line_sse2; // x86-64면 SSE2는 항상 있음
+    else
+        scan_line = scan_line_avx2;
+#endif
+}
+
+/**
+ * http_classify_header - 헤더 이름을 HTTP_KNOWN_HEADERS의 id로 (해시 한 번 + 비교 한 번)
+ */
+http_header_id_t http_classify_header(const char* name, int len) {
+    unsigned h;
+
+    if (len <= 0)
+        return HTTP_HDR_OTHER;
+    h = HTTP_HEADER_HASH(len, name[0], name[len - 1], HTTP_HASH_MUL_LEN, HTTP_HASH_MUL_FIRST, HTTP_HASH_SIZE);
+    if (http_header_table[h].len == len && strncasecmp(http_header_table[h].name, name, len) == 0)
+        return http_header_table[h].id;
+    return HTTP_HDR_OTHER;
+}
+
+/**
+ * http_parser_init - 새 요청을 받을 준비 (버퍼 내용은 건드리지 않음)
+ */
+void http_parser_init(http_parser_t* parser) {
+    parser->len = 0;
+    parser->pos = 0;
+    parser->scan = 0;
+    parser->colon = -1;
+    parser->state = HTTP_STATE_REQUEST_LINE;
+    parser->method.off = parser->uri.off = parser->version.off = 0;
+    parser->method.len = parser->uri.len = parser->version.len = 0;
+    parser->header_count = 0;
+    parser->headers_block.off = 0;
+    parser->headers_block.len = 0;
+    parser->buf[0] = '\0';
+}
+
+/**
+ * next_token - [*p, end)에서 공백으로 구분된 다음 토큰을 찾아 slice에 기록
+ * @return 토큰이 있으면 1
+ */
+static int next_token(const char* buf, int* p, int end, http_slice_t* slice) {
+    int i = *p;
+
+    while (i < end && (buf[i] == ' ' || buf[i] == '\t'))
+        ++i;
+    slice->off = i;
+    while (i < end && buf[i] != ' ' && buf[i] != '\t')
+        ++i;
+    slice->len = i - slice->off;
+    *p = i;
+    return slice->len > 0;
+}
+
+/**
+ * parse_request_line - "METHOD URI [VERSION]" 한 줄 (line_end는 CR/LF 제외한 끝)
+ * 각 토큰 뒤 구분자를 NULL 문자로 바꿔서 buf 안에서 바로 C 문자열이 되게 함.
+ */
+static int parse_request_line(http_parser_t* parser, int start, int line_end) {
+    char* buf = parser->buf;
+    int p = start;
+    http_slice_t extra;
+
+    if (!next_token(buf, &p, line_end, &parser->method) || !next_token(buf, &p, line_end, &parser->uri))
+        return HTTP_PARSE_ERROR;
+    next_token(buf, &p, line_end, &parser->version); // HTTP/0.9 스타일이면 없음
+    if (next_token(buf, &p, line_end, &extra))
+        return HTTP_PARSE_ERROR;
+
+    buf[parser->method.off + parser->method.len] = '\0';
+    buf[parser->uri.off + parser->uri.len] = '\0';
+    if (parser->version.len == 0)
+        parser->version.off = parser->uri.off + parser->uri.len; // 빈 문자열
+    else
+        buf[parser->version.off + parser->version.len] = '\0';
+    return HTTP_PARSE_AGAIN;
+}
+
+/**
+ * parse_header_line - "Name: value" 한 줄을 구간으로 기록 (buf는 그대로 둠)
+ * obs-fold(공백으로 시작하는 이어지는 줄)와 ':' 없는 줄은 거절 (RFC 7230 3.2.4)
+ * @param colon: 줄 스캔 때 찾아 둔 첫 ':' (없으면 NULL)
+ */
+static int parse_header_line(http_parser_t* parser, int start, int line_end, const char* colon) {
+    const char* buf = parser->buf;
+    http_header_t* h;
+    int v, e;
+
+    if (buf[start] == ' ' || buf[start] == '\t')
+        return HTTP_PARSE_ERROR;
+    if (colon == NULL || colon == buf + start)
+        return HTTP_PARSE_ERROR;
+    if (parser->header_count == HTTP_MAX_HEADERS)
+        return HTTP_PARSE_TOO_LARGE;
+
+    h = &parser->headers[parser->header_count++];
+    h->name.off = start;
+    h->name.len = colon - (buf + start);
+    h->id = http_classify_header(buf + start, h->name.len);
+    v = colon - buf + 1;
+    while (v < line_end && (buf[v] == ' ' || buf[v] == '\t'))
+        ++v;
+    e = line_end;
+    while (e > v && (buf[e - 1] == ' ' || buf[e - 1] == '\t'))
+        --e;
+    h->value.off = v;
+    h->value.len = e - v;
+    return HTTP_PARSE_AGAIN;
+}
+
+/**
+ * http_parse - buf[pos, len)의 완성된 줄들을 파싱. 마지막 줄이 덜 들어왔으면 거기서 멈춤.
+ * 호출자는 buf + len 뒤에 새로 읽은 바이트를 붙이고 len을 늘린 다음 다시 부르면 됨.
+ * @return HTTP_PARSE_DONE / AGAIN / ERROR / TOO_LARGE
+ */
+int http_parse(http_parser_t* parser) {
+    char* buf = parser->buf;
+
+    while (parser->state != HTTP_STATE_DONE) {
+        const char* colon = parser->colon >= 0 ? buf + parser->colon : NULL;
+        const char* nl = scan_line(buf + parser->scan, buf + parser->len, &colon);
+        if (nl == NULL) {
+            parser->scan = parser->len; // 다음에는 새로 들어온 바이트만 훑음
+            parser->colon = colon ? colon - buf : -1;
+            return parser->len >= HTTP_MAX_HEAD ? HTTP_PARSE_TOO_LARGE : HTTP_PARSE_AGAIN;
+        }
+
+        int start = parser->pos;
+        int next = nl - buf + 1;
+        int line_end = nl - buf;
+        if (line_end > start && buf[line_end - 1] == '\r')
+            --line_end;
+        parser->pos = parser->scan = next;
+        parser->colon = -1;
+
+        int rc;
+        if (parser->state == HTTP_STATE_REQUEST_LINE) {
+            if (line_end == start)
+                continue; // 요청 앞의 빈 줄은 무시 (RFC 7230 3.5)
+            rc = parse_request_line(parser, start, line_end);
+            parser->state = HTTP_STATE_HEADERS;
+            parser->headers_block.off = next;
+        } else if (line_end == start) {
+            parser->state = HTTP_STATE_DONE; // 헤더 끝
+            rc = HTTP_PARSE_AGAIN;
+        } else {
+            rc = parse_header_line(parser, start, line_end, colon);
+            parser->headers_block.len = next - parser->headers_block.off;
+        }
+        if (rc != HTTP_PARSE_AGAIN)
+            return rc;
+    }
+    return HTTP_PARSE_DONE;
+}
+
+/**
+ * http_read_head - fd에서 읽어 들이며 요청 헤드를 끝까지 파싱
+ * 블로킹 fd면 끝날 때까지 돌고, 논블로킹 fd면 EAGAIN에서 HTTP_PARSE_AGAIN으로 돌아옴
+ * (다시 부르면 이어서 파싱). 헤드 뒤에 딸려 들어온 바이트는 buf[pos, len)에 남음.
+ * @return http_parse 반환값, 헤드가 끝나기 전에 연결이 닫히면 HTTP_PARSE_CLOSED
+ */
+int http_read_head(http_parser_t* parser, int fd) {
+    int rc;
+
+    while ((rc = http_parse(parser)) == HTTP_PARSE_AGAIN) {
+        ssize_t n = read(fd, parser->buf + parser->len, HTTP_MAX_HEAD - parser->len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return HTTP_PARSE_AGAIN;
+        if (n <= 0)
+            return HTTP_PARSE_CLOSED;
+        parser->len += n;
+        parser->buf[parser->len] = '\0';
+    }
+    return rc;
+}
+
+/**
+ * http_find_header - id 헤더의 (첫) 값을 val_out에 복사
+ * @return 찾으면 1, 없으면 0
+ */
+int http_find_header(const http_parser_t* parser, http_header_id_t id, char* val_out, size_t val_max) {
+    for (int i = 0; i < parser->header_count; ++i) {
+        const http_header_t* h = &parser->headers[i];
+        if (h->id != id)
+            continue;
+        size_t len = h->value.len;
+        if (len >= val_max)
+            len = val_max - 1;
+        memcpy(val_out, parser->buf + h->value.off, len);
+        val_out[len] = '\0';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef __HTTP_PARSER_H__
+#define __HTTP_PARSER_H__
+
+#include "csapp.h"
+
+#define HTTP_MAX_HEAD MAXBUF // 요청 라인 + 헤더 전체 최대 크기 (넘으면 거절)
+#define HTTP_MAX_HEADERS 100 // 최대 헤더 줄 수 (넘으면 거절)
+
+// http_parse 반환값
+#define HTTP_PARSE_DONE 1 // 빈 줄까지 다 읽음
+#define HTTP_PARSE_AGAIN 0 // 줄이 덜 들어옴 ==> 더 읽어서 다시 호출
+#define HTTP_PARSE_ERROR -1 // 문법 오류 (400)
+#define HTTP_PARSE_TOO_LARGE -2 // 헤드가 버퍼보다 크거나 헤더가 너무 많음 (431)
+#define HTTP_PARSE_CLOSED -3 // 헤드가 끝나기 전에 연결이 닫힘 (http_read_head만)
+
+typedef enum {
+    HTTP_STATE_REQUEST_LINE,
+    HTTP_STATE_HEADERS,
+    HTTP_STATE_DONE
+} http_parse_state_t;
+
+// buf 안의 구간 (포인터가 아닌 오프셋이라 구조체째 memcpy 해도 됨)
+typedef struct {
+    int off;
+    int len;
+} http_slice_t;
+
+/**
+ * 프록시가 직접 보는 헤더 이름들 - 파싱할 때 한 번 분류해 두면 이후엔 strncasecmp 없이 id로 비교.
+ * 이름을 추가하면 http_header_gen이 빌드 때 완전 해시 표(http_header_table.h)를 다시 만듦.
+ */
+#define HTTP_KNOWN_HEADERS(X) \
+    X(HOST, "Host") \
+    X(CONNECTION, "Connection") \
+    X(PROXY_CONNECTION, "Proxy-Connection") \
+    X(USER_AGENT, "User-Agent") \
+    X(RANGE, "Range") \
+    X(IF_RANGE, "If-Range") \
+    X(X_PURGE_TYPE, "X-Purge-Type") \
+    X(SURROGATE_KEY, "Surrogate-Key")
+
+#define HTTP_HDR_ENUM(id, name) HTTP_HDR_##id,
+typedef enum {
+    HTTP_HDR_OTHER = 0, // 표에 없는 헤더
+    HTTP_KNOWN_HEADERS(HTTP_HDR_ENUM)
+    HTTP_HDR_COUNT
+} http_header_id_t;
+#undef HTTP_HDR_ENUM
+
+/* 헤더 이름 완전 해시 - 길이, 첫 글자, 끝 글자만 봄 (대소문자 무시). 곱수는 http_header_gen이 고름 */
+#define HTTP_HASH_LOWER(c) ((unsigned char)(c) | 0x20)
+#define HTTP_HEADER_HASH(len, first, last, mul_len, mul_first, size) \
+    (((unsigned)(len) * (mul_len) + HTTP_HASH_LOWER(first) * (mul_first) + HTTP_HASH_LOWER(last)) & ((size) - 1))
+
+typedef struct {
+    http_slice_t name; // ':' 앞까지
+    http_slice_t value; // 앞뒤 공백, CRLF 제거
+    http_header_id_t id; // 이름 분류 결과
+} http_header_t;
+
+/**
+ * 요청 헤드 파서 - 소켓에서 buf로 직접 읽어 들인 바이트 위에서 구간만 기록 (복사 없음)
+ * 읽기가 중간에 끊겨도 (논블로킹 I/O) 마지막으로 끝난 줄 다음부터 이어서 파싱.
+ * method/uri/version은 buf 안에서 NULL 종결되므로 C 문자열로 바로 쓸 수 있음.
+ * 헤더 줄들은 원래 바이트 그대로 남음 (headers_block) ==> 오리진 전달, Vary 매칭에 그대로 사용.
+ */
+typedef struct {
+    char buf[HTTP_MAX_HEAD + 1]; // +1은 끝의 NULL 문자 자리
+    int len; // buf에 들어온 바이트 수
+    int pos; // 다음에 파싱할 줄의 시작
+    int scan; // '\n'을 찾다 만 위치 (같은 바이트를 다시 훑지 않음)
+    int colon; // 지금 줄에서 이미 찾은 첫 ':' 위치 (-1이면 아직 없음)
+    http_parse_state_t state;
+
+    http_slice_t method;
+    http_slice_t uri;
+    http_slice_t version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int header_count;
+    http_slice_t headers_block; // 첫 헤더 줄부터 마지막 헤더 줄의 CRLF까지
+} http_parser_t;
+
+/* 슬라이스가 가리키는 buf 위치 */
+#define HTTP_SLICE_PTR(parser, slice) ((parser)->buf + (slice).off)
+
+void http_parser_init(http_parser_t* parser);
+int http_parse(http_parser_t* parser);
+int http_read_head(http_parser_t* parser, int fd);
+int http_find_header(const http_parser_t* parser, http_header_id_t id, char* val_out, size_t val_max);
+http_header_id_t http_classify_header(const char* name, int len);
+
+#endif
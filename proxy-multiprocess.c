@@ -1,10 +1,17 @@
 /**
  * proxy.c - A concurrent web proxy server based on select
+ *   - 기본은 prefork: 마스터가 리슨 소켓을 열고 오래 사는 워커 프로세스 N개를 fork,
+ *     워커는 각자 accept해서 연결을 차례로 처리 (요청마다 fork하지 않음 ==> 프로세스 격리는 그대로, fork 비용만 없앰).
+ *     마스터는 죽은 워커를 다시 띄우고, 워커는 PREFORK_MAX_REQUESTS개를 처리하면 스스로 물러남 (새 워커로 교체).
+ *   - PROXY_PREFORK_WORKERS=0이면 예전 방식: select 루프에서 요청마다 fork.
  */
 #include "csapp.h"
 
 #define MAX_HEADERS 100
 #define SHORT_CHARS 16
+#define PREFORK_WORKERS 4 // 기본 워커 프로세스 수 (PROXY_PREFORK_WORKERS) - 0이면 select + 요청마다 fork
+#define PREFORK_MAX_REQUESTS 10000 // 워커 하나가 처리하고 교체되는 연결 수 (PROXY_PREFORK_MAX_REQUESTS, 0이면 무제한)
+#define PREFORK_EXIT_RECYCLE 3 // 워커가 max_requests를 채우고 스스로 물러날 때의 종료 코드 (그 외 종료는 전부 크래시로 셈)
 
 typedef struct { /* represents a pool of connected descriptors */ 
     int maxfd;        /* largest descriptor in read_set */   
@@ -38,6 +45,13 @@ void check_clients(pool *p);
 
 // tiny에서 가져온 파트
 int parse_uri(const char* uri, char* hostname, char* port, char* path);
+void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longmsg);
+
+void handle_http_request(int clientfd, http_request_t *req);
+void tunnel_relay(int clientfd, const char *hostname, const char *port);
+
+// prefork
+static void prefork_main(int listenfd, int nworkers, int max_requests);
 
 
 /* $begin proxyserversmain */
@@ -52,7 +66,7 @@ int g_total_bytes_received = 0; /* counts total bytes received by server */
 
 int main(int argc, char **argv){
 	char* port_p;
-  int listenfd, connfd, port; 
+  int listenfd, connfd, port, nworkers, max_requests;
   socklen_t clientlen = sizeof(struct sockaddr_in);
   struct sockaddr_in clientaddr;
   static pool pool; 
@@ -68,6 +82,12 @@ int main(int argc, char **argv){
 	port_p = argv[1];
 
   listenfd = Open_listenfd(port_p);
+
+  nworkers = getenv("PROXY_PREFORK_WORKERS") ? atoi(getenv("PROXY_PREFORK_WORKERS")) : PREFORK_WORKERS;
+  max_requests = getenv("PROXY_PREFORK_MAX_REQUESTS") ? atoi(getenv("PROXY_PREFORK_MAX_REQUESTS")) : PREFORK_MAX_REQUESTS;
+  if (nworkers > 0)
+    prefork_main(listenfd, nworkers, max_requests); // 돌아오지 않음
+
   init_pool(listenfd, &pool);
 
   while (1) {
@@ -131,75 +151,175 @@ void add_client(int connfd, pool *p) {
 }
 /* $end add_client */
 
-static void process_ready_client(pool *p, int idx){
-  int connfd = p->clientfd[idx];
-  rio_t rio = p->clientrio[idx];
+/**
+ * read_request - 요청 라인과 헤더를 읽어 req를 채움 (CONNECT면 host:port로)
+ * @return 1 처리할 요청, 0 EOF (보낼 것 없음), -1 잘못된 요청 (400을 이미 보냄)
+ */
+static int read_request(int connfd, rio_t *rio, http_request_t *req){
   char buf[MAXLINE], line[MAXLINE];
-  http_request_t req;
-  int n;
 
   /* 요청 라인 읽기 */
-  if ((n = Rio_readlineb(&rio, buf, MAXLINE)) == 0) { // EOF면 연결 정리 
-    Close(connfd);
-    FD_CLR(connfd, &p->read_set);
-    p->clientfd[idx] = -1;
-    return;
-  }
+  if (Rio_readlineb(rio, buf, MAXLINE) <= 0)
+    return 0;
 
-  sscanf(buf, "%s %s %s", req.method, req.uri, req.version);
+  sscanf(buf, "%s %s %s", req->method, req->uri, req->version);
   // CONNECT일 경우 터널링 (양방향 TCP 패스쓰루)
-  if (!strcasecmp(req.method, "CONNECT")) {
-    char *colon = strchr(req.uri, ':'); // host:port 파싱
+  if (!strcasecmp(req->method, "CONNECT")) {
+    char *colon = strchr(req->uri, ':'); // host:port 파싱
     if (colon) { *colon = '\0';
-      strcpy(req.hostname, req.uri);
-      strcpy(req.port, colon + 1);
+      strcpy(req->hostname, req->uri);
+      strcpy(req->port, colon + 1);
     } else {
-      strcpy(req.hostname, req.uri); 
-      strcpy(req.port, "443");
+      strcpy(req->hostname, req->uri); 
+      strcpy(req->port, "443");
     }
+  } else if (!parse_uri(req->uri, req->hostname, req->port, req->path)) {
+    clienterror(connfd, req->uri, "400", "Bad Request", "URI 파싱 실패");
+    return -1;
+  }
 
+  /* 나머지 헤더 수집 (CONNECT도 빈 줄까지 먹어야 터널에 헤더가 새지 않음) */
+  req->header_count = 0;
+  while (Rio_readlineb(rio, line, MAXLINE) > 0) {
+    if (!strcmp(line, "\r\n")) break;
+    if (req->header_count < MAX_HEADERS)
+      strcpy(req->headers[req->header_count++], line);
+  }
+  return 1;
+}
+
+/* 읽은 요청 하나를 중계 (CONNECT면 터널이 닫힐 때까지) */
+static void serve_request(int connfd, http_request_t *req){
+  if (!strcasecmp(req->method, "CONNECT"))
+    tunnel_relay(connfd, req->hostname, req->port);
+  else
+    handle_http_request(connfd, req);
+}
+
+static void process_ready_client(pool *p, int idx){
+  int connfd = p->clientfd[idx];
+  rio_t rio = p->clientrio[idx];
+  http_request_t req;
+
+  /* fork() 후 자식이 릴레이 */
+  if (read_request(connfd, &rio, &req) > 0) {
     pid_t pid = Fork();
-    if (pid == 0) {    
-      tunnel_relay(connfd, req.hostname, req.port);
-      Close(connfd); /* 자식도 클라이언트를 풀에서 제거 */
-      exit(0); 
+    if (pid == 0) {  // 자식 
+      serve_request(connfd, &req);
+      Close(connfd);
+      exit(0);
     }
-    
-    Close(connfd); /* 부모도 클라이언트를 풀에서 제거 */
-    FD_CLR(connfd, &p->read_set);
-    p->clientfd[idx] = -1;
-    return;
   }
+  // 부모 정리 (EOF, 400도 여기서)
+  Close(connfd);
+  FD_CLR(connfd, &p->read_set);
+  p->clientfd[idx] = -1;
+}
+
+/* $begin prefork */
+static pid_t *g_workers;       /* 워커 pid (슬롯마다 하나) */
+static time_t *g_spawned_at;   /* 슬롯의 워커를 띄운 시각 - 띄우자마자 죽으면 잠깐 쉬고 다시 */
+static volatile sig_atomic_t g_stopping = 0;
+
+static void prefork_stop_handler(int sig) {
+  g_stopping = 1;
+}
 
-  // 일반 HTTP 요청 처리 
-  if (!parse_uri(req.uri, req.hostname, req.port, req.path)) {
-    clienterror(connfd, req.uri, "400", "Bad Request", "URI 파싱 실패");
+/**
+ * worker_main - 워커 프로세스: accept해서 연결 하나씩 처리, max_requests개 처리하면 종료 (마스터가 새로 띄움)
+ */
+static void worker_main(int listenfd, int max_requests) {
+  struct sockaddr_storage clientaddr;
+  socklen_t clientlen;
+  static http_request_t req; /* 워커마다 하나 (연결을 차례로 처리) */
+  rio_t rio;
+  int served = 0;
+
+  while (max_requests == 0 || served < max_requests) {
+    clientlen = sizeof(clientaddr);
+    int connfd = accept(listenfd, (SA *)&clientaddr, &clientlen);
+    if (connfd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      unix_error("worker_main: accept error");
+    }
+    Rio_readinitb(&rio, connfd);
+    if (read_request(connfd, &rio, &req) > 0)
+      serve_request(connfd, &req);
     Close(connfd);
-    FD_CLR(connfd, &p->read_set);
-    p->clientfd[idx] = -1;
-    return;
+    served++;
   }
+  exit(PREFORK_EXIT_RECYCLE); /* csapp 래퍼의 unix_error는 exit(0) ==> 0과 구분 */
+}
 
-  /* 나머지 헤더 수집 */
-  req.header_count = 0;
-  while (Rio_readlineb(&rio, line, MAXLINE) > 0) {
-    if (!strcmp(line, "\r\n")) break;
-    if (req.header_count < MAX_HEADERS)
-      strcpy(req.headers[req.header_count++], line);
+static pid_t spawn_worker(int slot, int listenfd, int max_requests) {
+  pid_t pid = Fork();
+  if (pid == 0) {
+    Signal(SIGINT, SIG_DFL);
+    Signal(SIGTERM, SIG_DFL);
+    worker_main(listenfd, max_requests);
   }
+  g_workers[slot] = pid;
+  g_spawned_at[slot] = time(NULL);
+  return pid;
+}
 
-  /* fork() 후 HTTP 릴레이 */
-  pid_t pid = Fork();
-  if (pid == 0) {  // 자식 
-    handle_http_request(connfd, &req);
-    Close(connfd);
-    exit(0);
+/**
+ * prefork_main - 마스터: 워커 nworkers개를 띄우고, 끝난 워커(교체 또는 크래시)를 다시 띄움.
+ * SIGINT/SIGTERM이면 워커들을 정리하고 종료.
+ */
+static void prefork_main(int listenfd, int nworkers, int max_requests) {
+  struct sigaction action;
+  unsigned long recycled = 0, crashed = 0;
+  int status, slot;
+  pid_t pid;
+
+  /* SA_RESTART 없이 ==> waitpid가 EINTR로 깨어나 g_stopping을 봄 */
+  action.sa_handler = prefork_stop_handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  Signal(SIGPIPE, SIG_IGN); /* 끊긴 클라이언트에 쓰면 워커가 죽는 대신 그 write만 EPIPE */
+
+  g_workers = Calloc(nworkers, sizeof(pid_t));
+  g_spawned_at = Calloc(nworkers, sizeof(time_t));
+  for (slot = 0; slot < nworkers; slot++)
+    spawn_worker(slot, listenfd, max_requests);
+
+  while (!g_stopping) {
+    if ((pid = waitpid(-1, &status, 0)) < 0) {
+      if (errno == EINTR)
+        continue;
+      unix_error("prefork_main: waitpid error");
+    }
+    for (slot = 0; slot < nworkers && g_workers[slot] != pid; slot++)
+      ;
+    if (slot == nworkers) /* 워커가 아님 */
+      continue;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == PREFORK_EXIT_RECYCLE) {
+      recycled++;
+    } else {
+      crashed++;
+      fprintf(stderr, "prefork: worker %d %s %d - respawning\n", (int)pid,
+              WIFSIGNALED(status) ? "killed by signal" : "exited with", 
+              WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+      if (time(NULL) - g_spawned_at[slot] < 1)
+        sleep(1); /* 띄우자마자 죽음 ==> fork 폭주를 막으려고 잠깐 쉼 */
+    }
+    if (!g_stopping)
+      spawn_worker(slot, listenfd, max_requests);
   }
-  // 부모 정리
-  Close(connfd);
-  FD_CLR(connfd, &p->read_set);
-  p->clientfd[idx] = -1;
+
+  for (slot = 0; slot < nworkers; slot++)
+    kill(g_workers[slot], SIGTERM);
+  while (waitpid(-1, NULL, 0) > 0)
+    ;
+  printf("Prefork: %d workers, %lu recycled, %lu crashed\n", nworkers, recycled, crashed);
+  exit(0);
 }
+/* $end prefork */
 
 void check_clients(pool *p){
   for (int i = 0; i <= p->maxi && p->nready > 0; i++) {
@@ -223,7 +343,8 @@ void handle_http_request(int clientfd, http_request_t *req) {
   char buf[MAXLINE];
   rio_t server_rio;
 
-  serverfd = Open_clientfd(req->hostname, req->port);
+  // Open_clientfd()는 실패 시 프로세스를 종료시키므로 소문자 버전 (prefork 워커가 요청 하나로 죽지 않게)
+  serverfd = open_clientfd(req->hostname, req->port);
   if (serverfd < 0) {
     clienterror(clientfd, req->hostname, "502", "Bad Gateway", "Proxy couldn't connect to origin server");
     return;
@@ -283,7 +404,7 @@ void handle_http_request(int clientfd, http_request_t *req) {
       함수는 일치 프로세스에서 string2로 끝나는 NULL자(\0)를 무시합니다. 
 */
 int parse_uri(const char* uri, char* hostname, char* port, char* path) {
-  char* host_p;
+  const char* host_p;
   char* path_p;
   char* port_p;
   char hostport[SHORT_CHARS];
@@ -362,7 +483,7 @@ void tunnel_relay(int clientfd, const char *hostname, const char *port){
     char buf[MAXBUF];
 
     /* 1) 프록시 → 오리진 서버로 TCP 연결 */
-    if ((serverfd = Open_clientfd(hostname, port)) < 0) {
+    if ((serverfd = open_clientfd((char *)hostname, (char *)port)) < 0) {
       clienterror(clientfd, hostname, "502", "Bad Gateway", "Unable to connect to the origin server");
       return;
     }
@@ -3,40 +3,127 @@
  */
 #include "csapp.h"
 #include "cache.h"
+#include "http_parser.h"
+#include "resolver.h"
+#include "sockopt.h"
+#include "timer_wheel.h"
+#include "tunnel.h"
+#include "arena.h"
+#include "coro.h"
 
-#define MAX_HEADERS 100
 #define HOSTPORT_LEN 262 // 255+6+'\0'
 #define SHORT_CHARS 16
+#define MAX_RANGES 8 // 한 Range 요청에서 받아주는 최대 구간 수
+#define RANGE_BOUNDARY "GabesProxyByteRangesBoundary" // multipart/byteranges 구분자
+#define SEGMENT_COUNT 4 // 큰 객체를 나눠 받을 오리진 연결 수
+#define SEGMENT_MIN_SIZE (256<<10) // 이 이상인 객체만 나눠 받음 (작으면 연결 비용이 더 큼)
+#define FORWARD_IOV_MAX 64 // 오리진 요청 조립용 iovec 수 (넘치면 나눠서 writev)
+#define RELAY_BUFSIZE (64<<10) // 오리진 응답 읽기 버퍼 (큰 본문은 read 한 번에 많이)
 
+// 연결 타임아웃 기본값 (밀리초) - PROXY_*_TIMEOUT_MS 환경 변수로 변경, 0이면 끔
+#define HEADER_TIMEOUT_MS 10000 // 요청 헤드를 다 받을 때까지 (slow-loris)
+#define FIRST_BYTE_TIMEOUT_MS 30000 // 오리진에 요청을 보낸 뒤 응답 첫 바이트까지
+#define IDLE_TIMEOUT_MS 30000 // 중계 중 어느 쪽으로도 진행이 없는 시간
+#define REQUEST_TIMEOUT_MS 600000 // 요청 하나 전체 (CONNECT 터널은 제외)
+#define TUNNEL_IDLE_TIMEOUT_MS 300000 // CONNECT 터널의 유휴
+// 오리진 connect 타임아웃은 resolver_connect 안에서 (PROXY_CONNECT_TIMEOUT_MS)
+
+/**
+ * 연결 하나의 타임아웃 상태 - 만료되면 타이머 스레드가 소켓을 shutdown ==> 블로킹 중인 read는 EOF,
+ * write는 EPIPE로 바로 풀려서 스레드가 평소 경로로 정리하고 끝남 (스레드를 죽이거나 시그널을 쓰지 않음).
+ */
 typedef struct {
-  char method[SHORT_CHARS];
-  char uri[MAXLINE];
-  char version[SHORT_CHARS];
-  char hostname[MAXLINE];
-  char port[SHORT_CHARS];
-  char path[MAXLINE];
+  pthread_mutex_t lock; // fd 교체와 만료 콜백 사이
+  int clientfd; // -1이면 없음 (백그라운드 채우기, 구간 받기)
+  int serverfd; // -1이면 없음
+  const char *phase_name; // 지금 걸린 phase 타이머 이름
+  int phase_client_too; // phase 만료 때 클라이언트 쪽도 끊을지 (첫 바이트 대기는 504를 보내야 하므로 0)
+  const char *expired; // 만료된 타임아웃 이름 (NULL이면 아직)
+  timer_node_t phase; // 헤더 / 첫 바이트 / 유휴 - 단계가 바뀔 때마다 다시 걺
+  timer_node_t deadline; // 요청 전체
+} conn_t;
+
+typedef struct {
+  // 소켓에서 읽은 요청 헤드 원본 - method/uri/version/헤더는 전부 이 버퍼 안의 구간 (복사 없음)
+  http_parser_t head;
 
-  // 전체 헤더 줄들을 저장 (각 줄은 NULL문자로 끊음!)
-  char headers[MAX_HEADERS][MAXLINE];
-  int header_count;
+  char cache_key[MAXLINE]; // 정규화된 URI (캐시 키)
+  char hostname[HOSTPORT_LEN];
+  char port[SHORT_CHARS];
+  int path_off; // head.buf 안에서 uri의 경로 부분 시작 (-1이면 "/")
+  conn_t *conn; // 이 요청의 타임아웃 (NULL이면 없음)
+  arena_t *arena; // 요청 동안의 버퍼는 전부 여기서 (요청이 끝나면 한 번에 반납)
 } http_request_t;
 
+// 요청 헤드 버퍼 안의 NULL 종결 문자열들
+#define REQ_METHOD(req) HTTP_SLICE_PTR(&(req)->head, (req)->head.method)
+#define REQ_URI(req) HTTP_SLICE_PTR(&(req)->head, (req)->head.uri)
+#define REQ_PATH(req) ((req)->path_off >= 0 ? (req)->head.buf + (req)->path_off : "/")
+// 헤더 줄들을 CRLF 포함 그대로 이어붙인 블록 (오리진 전달, 캐시 Vary 매칭용)
+#define REQ_HEADERS(req) HTTP_SLICE_PTR(&(req)->head, (req)->head.headers_block)
+#define REQ_HEADERS_LEN(req) ((req)->head.headers_block.len)
+
+// Range 요청의 한 구간 (양 끝 포함, 절대 오프셋)
+typedef struct {
+  long first;
+  long last;
+} byte_range_t;
+
+// 나눠 받는 큰 객체의 한 구간 (lock/cond는 구간들이 공유)
+typedef struct {
+  http_request_t *req;
+  const char *validator; // If-Range 값 (ETag 또는 Last-Modified, 없으면 "")
+  long first, last; // 구간 (양 끝 포함)
+  long total; // 객체 전체 크기 - 206의 Content-Range와 대조
+  char *buf;
+  long received; // buf에 받은 바이트 수 (lock 보호)
+  int state; // 0 받는 중, 1 완료, -1 실패 (lock 보호)
+  int started; // 스레드를 띄웠는지 (join 대상)
+  pthread_mutex_t *lock;
+  pthread_cond_t *cond;
+} segment_t;
+
+// Range 미스 백그라운드 채우기 (진행 중인 것은 g_range_fills에 - 같은 키는 하나만)
+typedef struct range_fill {
+  http_request_t *req; // 스레드가 해제하는 사본 (req->cache_key가 키)
+  struct range_fill *next;
+} range_fill_arg_t;
+
 
 /* 전역 함수 선언 */
 void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longmsg );
-void client_handler(int connfd);  // Ensure the prototype matches the definition
+void client_handler(int connfd, conn_t *conn);  // Ensure the prototype matches the definition
 void sigint_handler(int sig);
 void *thread_main_process_client(void *void_arg_p);
+void coro_main_process_client(void *void_arg_p);
 void handle_http_request(int clientfd, http_request_t *req);
-void tunnel_relay(int clientfd, char *hostname, char *port);
+void tunnel_relay(int clientfd, char *hostname, char *port, conn_t *conn);
+void handle_purge(int clientfd, http_request_t *req);
+void send_plain_response(int fd, char* errnum, char* shortmsg, char* body);
 
 // 이하는 tiny에서 가져온 파트
-int parse_uri(char* uri, char* hostname, char* port, char* path);
+int parse_uri(char* uri, char* hostname, char* port, char** path);
 
 
 /* 전역 변수 */
 // int g_total_bytes_received = 0; 
 static cache_t* g_shared_cache = NULL;
+static struct { // 진행 중인 Range 채우기 - 같은 객체를 여러 번 받지 않도록
+  pthread_mutex_t lock;
+  range_fill_arg_t *head;
+} g_range_fills = { PTHREAD_MUTEX_INITIALIZER, NULL };
+static struct { // 연결 타임아웃 (밀리초) - 기본값은 *_TIMEOUT_MS
+  int header_ms;
+  int first_byte_ms;
+  int idle_ms;
+  int request_ms;
+  int tunnel_idle_ms;
+} g_timeouts = { HEADER_TIMEOUT_MS, FIRST_BYTE_TIMEOUT_MS, IDLE_TIMEOUT_MS, REQUEST_TIMEOUT_MS, TUNNEL_IDLE_TIMEOUT_MS };
+
+static void env_timeout(const char *name, int *ms) {
+  if (getenv(name))
+    *ms = atoi(getenv(name));
+}
 
 
 /* $begin proxyserversmain */
@@ -47,7 +134,24 @@ int main(int argc, char **argv){
   
   g_shared_cache = Malloc(sizeof(cache_t));
   cache_init(g_shared_cache);
+  if (getenv("PROXY_IGNORE_PARAMS")) // 예: PROXY_IGNORE_PARAMS="utm_*,fbclid,ref"
+    cache_set_ignored_params(getenv("PROXY_IGNORE_PARAMS"));
+  if (getenv("PROXY_CONNECT_TIMEOUT_MS")) // 오리진 connect 제한 시간 (기본 RESOLVER_CONNECT_TIMEOUT_MS)
+    resolver_set_connect_timeout(atoi(getenv("PROXY_CONNECT_TIMEOUT_MS")));
+  sockopt_load_env(); // PROXY_TCP_* / PROXY_SO_* (sockopt.c)
+  env_timeout("PROXY_HEADER_TIMEOUT_MS", &g_timeouts.header_ms);
+  env_timeout("PROXY_FIRST_BYTE_TIMEOUT_MS", &g_timeouts.first_byte_ms);
+  env_timeout("PROXY_IDLE_TIMEOUT_MS", &g_timeouts.idle_ms);
+  env_timeout("PROXY_REQUEST_TIMEOUT_MS", &g_timeouts.request_ms);
+  env_timeout("PROXY_TUNNEL_IDLE_TIMEOUT_MS", &g_timeouts.tunnel_idle_ms);
   signal(SIGINT, sigint_handler); // 시그널 핸들러는 가능한 빨리
+  Signal(SIGPIPE, SIG_IGN); // 끊긴(또는 타임아웃으로 shutdown한) 소켓에 쓰면 프로세스 대신 그 write만 EPIPE
+  timer_wheel_start();
+  // CONNECT 터널 릴레이 스레드 (기본 TUNNEL_RELAY_THREADS, 0이면 연결 스레드가 직접 중계)
+  tunnel_start(getenv("PROXY_TUNNEL_THREADS") ? atoi(getenv("PROXY_TUNNEL_THREADS")) : TUNNEL_RELAY_THREADS);
+  // 연결을 코루틴으로 돌릴 스케줄러 스레드 (기본 CORO_THREADS, 0이면 연결마다 스레드) - 한가한 스케줄러가 바쁜 쪽 큐를 훔침 (CORO_STEAL)
+  coro_start(getenv("PROXY_CORO_THREADS") ? atoi(getenv("PROXY_CORO_THREADS")) : CORO_THREADS,
+             getenv("PROXY_CORO_STEAL") ? atoi(getenv("PROXY_CORO_STEAL")) : CORO_STEAL);
 
   if (argc != 2) {
     fprintf(stderr, "usage: %s <port>\n", argv[0]);
@@ -55,16 +159,24 @@ int main(int argc, char **argv){
   }
 
   listenfd = Open_listenfd(argv[1]);
+  sockopt_apply_listener(listenfd);
+  sockopt_print_config(listenfd);
   while (1) {
     int* connfd_p = Malloc(sizeof(int));
     *connfd_p = Accept(listenfd, (SA *)&clientaddr, &clientlen);
     pthread_t tid;
-    pthread_create(&tid, NULL, thread_main_process_client, connfd_p);
+    if (coro_submit(coro_main_process_client, connfd_p) < 0)
+      pthread_create(&tid, NULL, thread_main_process_client, connfd_p);
   }
 }
 /* $end proxyserversmain */
 
 void sigint_handler(int sig) {
+  cache_print_stats(g_shared_cache);
+  resolver_print_stats();
+  tunnel_print_stats();
+  arena_print_stats();
+  coro_print_stats();
   cache_deinit(g_shared_cache);
   Free(g_shared_cache);
   g_shared_cache = NULL;
@@ -72,160 +184,970 @@ void sigint_handler(int sig) {
   exit(0);
 }
 
+/**
+ * conn_shutdown_unmanaged - 연결의 소켓을 끊어 블로킹 중인 I/O를 풀어줌 (conn->lock 잡고)
+ * close가 아니라 shutdown이므로 fd 번호는 그대로 ==> 주인 스레드가 평소처럼 Close.
+ */
+static void conn_shutdown_unmanaged(conn_t *conn, const char *name, int client_too) {
+  if (conn->expired == NULL)
+    conn->expired = name;
+  if (conn->serverfd >= 0)
+    shutdown(conn->serverfd, SHUT_RDWR);
+  if (client_too && conn->clientfd >= 0)
+    shutdown(conn->clientfd, SHUT_RDWR);
+}
+
+/* 타이머 콜백 - 타이머 스레드에서 휠 락을 잡은 채로 불림 */
+static void conn_phase_expired(void *arg) {
+  conn_t *conn = arg;
+  pthread_mutex_lock(&conn->lock);
+  conn_shutdown_unmanaged(conn, conn->phase_name, conn->phase_client_too);
+  pthread_mutex_unlock(&conn->lock);
+}
+
+static void conn_deadline_expired(void *arg) {
+  conn_t *conn = arg;
+  pthread_mutex_lock(&conn->lock);
+  conn_shutdown_unmanaged(conn, "request", 1);
+  pthread_mutex_unlock(&conn->lock);
+}
+
+static void conn_init(conn_t *conn, int clientfd) {
+  pthread_mutex_init(&conn->lock, NULL);
+  conn->clientfd = clientfd;
+  conn->serverfd = -1;
+  conn->phase_name = NULL;
+  conn->phase_client_too = 1;
+  conn->expired = NULL;
+  timer_init(&conn->phase, conn_phase_expired, conn);
+  timer_init(&conn->deadline, conn_deadline_expired, conn);
+}
+
+/**
+ * conn_timeout - phase 타이머를 timeout_ms 뒤로 (다시) 걺. 유휴 타이머는 진행이 있을 때마다 불러서 미룸 (O(1)).
+ * @param client_too: 만료 때 클라이언트 소켓도 끊을지 (0이면 오리진 쪽만 ==> 클라이언트에 오류 응답 가능)
+ */
+static void conn_timeout(conn_t *conn, const char *name, int timeout_ms, int client_too) {
+  if (conn == NULL || timeout_ms <= 0)
+    return;
+  pthread_mutex_lock(&conn->lock);
+  conn->phase_name = name;
+  conn->phase_client_too = client_too;
+  pthread_mutex_unlock(&conn->lock);
+  timer_add(&conn->phase, timeout_ms);
+}
+
+/**
+ * conn_set_client - 만료 때 끊을 클라이언트 소켓을 지정 (-1이면 이 연결 소유가 아님 ==> 주인 스레드도 Close하지 않음)
+ */
+static void conn_set_client(conn_t *conn, int clientfd) {
+  pthread_mutex_lock(&conn->lock);
+  conn->clientfd = clientfd;
+  pthread_mutex_unlock(&conn->lock);
+}
+
+/**
+ * conn_set_server - 만료 때 같이 끊을 오리진 소켓을 지정 (Close 전에는 반드시 -1로 ==> 재사용된 fd 번호를 끊지 않게)
+ */
+static void conn_set_server(conn_t *conn, int serverfd) {
+  if (conn == NULL)
+    return;
+  pthread_mutex_lock(&conn->lock);
+  conn->serverfd = serverfd;
+  pthread_mutex_unlock(&conn->lock);
+}
+
+static const char *conn_expired(conn_t *conn) {
+  const char *expired;
+  if (conn == NULL)
+    return NULL;
+  pthread_mutex_lock(&conn->lock);
+  expired = conn->expired;
+  pthread_mutex_unlock(&conn->lock);
+  return expired;
+}
+
+/**
+ * conn_finish - 타이머를 모두 뗌 (돌아온 뒤에는 콜백이 이 연결의 fd를 건드리지 않음 ==> 이제 Close해도 안전)
+ */
+static void conn_finish(conn_t *conn) {
+  const char *expired;
+
+  timer_cancel(&conn->phase);
+  timer_cancel(&conn->deadline);
+  if ((expired = conn_expired(conn)) != NULL)
+    fprintf(stderr, "%s timeout - connection dropped\n", expired);
+  pthread_mutex_destroy(&conn->lock);
+}
+
+/**
+ * process_client - 연결 하나를 처음부터 끝까지 (스레드로 돌든 코루틴으로 돌든 같은 코드)
+ */
+static void process_client(int connfd) {
+  conn_t conn;
+
+  conn_init(&conn, connfd);
+  conn_timeout(&conn, "header", g_timeouts.header_ms, 1);
+  if (g_timeouts.request_ms > 0)
+    timer_add(&conn.deadline, g_timeouts.request_ms);
+
+  client_handler(connfd, &conn);  // 클라이언트 요청 처리
+
+  conn_finish(&conn);
+  if (conn.clientfd >= 0) // CONNECT 터널이면 릴레이 스레드로 넘어가서 -1
+    Close(connfd);
+}
+
 void *thread_main_process_client(void *void_arg_p) {
   int connfd = *((int *)void_arg_p);
 
   Free(void_arg_p); // 얘는 받자마자 free시킴.
   void_arg_p = NULL;
   pthread_detach(pthread_self());  // 스레드 종료 시 자동 회수
-
-  client_handler(connfd);  // 클라이언트 요청 처리
-
-  Close(connfd);
+  process_client(connfd);
   return NULL;
 }
 
-void client_handler(int connfd){
-  rio_t client_rio;
-  char buf[MAXLINE], line[MAXLINE];
-  http_request_t* req_p = Malloc(sizeof(http_request_t));
+/**
+ * coro_main_process_client - 코루틴판 (스케줄러 스레드에서 돎 ==> detach 안 함)
+ */
+void coro_main_process_client(void *void_arg_p) {
+  int connfd = *((int *)void_arg_p);
+
+  Free(void_arg_p);
+  process_client(connfd);
+}
 
-  Rio_readinitb(&client_rio, connfd);
+void client_handler(int connfd, conn_t *conn){
+  arena_t *arena = arena_acquire(); // 풀에서 빌림 - 요청 구조체와 중계 버퍼가 전부 여기서 (Malloc 없음)
+  http_request_t* req_p = arena_alloc(arena, sizeof(http_request_t));
+  char *path_p;
+  int rc;
 
-  // 요청 라인 읽기
-  if (Rio_readlineb(&client_rio, buf, MAXLINE) <= 0)  // EOF면 연결 정리 
+  // 요청 라인 + 헤더를 버퍼로 바로 읽으며 파싱 (헤더 타임아웃이 지나면 shutdown으로 EOF가 됨)
+  req_p->conn = conn;
+  req_p->arena = arena;
+  http_parser_init(&req_p->head);
+  rc = http_read_head(&req_p->head, connfd);
+  if (rc == HTTP_PARSE_CLOSED || conn_expired(conn)) { // EOF(또는 타임아웃)면 연결 정리
+    arena_release(arena);
+    return;
+  }
+  conn_timeout(conn, "idle", g_timeouts.idle_ms, 1); // 이후 기본은 유휴 타임아웃 (캐시 히트 전송 등)
+  if (rc == HTTP_PARSE_TOO_LARGE) {
+    clienterror(connfd, "", "431", "Request Header Fields Too Large", "요청 헤더가 너무 큼");
+    arena_release(arena);
     return;
-  // sscanf(buf, "%s %s %s", req_p->method, req_p->uri, req_p->version);
-  sscanf(buf, "%s %s %s", req_p->method, req_p->uri, req_p->version);
+  }
+  if (rc != HTTP_PARSE_DONE) {
+    clienterror(connfd, "", "400", "Bad Request", "요청 파싱 실패");
+    arena_release(arena);
+    return;
+  }
 
   // CONNECT일 경우 터널링 (양방향 TCP 패스쓰루)
-  if (!strcasecmp(req_p->method, "CONNECT")) {
-    char *colon = strchr(req_p->uri, ':');
-    if (colon) {
+  if (!strcasecmp(REQ_METHOD(req_p), "CONNECT")) {
+    char *uri = REQ_URI(req_p);
+    char *colon = strchr(uri, ':');
+    if (colon)
       *colon = '\0';
-      strcpy(req_p->hostname, req_p->uri);
-      strcpy(req_p->port, colon + 1);
-    } else {
-      strcpy(req_p->hostname, req_p->uri);
-      strcpy(req_p->port, "443");
-    }
-    tunnel_relay(connfd, req_p->hostname, req_p->port);
+    snprintf(req_p->hostname, HOSTPORT_LEN, "%s", uri);
+    snprintf(req_p->port, SHORT_CHARS, "%s", colon ? colon + 1 : "443");
+    tunnel_relay(connfd, req_p->hostname, req_p->port, conn);
+    arena_release(arena);
     return;
   }
 
   // 일반 HTTP 요청 처리 
-  if (!parse_uri(req_p->uri, req_p->hostname, req_p->port, req_p->path)) {
-    clienterror(connfd, req_p->uri, "400", "Bad Request", "URI 파싱 실패");
+  if (!parse_uri(REQ_URI(req_p), req_p->hostname, req_p->port, &path_p)) {
+    clienterror(connfd, REQ_URI(req_p), "400", "Bad Request", "URI 파싱 실패");
+    arena_release(arena);
     return;
   }
+  req_p->path_off = path_p ? path_p - req_p->head.buf : -1;
+  cache_normalize_uri(REQ_URI(req_p), req_p->cache_key, MAXLINE); // 요청당 한 번만
 
-  // 나머지 헤더 수집 
-  req_p->header_count = 0;
-  while (Rio_readlineb(&client_rio, line, MAXLINE) > 0) {
-    if (!strcmp(line, "\r\n")) break;
-    if (req_p->header_count < MAX_HEADERS)
-      strcpy(req_p->headers[req_p->header_count++], line);
+  // PURGE는 캐시 관리 요청 - 오리진으로 보내지 않음
+  if (!strcasecmp(REQ_METHOD(req_p), "PURGE")) {
+    handle_purge(connfd, req_p);
+    arena_release(arena);
+    return;
   }
 
   handle_http_request(connfd, req_p);
-  Free(req_p);
+  arena_release(arena); // req_p도 같이 무효
   req_p = NULL;
 }
 
-void handle_http_request(int clientfd, http_request_t *req) {
-  /**
-    1. Open_clientfd(hostname, port)
-    2. write(서버에 요청 라인 + 헤더)
-    3. read(서버 응답)
-    4. write(응답을 clientfd로 전달)
-    5. Close(serverfd)
-   */
-  int serverfd;
-  char buf[MAXLINE];
+/**
+ * is_loopback_peer - 접속한 클라이언트가 로컬호스트인지 확인 (관리 요청 허용 여부)
+ */
+static int is_loopback_peer(int fd) {
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
 
-  int cached_size;
-  char *cached_buf = Malloc(MAX_OBJECT_SIZE);
-  
-  // 캐시 있을 때
-  if (cache_get(g_shared_cache, req->uri, cached_buf, &cached_size)) {
-    Rio_writen(clientfd, cached_buf, cached_size);
-    Free(cached_buf);
-    cached_buf = NULL;
-    return;  // 캐시 히트! 얼리 리턴.
+  if (getpeername(fd, (SA *)&addr, &len) < 0)
+    return 0;
+  if (addr.ss_family == AF_INET)
+    return (ntohl(((struct sockaddr_in *)&addr)->sin_addr.s_addr) >> 24) == 127;
+  if (addr.ss_family == AF_INET6)
+    return IN6_IS_ADDR_LOOPBACK(&((struct sockaddr_in6 *)&addr)->sin6_addr);
+  return 0;
+}
+
+/**
+ * handle_purge - 캐시 무효화 요청 처리 (로컬호스트에서만 허용)
+ *   PURGE http://host/path HTTP/1.0                     → 해당 URI 즉시 삭제
+ *   X-Purge-Type: host   + PURGE http://host:port/      → 그 host의 모든 객체
+ *   X-Purge-Type: prefix + PURGE http://host/static/    → 그 URI로 시작하는 모든 객체
+ *   X-Purge-Type: tag    + Surrogate-Key: t1 t2         → 응답 Surrogate-Key에 t1 또는 t2가 있는 객체
+ * host/prefix/tag는 세대 번호 기반 지연 삭제라 대량 퍼지라도 캐시 락을 오래 잡지 않음.
+ */
+void handle_purge(int clientfd, http_request_t *req) {
+  char type[SHORT_CHARS];
+  char *body = arena_alloc(req->arena, MAXLINE + 64); // 키(최대 MAXLINE) + 앞뒤 문구
+  unsigned long gen = 0;
+
+  if (!is_loopback_peer(clientfd)) {
+    clienterror(clientfd, REQ_METHOD(req), "403", "Forbidden", "PURGE is only allowed from localhost");
+    return;
   }
-  // 아래부터는 전부 캐시 없을 때
 
-  serverfd = Open_clientfd(req->hostname, req->port);
-  if (serverfd < 0) {
-    clienterror(clientfd, req->hostname, "502", "Bad Gateway", "Proxy couldn't connect to origin server");
+  if (!http_find_header(&req->head, HTTP_HDR_X_PURGE_TYPE, type, sizeof(type)) || !strcasecmp(type, "exact")) {
+    cache_remove(g_shared_cache, req->cache_key);
+    snprintf(body, MAXLINE + 64, "Purged %s\r\n", req->cache_key);
+  } else if (!strcasecmp(type, "host")) {
+    char *host = req->cache_key + 7; // parse_uri()가 "http://" 접두어를 이미 확인함
+    host[strcspn(host, "/")] = '\0';
+    gen = cache_ban(g_shared_cache, PURGE_HOST, host);
+    snprintf(body, MAXLINE + 64, "Purged host %s (generation %lu)\r\n", host, gen);
+  } else if (!strcasecmp(type, "prefix")) {
+    gen = cache_ban(g_shared_cache, PURGE_PREFIX, req->cache_key);
+    snprintf(body, MAXLINE + 64, "Purged prefix %s (generation %lu)\r\n", req->cache_key, gen);
+  } else if (!strcasecmp(type, "tag")) {
+    char *tags = arena_alloc(req->arena, MAXLINE);
+    if (!http_find_header(&req->head, HTTP_HDR_SURROGATE_KEY, tags, MAXLINE)) {
+      clienterror(clientfd, type, "400", "Bad Request", "Tag purge needs a Surrogate-Key header");
+      return;
+    }
+    char *save_p;
+    for (char *tag = strtok_r(tags, " ", &save_p); tag; tag = strtok_r(NULL, " ", &save_p)) // 태그마다 규칙 하나씩
+      gen = cache_ban(g_shared_cache, PURGE_TAG, tag);
+    snprintf(body, MAXLINE + 64, "Purged tags (generation %lu)\r\n", gen);
+  } else {
+    clienterror(clientfd, type, "400", "Bad Request", "Unknown X-Purge-Type");
     return;
   }
-  
-  // http://httpforever.com/js/init.min.js, httpforever.com, 80, /js/init.min.js
-  // printf("%s, %s, %s, %s\n",req->uri, req->hostname, req->port, req->path);
 
-  // 요청 라인
-  snprintf(buf, MAXLINE, "%s %s HTTP/1.0\r\n", req->method, req->path);
-  Rio_writen(serverfd, buf, strlen(buf));
+  send_plain_response(clientfd, "200", "OK", body);
+}
 
-  // 헤더 전송
+/**
+ * send_origin_request - 오리진으로 요청 라인 + 헤더 전송 (연결 관련 헤더는 통일)
+ * 클라이언트가 보낸 헤더 바이트를 그대로 가리키는 iovec으로 조립해서 writev 한 번에 보냄.
+ * 빠지는 헤더 사이의 연속된 줄들은 iovec 하나로 합침.
+ * 요청 라인과 Host도 요청 버퍼의 조각을 가리킴 - 구간 스레드가 같은 req로 동시에 부르므로 아레나는 안 씀.
+ * @param extra_hdrs: NULL이면 클라이언트 헤더 그대로, 아니면 Range/If-Range를 빼고 이 헤더들을 덧붙임 ("" 가능)
+ */
+static void send_origin_request(int serverfd, http_request_t *req, const char *extra_hdrs) {
+  static const char fixed_hdrs[] = "Connection: close\r\n"
+                                   "Proxy-Connection: close\r\n"
+                                   "User-Agent: Mozilla/5.0 (compatible; GabesProxy/1.0)\r\n";
+  struct iovec iov[FORWARD_IOV_MAX];
+  const char *method = REQ_METHOD(req), *path = REQ_PATH(req);
+  int cnt = 0;
   int has_host = 0;
-  for (int i = 0; i < req->header_count; ++i) {
-    if (strncasecmp(req->headers[i], "Host:", 5) == 0)
+
+  // 요청 라인 "<method> <path> HTTP/1.0"
+  iov[cnt].iov_base = (void *)method;
+  iov[cnt++].iov_len = strlen(method);
+  iov[cnt].iov_base = " ";
+  iov[cnt++].iov_len = 1;
+  iov[cnt].iov_base = (void *)path;
+  iov[cnt++].iov_len = strlen(path);
+  iov[cnt].iov_base = " HTTP/1.0\r\n";
+  iov[cnt++].iov_len = 11;
+
+  // 클라이언트 헤더 (원래 바이트 그대로) - 이름은 파싱 때 분류해 둔 id로 거름
+  http_parser_t *head = &req->head;
+  const char *end = REQ_HEADERS(req) + REQ_HEADERS_LEN(req);
+  for (int i = 0; i < head->header_count; ++i) {
+    const char *p = HTTP_SLICE_PTR(head, head->headers[i].name);
+    const char *next = i + 1 < head->header_count ? HTTP_SLICE_PTR(head, head->headers[i+1].name) : end;
+    size_t len = next - p;
+    http_header_id_t id = head->headers[i].id;
+    int skip = id == HTTP_HDR_CONNECTION || id == HTTP_HDR_PROXY_CONNECTION || id == HTTP_HDR_USER_AGENT ||
+               (extra_hdrs && (id == HTTP_HDR_RANGE || id == HTTP_HDR_IF_RANGE));
+    if (id == HTTP_HDR_HOST)
       has_host = 1;
-    else if (strncasecmp(req->headers[i], "Connection:", 11) == 0)
-      continue;
-    else if (strncasecmp(req->headers[i], "Proxy-Connection:", 17) == 0)
-      continue;
-    else if (strncasecmp(req->headers[i], "User-Agent:", 11) == 0)
-      continue;
 
-    Rio_writen(serverfd, req->headers[i], strlen(req->headers[i]));
+    if (!skip && cnt > 1 && (char *)iov[cnt-1].iov_base + iov[cnt-1].iov_len == p) {
+      iov[cnt-1].iov_len += len; // 바로 앞 줄에 이어 붙임
+    } else if (!skip) {
+      if (cnt == FORWARD_IOV_MAX - 6) { // 뒤에 붙일 6개 자리는 남겨둠
+        Rio_writev(serverfd, iov, cnt);
+        cnt = 0;
+      }
+      iov[cnt].iov_base = (void *)p;
+      iov[cnt++].iov_len = len;
+    }
   }
 
   // 헤더 보완
   if (!has_host) {
-    snprintf(buf, MAXLINE, "Host: %s\r\n", req->hostname);
-    Rio_writen(serverfd, (void*)buf, strlen(buf));
+    iov[cnt].iov_base = "Host: ";
+    iov[cnt++].iov_len = 6;
+    iov[cnt].iov_base = req->hostname;
+    iov[cnt++].iov_len = strlen(req->hostname);
+    iov[cnt].iov_base = "\r\n";
+    iov[cnt++].iov_len = 2;
   }
 
   // 필수 헤더들 통일
-  sprintf(buf, "Connection: close\r\n");
-  Rio_writen(serverfd, buf, strlen(buf));
-  sprintf(buf, "Proxy-Connection: close\r\n");
-  Rio_writen(serverfd, buf, strlen(buf));
-  sprintf(buf, "User-Agent: Mozilla/5.0 (compatible; GabesProxy/1.0)\r\n");
-  Rio_writen(serverfd, buf, strlen(buf));
+  iov[cnt].iov_base = (void *)fixed_hdrs;
+  iov[cnt++].iov_len = sizeof(fixed_hdrs) - 1;
+  if (extra_hdrs && *extra_hdrs) {
+    iov[cnt].iov_base = (void *)extra_hdrs;
+    iov[cnt++].iov_len = strlen(extra_hdrs);
+  }
 
   // 클라이언트로부터의 리퀘스트를 서버로 전달 끝.
-  // 아래부터는 서버로부터의 리스폰스를 클라이언트에 전달.
-  Rio_writen(serverfd, "\r\n", 2);
+  iov[cnt].iov_base = "\r\n";
+  iov[cnt++].iov_len = 2;
+  Rio_writev(serverfd, iov, cnt);
+}
+
+/**
+ * segment_fetch - 세그먼트 하나를 별도 연결의 Range 요청으로 받아 seg->buf에 채움
+ * 받는 대로 received를 늘리고 broadcast하므로 메인 스레드가 순서대로 따라 읽을 수 있음.
+ * 206이 아니거나 Content-Range가 요청과 다르면 (객체가 바뀌었으면) 실패.
+ */
+static void segment_fetch(segment_t *seg) {
+  char buf[MAXLINE], extra[MAXLINE + 64];
+  long len = seg->last - seg->first + 1;
+  long first = -1, last = -1, total = -1;
+  int status = 0, result = -1;
+  rio_t rio;
+  conn_t conn; // 구간 연결의 타임아웃 (클라이언트 없음)
+  ssize_t n;
+
+  int fd = resolver_open_clientfd(seg->req->hostname, seg->req->port);
+  if (fd >= 0) {
+    conn_init(&conn, -1);
+    conn_set_server(&conn, fd);
+    conn_timeout(&conn, "segment first byte", g_timeouts.first_byte_ms, 1);
+    n = snprintf(extra, sizeof(extra), "Range: bytes=%ld-%ld\r\n", seg->first, seg->last);
+    if (seg->validator[0]) // 그 사이 객체가 바뀌었으면 206 대신 200이 와서 실패로 걸러짐
+      snprintf(extra + n, sizeof(extra) - n, "If-Range: %s\r\n", seg->validator);
+    send_origin_request(fd, seg->req, extra);
+
+    Rio_readinitb(&rio, fd);
+    while ((n = Rio_readlineb(&rio, buf, MAXLINE)) > 0 && strcmp(buf, "\r\n") != 0 && strcmp(buf, "\n") != 0) {
+      if (status == 0) {
+        sscanf(buf, "%*s %d", &status);
+        conn_timeout(&conn, "segment idle", g_timeouts.idle_ms, 1);
+      }
+      else if (strncasecmp(buf, "Content-Range:", 14) == 0)
+        sscanf(buf + 14, " bytes %ld-%ld/%ld", &first, &last, &total);
+    }
+
+    if (n > 0 && status == 206 && first == seg->first && last == seg->last && total == seg->total) {
+      while (seg->received < len && (n = Rio_readnb(&rio, seg->buf + seg->received, 
+                                                     len - seg->received < MAXBUF ? len - seg->received : MAXBUF)) > 0) {
+        pthread_mutex_lock(seg->lock);
+        seg->received += n;
+        pthread_cond_broadcast(seg->cond);
+        pthread_mutex_unlock(seg->lock);
+        conn_timeout(&conn, "segment idle", g_timeouts.idle_ms, 1);
+      }
+      if (seg->received == len)
+        result = 1;
+    }
+    conn_finish(&conn);
+    Close(fd);
+  }
+
+  pthread_mutex_lock(seg->lock);
+  seg->state = result;
+  pthread_cond_broadcast(seg->cond);
+  pthread_mutex_unlock(seg->lock);
+}
+
+static void *segment_thread(void *void_arg_p) {
+  segment_fetch(void_arg_p);
+  return NULL;
+}
+
+/**
+ * relay_out - 받은 본문 조각을 클라이언트 (있으면)와 채우는 중인 캐시 (있으면)로 보냄 (진행했으니 유휴 타이머를 미룸)
+ * @return 0, 캐시 채우기가 실패했으면 (할당 실패, MAX_STREAM_OBJECT_SIZE 초과) -1
+ */
+static int relay_out(conn_t *conn, int clientfd, cache_fill_t *fill, const char *data, long n) {
+  if (clientfd >= 0)
+    Rio_writen(clientfd, (void *)data, n);
+  conn_timeout(conn, "idle", g_timeouts.idle_ms, 1);
+  if (fill && cache_fill_append(g_shared_cache, fill, data, n) < 0)
+    return -1;
+  return 0;
+}
+
+/**
+ * relay_segmented - 큰 객체를 SEGMENT_COUNT개 구간으로 나눠 병렬로 받으면서 순서대로 중계/캐시
+ * 첫 구간은 이미 열린 원래 연결에서, 나머지는 구간마다 새 연결의 Range 요청으로 동시에 받음.
+ * 클라이언트와 캐시에는 항상 앞 구간부터 순서대로 나가고, 뒤 구간은 그동안 미리 받아둠.
+ * 구간 요청이 하나라도 실패하면 (Range를 광고만 하고 안 지키는 오리진 등) 원래 연결에서 이어 받음.
+ * 
+ * @param validator: 원래 응답의 ETag 또는 Last-Modified (구간 요청의 If-Range용, 없으면 "")
+ * @return 본문 전체를 제대로 보내고 캐시에도 다 채웠으면 1, 아니면 0 (==> 호출한 쪽이 채우기를 버림)
+ */
+static int relay_segmented(int clientfd, rio_t *server_rio, http_request_t *req, cache_fill_t *fill,
+                           long length, const char *validator) {
+  segment_t segs[SEGMENT_COUNT];
+  pthread_t tids[SEGMENT_COUNT];
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  long seg_len = (length + SEGMENT_COUNT - 1) / SEGMENT_COUNT;
+  long pos = 0; // 클라이언트/캐시로 보낸 바이트 수
+  long main_pos = 0; // 원래 연결에서 읽은 바이트 수
+  cache_fill_t *fill_out = fill; // 캐시 채우기가 실패하면 NULL (클라이언트에는 계속 중계)
+  const char *data;
+  ssize_t n;
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&cond, NULL);
+  for (int k = 1; k < SEGMENT_COUNT; k++) {
+    segment_t *seg = &segs[k];
+    seg->req = req;
+    seg->validator = validator;
+    seg->first = k * seg_len;
+    seg->last = ((k + 1) * seg_len < length ? (k + 1) * seg_len : length) - 1;
+    seg->total = length;
+    seg->buf = arena_alloc(req->arena, seg->last - seg->first + 1); // 기본 블록보다 크면 따로 Malloc (요청이 끝날 때 해제)
+    seg->received = 0;
+    seg->state = 0;
+    seg->lock = &lock;
+    seg->cond = &cond;
+    seg->started = pthread_create(&tids[k], NULL, segment_thread, seg) == 0;
+    if (!seg->started)
+      seg->state = -1; // 아래에서 직접 받음
+  }
+
+  // 1. 첫 구간은 원래 연결에서 (나머지 본문은 아직 안 읽음) - 읽기 버퍼에서 바로 중계
+  while (main_pos < seg_len && (clientfd >= 0 || fill_out) && (n = Rio_peekb(server_rio, &data)) > 0) {
+    if (n > seg_len - main_pos)
+      n = seg_len - main_pos;
+    Rio_consumeb(server_rio, n);
+    if (relay_out(req->conn, clientfd, fill_out, data, n) < 0)
+      fill_out = NULL;
+    main_pos += n;
+  }
+  pos = main_pos;
+
+  // 2. 나머지 구간은 순서대로 - 받은 만큼씩 바로 흘려보냄
+  for (int k = 1; k < SEGMENT_COUNT && pos == segs[k].first && (clientfd >= 0 || fill_out); k++) {
+    segment_t *seg = &segs[k];
+    long sent = 0;
+    int state;
+
+    do {
+      pthread_mutex_lock(&lock);
+      while (seg->received == sent && seg->state == 0)
+        pthread_cond_wait(&cond, &lock);
+      long received = seg->received;
+      state = seg->state;
+      pthread_mutex_unlock(&lock);
+
+      if (received > sent) {
+        if (relay_out(req->conn, clientfd, fill_out, seg->buf + sent, received - sent) < 0)
+          fill_out = NULL;
+        pos += received - sent;
+        sent = received;
+      }
+    } while (state == 0 || sent < seg->received);
+  }
+
+  // 3. 실패한 구간부터는 원래 연결에서 이어 받음 (이미 보낸 부분은 읽고 버림)
+  int main_ok = main_pos == seg_len; // 첫 구간부터 끊긴 연결이면 이어 받을 수도 없음
+  while (main_ok && pos < length && (clientfd >= 0 || fill_out)) {
+    if ((n = Rio_peekb(server_rio, &data)) <= 0)
+      break;
+    if (n > length - main_pos)
+      n = length - main_pos;
+    Rio_consumeb(server_rio, n);
+    long skip = pos - main_pos;
+    if (skip < n) {
+      if (relay_out(req->conn, clientfd, fill_out, data + skip, n - skip) < 0)
+        fill_out = NULL;
+      pos += n - skip;
+    }
+    main_pos += n;
+  }
+
+  for (int k = 1; k < SEGMENT_COUNT; k++) {
+    if (segs[k].started)
+      pthread_join(tids[k], NULL);
+  }
+  pthread_mutex_destroy(&lock);
+  pthread_cond_destroy(&cond);
+  return pos == length && fill_out != NULL;
+}
 
-  // 리스폰스 중계 & 캐시 저장
-  char *resp_buf = Malloc(MAX_OBJECT_SIZE);
-  char *object_buf = Malloc(MAX_OBJECT_SIZE);
+/**
+ * relay_response - 오리진 응답을 클라이언트로 중계하면서 캐시에 저장
+ * 작은 응답은 모아서 cache_put, MAX_OBJECT_SIZE를 넘으면 청크 스트리밍 캐시로 전환.
+ * 206 부분 응답은 전체 URI 키를 오염시키므로 캐시하지 않음.
+ * 
+ * @param clientfd: 중계할 클라이언트, -1이면 캐시만 채움 (Range 미스의 백그라운드 채우기 - 크기와 상관없이 스트리밍)
+ * @param cacheable: 0이면 캐시하지 않고 중계만
+ * @return 헤더로 알게 된 객체 전체 크기 (200의 Content-Length, 206의 Content-Range 끝 값), 모르면 -1
+ */
+static long relay_response(int clientfd, int serverfd, http_request_t *req, int cacheable) {
+  char *resp_buf = arena_alloc(req->arena, MAXLINE);
+  char *rio_buf = arena_alloc(req->arena, RELAY_BUFSIZE);
+  const char *data;
+  char *object_buf = cacheable ? arena_alloc(req->arena, MAX_OBJECT_SIZE) : NULL; // 캐시에 넣을 응답만 모음
   int object_size = 0;
-  rio_t server_rio;
+  int hdr_size;
+  int status = 0;
+  long content_length = -1;
+  long range_total = -1; // 206의 "Content-Range: bytes a-b/total"
+  long body_size = 0;
+  int accept_ranges = 0;
+  char *validator = arena_alloc(req->arena, MAXLINE); // ETag 또는 Last-Modified
+  cache_fill_t *fill = NULL;
+  rio_t *server_rio = arena_alloc(req->arena, sizeof(rio_t)); // 안의 rio_buf(8KB)까지 스택에 두지 않음
   ssize_t n;
 
-  Rio_readinitb(&server_rio, serverfd);
-  while ((n = Rio_readlineb(&server_rio, resp_buf, MAXLINE)) > 0){
-    if (object_size + n <= MAX_OBJECT_SIZE)
+  validator[0] = '\0';
+  // 1. 헤더는 줄 단위로 중계하면서 모아둠
+  Rio_readinitbuf(server_rio, serverfd, rio_buf, RELAY_BUFSIZE);
+  while ((n = Rio_readlineb(server_rio, resp_buf, MAXLINE)) > 0){
+    if (clientfd >= 0)
+      Rio_writen(clientfd, resp_buf, n);
+    if (object_buf && object_size + n <= MAX_OBJECT_SIZE)
       memcpy(object_buf + object_size, resp_buf, n);
+    else
+      cacheable = 0;
+    if (object_size == 0) {
+      sscanf(resp_buf, "%*s %d", &status);
+      conn_timeout(req->conn, "idle", g_timeouts.idle_ms, 1); // 첫 바이트 도착 ==> 이제부터는 유휴 타임아웃
+    }
+    object_size += n;
+
+    if (strncasecmp(resp_buf, "Content-Length:", 15) == 0)
+      content_length = atol(resp_buf + 15);
+    else if (strncasecmp(resp_buf, "Content-Range:", 14) == 0 && strchr(resp_buf, '/') && isdigit((unsigned char)strchr(resp_buf, '/')[1]))
+      range_total = atol(strchr(resp_buf, '/') + 1);
+    else if (strncasecmp(resp_buf, "Accept-Ranges:", 14) == 0 && strstr(resp_buf + 14, "bytes"))
+      accept_ranges = 1;
+    else if (strncasecmp(resp_buf, "ETag:", 5) == 0 && strstr(resp_buf, "W/") == NULL) // If-Range에는 강한 ETag만
+      sscanf(resp_buf + 5, " %[^\r\n]", validator);
+    else if (strncasecmp(resp_buf, "Last-Modified:", 14) == 0 && validator[0] == '\0')
+      sscanf(resp_buf + 14, " %[^\r\n]", validator);
+    if (strcmp(resp_buf, "\r\n") == 0 || strcmp(resp_buf, "\n") == 0)
+      break;
+  }
+  hdr_size = object_size;
+  if (status == 206)
+    cacheable = 0;
+  if (hdr_size == 0 && clientfd >= 0 && conn_expired(req->conn)) // 오리진이 응답을 시작도 안 함
+    clienterror(clientfd, req->hostname, "504", "Gateway Timeout", "Origin server did not respond in time");
+
+  // 2. 버퍼 하나에 안 들어갈 크기면 처음부터 청크 스트리밍 캐시로 (다른 요청이 바로 따라 읽을 수 있도록)
+  if (content_length > MAX_STREAM_OBJECT_SIZE || hdr_size == 0)
+    cacheable = 0;
+  else if (cacheable && (clientfd < 0 || hdr_size + content_length > MAX_OBJECT_SIZE))
+    fill = cache_fill_begin(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), object_buf, hdr_size);
+
+  // 2-1. 오리진이 Range를 지원하는 큰 객체는 여러 연결로 나눠 병렬로 받음
+  if (fill && status == 200 && accept_ranges && content_length >= SEGMENT_MIN_SIZE) {
+    cache_fill_end(g_shared_cache, fill, relay_segmented(clientfd, server_rio, req, fill, content_length, validator));
+    return content_length;
+  }
+
+  // 3. 본문은 읽기 버퍼에 들어온 만큼씩 바로 중계 (복사 없이). 길이를 모르는 응답이 MAX_OBJECT_SIZE를 넘으면 그때 스트리밍으로 전환
+  while ((n = Rio_peekb(server_rio, &data)) > 0){
+    Rio_consumeb(server_rio, n); // data는 다음 Rio_peekb 전까지 유효
+    if (clientfd >= 0)
+      Rio_writen(clientfd, (void *)data, n);
+    conn_timeout(req->conn, "idle", g_timeouts.idle_ms, 1);
+    body_size += n;
+    if (clientfd < 0 && fill == NULL) // 백그라운드인데 캐시도 못 하면 받을 이유가 없음
+      break;
+    if (!cacheable)
+      continue;
+
+    if (fill == NULL && object_size + n > MAX_OBJECT_SIZE) {
+      fill = cache_fill_begin(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), object_buf, hdr_size);
+      if (fill && cache_fill_append(g_shared_cache, fill, object_buf + hdr_size, object_size - hdr_size) < 0) {
+        cache_fill_end(g_shared_cache, fill, 0);
+        fill = NULL;
+      }
+      if (fill == NULL) {
+        cacheable = 0;
+        continue;
+      }
+    }
+
+    if (fill == NULL) {
+      memcpy(object_buf + object_size, data, n);
       object_size += n;
-    Rio_writen(clientfd, resp_buf, n);
+    } else if (cache_fill_append(g_shared_cache, fill, data, n) < 0) { // MAX_STREAM_OBJECT_SIZE 초과
+      cache_fill_end(g_shared_cache, fill, 0);
+      fill = NULL;
+      cacheable = 0;
+    }
+  }
+
+  // 4. 캐시 확정 - 스트리밍은 끝까지 제대로 받았을 때만 완성본으로, 작은 응답은 통째로 저장
+  if (fill)
+    cache_fill_end(g_shared_cache, fill, n == 0 && (content_length < 0 || body_size == content_length));
+  else if (cacheable && object_size <= MAX_OBJECT_SIZE)
+    cache_put(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), object_buf, object_size);
+  return status == 206 ? range_total : status == 200 ? content_length : -1;
+}
+
+/**
+ * stream_from_reader - 캐시 리더에서 본문 [offset, offset+len)을 클라이언트로 보냄
+ * @param len: -1이면 본문 끝까지
+ * @return 0 성공, -1 중간에 본문이 끊김 (채우다 실패, 클라이언트 연결 끊김 등)
+ */
+static int stream_from_reader(conn_t *conn, int clientfd, cache_reader_t *reader, long offset, long len) {
+  ssize_t n = 0;
+
+  if (cache_stream_seek(g_shared_cache, reader, offset) < 0)
+    return -1;
+  // 큰 본문은 캐시가 sendfile로 바로 소켓에 보냄 (cached_buf 복사 없음)
+  while (len != 0 && (n = cache_stream_send(g_shared_cache, reader, clientfd, len)) > 0) {
+    if (len > 0)
+      len -= n;
+    conn_timeout(conn, "idle", g_timeouts.idle_ms, 1);
   }
+  return len > 0 || n < 0 ? -1 : 0;
+}
 
-  // 3. 리스폰스 헤더 && 보디를 통째로 캐시로 저장
-  if (object_size <= MAX_OBJECT_SIZE)
-    cache_put(g_shared_cache, req->uri, object_buf, object_size);
+/**
+ * parse_range_header - "bytes=0-99, 200-, -50" 형태의 Range 값을 size 기준 절대 구간들로 변환
+ * 시작이 size 이상인 구간은 만족할 수 없으므로 버림.
+ * @return 구간 수 (0이면 416 대상), 문법 오류거나 구간이 MAX_RANGES개를 넘으면 -1 (Range 무시)
+ */
+static int parse_range_header(const char *val, long size, byte_range_t *ranges) {
+  const char *p = val + 6;
+  char *end;
+  int count = 0;
 
-  Free(object_buf);
-  Free(cached_buf);
-  object_buf = NULL;
-  cached_buf = NULL;
+  if (strncasecmp(val, "bytes=", 6) != 0)
+    return -1;
+  for (;;) {
+    long first, last;
+    p += strspn(p, " \t");
+    if (*p == '-') { // 뒤에서 N바이트
+      long suffix = strtol(p + 1, &end, 10);
+      if (end == p + 1 || suffix < 0)
+        return -1;
+      first = suffix < size ? size - suffix : 0;
+      last = suffix > 0 ? size - 1 : -1; // -0은 만족 불가
+    } else {
+      if (!isdigit((unsigned char)*p))
+        return -1;
+      first = strtol(p, &end, 10);
+      if (*end != '-')
+        return -1;
+      p = end + 1;
+      if (isdigit((unsigned char)*p)) {
+        last = strtol(p, &end, 10);
+        if (last < first)
+          return -1;
+      } else {
+        last = size - 1;
+        end = (char *)p;
+      }
+    }
+    if (last >= size)
+      last = size - 1;
+    if (first < size && first <= last) {
+      if (count == MAX_RANGES)
+        return -1;
+      ranges[count].first = first;
+      ranges[count].last = last;
+      count++;
+    }
+
+    p = end + strspn(end, " \t");
+    if (*p == '\0')
+      return count;
+    if (*p++ != ',')
+      return -1;
+  }
+}
+
+/**
+ * serve_range_from_cache - Range 요청을 캐시된 객체에서 잘라 206으로 응답 (여러 구간이면 multipart/byteranges)
+ * 채우는 중인 객체는 요청 구간이 채워지는 대로, 퇴출로 잘린 객체는 남은 앞부분 안의 구간만 응답.
+ * 200이 아닌 응답이나 크기를 모르는 객체, If-Range 요청은 Range를 무시하고 전체를 그대로 보냄.
+ * 헤더 조립 버퍼는 req->arena에서 (응답 못 하면 호출한 쪽이 되돌림)
+ * @return 응답했으면 1, 캐시로는 응답할 수 없으면 0 (클라이언트에는 아무것도 안 보냄)
+ */
+static int serve_range_from_cache(int clientfd, http_request_t *req, const char *range_val) {
+  byte_range_t ranges[MAX_RANGES];
+  char *buf = arena_alloc(req->arena, MAXBUF);
+  char *type = arena_alloc(req->arena, MAXLINE);
+  char *if_range = arena_alloc(req->arena, MAXLINE);
+  int count = -1;
+
+  cache_reader_t *reader = cache_open_stream(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), 
+                                             CACHE_STREAM_PARTIAL | CACHE_STREAM_INFLATE);
+  if (!reader)
+    return 0;
 
+  const char *sp = memchr(reader->headers, ' ', reader->hdr_length);
+  int status = sp ? atoi(sp + 1) : 0;
+  if (status == 200 && reader->object_length >= 0 && !http_find_header(&req->head, HTTP_HDR_IF_RANGE, if_range, MAXLINE))
+    count = parse_range_header(range_val, reader->object_length, ranges);
+
+  // Range를 무시하는 경우 - 잘린 객체가 아닐 때만 전체를 그대로 응답
+  if (count < 0) {
+    if (reader->avail_length < reader->object_length) {
+      cache_stream_close(g_shared_cache, reader);
+      return 0;
+    }
+    cache_stream_send_response(g_shared_cache, reader, clientfd);
+    cache_stream_close(g_shared_cache, reader);
+    return 1;
+  }
+
+  if (count == 0) {
+    snprintf(buf, MAXBUF, "HTTP/1.0 416 Range Not Satisfiable\r\nContent-Range: bytes */%ld\r\nContent-Length: 0\r\n\r\n", 
+             reader->object_length);
+    cache_stream_close(g_shared_cache, reader); // reader 해제 ==> 응답을 다 만든 뒤에
+    Rio_writen(clientfd, buf, strlen(buf));
+    return 1;
+  }
+
+  // 잘린 객체는 모든 구간이 남은 앞부분 안에 있어야 함
+  for (int i = 0; i < count; i++) {
+    if (ranges[i].last >= reader->avail_length) {
+      cache_stream_close(g_shared_cache, reader);
+      return 0;
+    }
+  }
+
+  // 206 헤더 - 저장된 헤더에서 상태 줄/길이/범위 (여러 구간이면 Content-Type도)만 바꿔 씀
+  const char *p = reader->headers;
+  const char *hdr_end = reader->headers + reader->hdr_length;
+  int n = sprintf(buf, "HTTP/1.0 206 Partial Content\r\n");
+  type[0] = '\0';
+  p = memchr(p, '\n', hdr_end - p) + 1;
+  while (p < hdr_end) {
+    const char *line_end = memchr(p, '\n', hdr_end - p);
+    int line_len = (line_end ? line_end + 1 : hdr_end) - p;
+    if (strncasecmp(p, "Content-Type:", 13) == 0 && line_len < MAXLINE) {
+      int v = 13 + strspn(p + 13, " ");
+      memcpy(type, p + v, line_len - v);
+      type[strcspn(type, "\r\n")] = '\0';
+      if (count > 1) {
+        p += line_len;
+        continue;
+      }
+    }
+    if (!(line_len <= 2 || strncasecmp(p, "Content-Length:", 15) == 0 || strncasecmp(p, "Content-Range:", 14) == 0) &&
+        n + line_len < MAXBUF - 256) { // 뒤에 붙일 범위 헤더 자리는 남겨둠
+      memcpy(buf + n, p, line_len);
+      n += line_len;
+    }
+    p += line_len;
+  }
+
+  if (count == 1) {
+    n += sprintf(buf + n, "Content-Range: bytes %ld-%ld/%ld\r\nContent-Length: %ld\r\n\r\n", 
+                 ranges[0].first, ranges[0].last, reader->object_length, ranges[0].last - ranges[0].first + 1);
+    Rio_writen(clientfd, buf, n);
+    stream_from_reader(req->conn, clientfd, reader, ranges[0].first, ranges[0].last - ranges[0].first + 1);
+    cache_stream_close(g_shared_cache, reader);
+    return 1;
+  }
+
+  // multipart/byteranges - 파트 헤더 길이를 미리 계산해서 전체 Content-Length를 알려줌
+  char *part = arena_alloc(req->arena, MAXLINE + 128);
+  char *type_line = arena_alloc(req->arena, MAXLINE + 16);
+  type_line[0] = '\0';
+  if (type[0])
+    snprintf(type_line, MAXLINE + 16, "Content-Type: %s\r\n", type);
+  long total = strlen("\r\n--" RANGE_BOUNDARY "--\r\n");
+  for (int i = 0; i < count; i++)
+    total += snprintf(part, MAXLINE + 128, "\r\n--%s\r\n%sContent-Range: bytes %ld-%ld/%ld\r\n\r\n", RANGE_BOUNDARY, 
+                      type_line, ranges[i].first, ranges[i].last, reader->object_length) + ranges[i].last - ranges[i].first + 1;
+  n += sprintf(buf + n, "Content-Type: multipart/byteranges; boundary=%s\r\nContent-Length: %ld\r\n\r\n", RANGE_BOUNDARY, total);
+  Rio_writen(clientfd, buf, n);
+
+  for (int i = 0; i < count; i++) {
+    n = snprintf(part, MAXLINE + 128, "\r\n--%s\r\n%sContent-Range: bytes %ld-%ld/%ld\r\n\r\n", RANGE_BOUNDARY, 
+                 type_line, ranges[i].first, ranges[i].last, reader->object_length);
+    Rio_writen(clientfd, part, n);
+    if (stream_from_reader(req->conn, clientfd, reader, ranges[i].first, ranges[i].last - ranges[i].first + 1) < 0)
+      break;
+  }
+  Rio_writen(clientfd, "\r\n--" RANGE_BOUNDARY "--\r\n", strlen("\r\n--" RANGE_BOUNDARY "--\r\n"));
+  cache_stream_close(g_shared_cache, reader);
+  return 1;
+}
+
+/**
+ * range_fill_thread - Range 미스 뒤에 객체 전체를 오리진에서 받아 캐시를 채우는 백그라운드 스레드
+ * 클라이언트 연결과 상관없이 끝까지 받아서 다음 Seek부터는 캐시 히트가 되게 함.
+ */
+static void *range_fill_thread(void *void_arg_p) {
+  range_fill_arg_t *arg = void_arg_p;
+  http_request_t *req = arg->req;
+  int serverfd;
+  conn_t conn; // 사본의 conn은 클라이언트 스레드 것 ==> 자기 것으로 (클라이언트 없음, 전체 제한 없음)
+
+  pthread_detach(pthread_self());
+
+  serverfd = resolver_open_clientfd(req->hostname, req->port);
+  if (serverfd < 0) {
+    cache_put_connect_failure(g_shared_cache, req->hostname, req->port);
+  } else {
+    conn_init(&conn, -1);
+    conn_set_server(&conn, serverfd);
+    conn_timeout(&conn, "fill first byte", g_timeouts.first_byte_ms, 1);
+    req->conn = &conn;
+    send_origin_request(serverfd, req, "");
+    relay_response(-1, serverfd, req, 1);
+    conn_finish(&conn);
+    Close(serverfd);
+  }
+
+  pthread_mutex_lock(&g_range_fills.lock);
+  for (range_fill_arg_t **p = &g_range_fills.head; *p; p = &(*p)->next) {
+    if (*p == arg) {
+      *p = arg->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&g_range_fills.lock);
+  Free(arg);
+  arena_release(req->arena); // req도 같이
+  return NULL;
+}
+
+/**
+ * start_range_fill - 객체 전체를 받는 백그라운드 채우기를 띄움 (기다리지 않음).
+ * 같은 키를 이미 채우는 중이면 아무것도 안 함 ==> Seek가 몰려도 오리진에서 전체를 받는 건 한 번.
+ */
+static void start_range_fill(http_request_t *req) {
+  range_fill_arg_t *arg;
+  arena_t *arena;
+  pthread_t tid;
+
+  pthread_mutex_lock(&g_range_fills.lock);
+  for (arg = g_range_fills.head; arg; arg = arg->next)
+    if (strcmp(arg->req->cache_key, req->cache_key) == 0)
+      break;
+  if (arg) {
+    pthread_mutex_unlock(&g_range_fills.lock);
+    return;
+  }
+  arena = arena_acquire(); // 클라이언트 요청보다 오래 삶 ==> 자기 아레나
+  arg = Malloc(sizeof(range_fill_arg_t));
+  arg->req = arena_alloc(arena, sizeof(http_request_t));
+  memcpy(arg->req, req, sizeof(http_request_t));
+  arg->req->arena = arena;
+  arg->next = g_range_fills.head;
+  g_range_fills.head = arg;
+  pthread_mutex_unlock(&g_range_fills.lock);
+
+  if (pthread_create(&tid, NULL, range_fill_thread, arg) != 0) {
+    pthread_mutex_lock(&g_range_fills.lock);
+    for (range_fill_arg_t **p = &g_range_fills.head; *p; p = &(*p)->next) {
+      if (*p == arg) {
+        *p = arg->next;
+        break;
+      }
+    }
+    pthread_mutex_unlock(&g_range_fills.lock);
+    arena_release(arena);
+    Free(arg);
+  }
+}
+
+void handle_http_request(int clientfd, http_request_t *req) {
+  /**
+    1. Open_clientfd(hostname, port)
+    2. write(서버에 요청 라인 + 헤더)
+    3. read(서버 응답)
+    4. write(응답을 clientfd로 전달)
+    5. Close(serverfd)
+   */
+  int serverfd;
+  int cacheable = 1;
+  int range_miss = 0;
+  long object_length;
+  char *range_val = arena_alloc(req->arena, MAXLINE); // 요청 경로의 큰 버퍼는 전부 아레나에 ==> 코루틴 스택은 작게
+
+  // Range 요청은 캐시된 객체(또는 지금 채우는 중인 객체)에서 잘라서 응답.
+  // 미스면 Range 그대로 오리진에 전달하고, 응답으로 알게 된 전체 크기가 캐시할 수 있는 크기일 때만 전체를 백그라운드로 채움
+  if (!strcasecmp(REQ_METHOD(req), "GET") && http_find_header(&req->head, HTTP_HDR_RANGE, range_val, MAXLINE)) {
+    size_t mark = arena_mark(req->arena);
+    if (serve_range_from_cache(clientfd, req, range_val))
+      return;  // Range 캐시 히트
+    arena_reset_to(req->arena, mark); // 미스면 헤더 조립 버퍼 자리를 relay_response가 다시 씀
+    cacheable = 0;
+    range_miss = 1;
+  }
+
+  // 캐시 있을 때 - 헤더 + 본문을 캐시 메모리에서 바로 (작은 객체는 writev 한 번, 큰 객체는 sendfile)
+  // 다른 요청이 지금 오리진에서 받고 있는 객체도 여기서 채워지는 대로 따라 읽음
+  cache_reader_t *reader = cacheable ? cache_open_stream(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), 0) : NULL;
+  if (reader) {
+    cache_stream_send_response(g_shared_cache, reader, clientfd);
+    cache_stream_close(g_shared_cache, reader);
+    return;  // 캐시 히트! 얼리 리턴.
+  }
+
+  // 압축 보관된 객체는 gzip 그대로 또는 풀어서 버퍼로 받아 보냄
+  if (cacheable) {
+    int cached_size;
+    size_t mark = arena_mark(req->arena);
+    char *cached_buf = arena_alloc(req->arena, MAX_OBJECT_SIZE);
+    int hit = cache_get(g_shared_cache, req->cache_key, REQ_HEADERS(req), REQ_HEADERS_LEN(req), cached_buf, &cached_size);
+    if (hit)
+      Rio_writen(clientfd, cached_buf, cached_size);
+    arena_reset_to(req->arena, mark); // 미스면 이 자리를 relay_response 버퍼가 다시 씀
+    if (hit)
+      return;  // 압축본 캐시 히트
+  }
+  // 아래부터는 전부 캐시 없을 때
+
+  // 최근에 연결 실패한 오리진이면 connect 시도 없이 바로 502 (네거티브 캐시)
+  if (cache_connect_failed(g_shared_cache, req->hostname, req->port)) {
+    clienterror(clientfd, req->hostname, "502", "Bad Gateway", "Origin server recently unreachable");
+    return;
+  }
+
+  // Open_clientfd()는 실패 시 프로세스를 종료시키므로 소문자 버전 사용 (이름 조회는 리졸버 캐시에서)
+  serverfd = resolver_open_clientfd(req->hostname, req->port);
+  if (serverfd < 0) {
+    cache_put_connect_failure(g_shared_cache, req->hostname, req->port);
+    clienterror(clientfd, req->hostname, "502", "Bad Gateway", "Proxy couldn't connect to origin server");
+    return;
+  }
+  
+  // http://httpforever.com/js/init.min.js, httpforever.com, 80, /js/init.min.js
+  // printf("%s, %s, %s, %s\n",REQ_URI(req), req->hostname, req->port, REQ_PATH(req));
+
+  // 응답 첫 바이트까지는 오리진 쪽만 끊음 ==> relay_response가 클라이언트에 504
+  conn_set_server(req->conn, serverfd);
+  conn_timeout(req->conn, "first byte", g_timeouts.first_byte_ms, 0);
+  send_origin_request(serverfd, req, NULL);
+
+  // 아래부터는 서버로부터의 리스폰스를 클라이언트에 전달 & 캐시 저장
+  object_length = relay_response(clientfd, serverfd, req, cacheable);
+
+  conn_set_server(req->conn, -1);
   Close(serverfd);
+  if (range_miss && object_length >= 0 && object_length <= MAX_STREAM_OBJECT_SIZE)
+    start_range_fill(req);
 }
 
 /**
@@ -235,11 +1157,12 @@ void handle_http_request(int clientfd, http_request_t *req) {
 /* strstr(): strstr() 함수는 string1에서 string2의 첫 번째 표시를 찾습니다. 
       함수는 일치 프로세스에서 string2로 끝나는 NULL자(\0)를 무시합니다. 
 */
-int parse_uri(char* uri, char* hostname, char* port, char* path) {
+int parse_uri(char* uri, char* hostname, char* port, char** path) {
   char* host_p;
   char* path_p;
   char* port_p;
   char hostport[HOSTPORT_LEN]; // hostname+port 임시 저장
+  size_t len;
 
   // http:// 접두어 확인
   if (strncasecmp(uri, "http://", 7) != 0)
@@ -247,28 +1170,22 @@ int parse_uri(char* uri, char* hostname, char* port, char* path) {
 
   host_p = uri + 7;  // "http://" 이후부터
 
-  // path 위치 찾기
+  // path 위치 찾기 - 복사하지 않고 uri 안을 가리킴 ("/foo/bar.html")
   path_p = strchr(host_p, '/');
-  if (path_p != NULL) { // strchr() 결과가 NULL일 수 있으므로
-    strcpy(path, path_p);   // "/foo/bar.html"
-    
-    size_t len = path_p - host_p; // hostname:port만 남기기 위해 임시로 NULL 종결
-
-    if (len >= SHORT_CHARS) 
-      return 0;  // 길이 초과 방지
+  *path = path_p; // http://example.com 같은 형태면 NULL ==> "/"
+  len = path_p != NULL ? (size_t)(path_p - host_p) : strlen(host_p);
+  if (len >= HOSTPORT_LEN) 
+    return 0;  // 길이 초과 방지
 
-    memcpy(hostport, host_p, len);
-    hostport[len] = '\0';
-
-  } else { // http://example.com 같은 형태
-    strcpy(path, "/"); 
-    strcpy(hostport, host_p); 
-  }
+  memcpy(hostport, host_p, len); // hostname:port만 남기기 위해 임시로 NULL 종결
+  hostport[len] = '\0';
 
   // 포트 파싱
   port_p = strchr(hostport, ':');
   if (port_p != NULL) {
     *(char*) port_p = '\0';  // hostname 분리
+    if (strlen(port_p + 1) >= SHORT_CHARS)
+      return 0;
     strcpy(hostname, hostport);
     strcpy(port, port_p + 1);
   } else {
@@ -280,7 +1197,8 @@ int parse_uri(char* uri, char* hostname, char* port, char* path) {
 }
 
 void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longmsg ){
-  char buf[MAXLINE], body[MAXBUF];
+  char body[MAXBUF];
+  wio_t wio;
   
   // HTTP response body를 만듦
   /* 이때, printf vs. fprintf vs. sprintf?
@@ -292,12 +1210,24 @@ void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longms
   sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
   sprintf(body, "%s<hr><em>Gabe_s web proxy server</em>\r\n", body);
 
-  /* Print the HTTP response */
+  /* Print the HTTP response - 헤더와 본문을 쓰기 버퍼에 모았다가 한 번에 */
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
+  Wio_printfb(&wio, "Content-type: text/html\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n\r\n", (int)strlen(body));
+  Wio_writeb(&wio, body, strlen(body));
+  Wio_flushb(&wio); // 클라이언트의 소켓에 전송. 클라이언트는 여기서부터 실제 HTML 콘텐츠를 렌더링하게 됨.
+}
+
+/**
+ * send_plain_response - text/plain 본문을 가진 짧은 응답 (관리 요청 결과 등)
+ */
+void send_plain_response(int fd, char* errnum, char* shortmsg, char* body){
+  char buf[MAXLINE];
+
   sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf)); // 클라이언트의 소켓에 전송. 클라이언트는 여기서부터 실제 HTML 콘텐츠를 렌더링하게 됨.
-  sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
+  sprintf(buf + strlen(buf), "Content-type: text/plain\r\n");
+  sprintf(buf + strlen(buf), "Content-length: %d\r\n\r\n", (int)strlen(body));
   Rio_writen(fd, buf, strlen(buf));
   Rio_writen(fd, body, strlen(body));
 }
@@ -306,23 +1236,41 @@ void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longms
  * 터널링: 클라이언트 - 프록시 - 오리진 서버 (양방향 TCP 패스쓰루) 
  * UDP는 나도 모르겠다.
  */
-void tunnel_relay(int clientfd, char *hostname, char *port){
+void tunnel_relay(int clientfd, char *hostname, char *port, conn_t *conn){
     int serverfd;
     int maxfd;
     fd_set readset;
     ssize_t n;
     char buf[MAXBUF];
 
-    /* 오리진 서버로 TCP 연결 */
-    if ((serverfd = Open_clientfd(hostname, port)) < 0) {
+    /* 오리진 서버로 TCP 연결 - 최근 실패한 오리진이면 바로 502 */
+    if (cache_connect_failed(g_shared_cache, hostname, port)) {
+      clienterror(clientfd, hostname, "502", "Bad Gateway", "Origin server recently unreachable");
+      return;
+    }
+    if ((serverfd = resolver_open_clientfd(hostname, port)) < 0) {
+      cache_put_connect_failure(g_shared_cache, hostname, port);
       clienterror(clientfd, hostname, "502", "Bad Gateway", "Unable to connect to the origin server");
       return;
     }
     
+    /* 터널은 오래 열려 있는 게 정상 ==> 전체 제한 대신 (긴) 유휴 타임아웃만 */
+    timer_cancel(&conn->deadline);
+    conn_set_server(conn, serverfd);
+    conn_timeout(conn, "tunnel idle", g_timeouts.tunnel_idle_ms, 1);
+
     /* 여기서 200 OK 응답을 먼저 클라이언트에게 보내야 함 */
     const char *okmsg = "HTTP/1.0 200 Connection Established\r\n\r\n";
     Rio_writen(clientfd, (void*) okmsg, strlen(okmsg));
-    
+
+    /* 릴레이 스레드로 넘기고 이 스레드는 끝남 (이후 두 fd는 릴레이 스레드가 닫음) */
+    conn_set_server(conn, -1);
+    conn_set_client(conn, -1); // 넘긴 뒤에는 이 연결의 타이머가 (재사용됐을 수도 있는) fd 번호를 끊지 않게
+    if (tunnel_submit(clientfd, serverfd, g_timeouts.tunnel_idle_ms) == 0)
+      return;
+    conn_set_client(conn, clientfd); // 릴레이 스레드가 없음 ==> 예전처럼 이 스레드가 select로 중계
+    conn_set_server(conn, serverfd);
+
     /* 양쪽 소켓을 select()로 감시하며 한쪽에서 읽어 다른쪽으로 */
     maxfd = (clientfd > serverfd ? clientfd : serverfd) + 1;
 
@@ -340,6 +1288,7 @@ void tunnel_relay(int clientfd, char *hostname, char *port){
         if (n <= 0) 
           break;        /* EOF 또는 에러 → 터널 닫기 */
         Rio_writen(serverfd, buf, n);
+        conn_timeout(conn, "tunnel idle", g_timeouts.tunnel_idle_ms, 1);
       }
 
       /* 오리진 서버로부터 데이터 도착 */
@@ -348,53 +1297,12 @@ void tunnel_relay(int clientfd, char *hostname, char *port){
         if (n <= 0)
           break;        /* EOF 또는 에러 → 터널 닫기 */
         Rio_writen(clientfd, buf, n);
+        conn_timeout(conn, "tunnel idle", g_timeouts.tunnel_idle_ms, 1);
       }
     }
 
+    conn_set_server(conn, -1);
     Close(serverfd);
 }
 
 
-// 폐기
-void client_handler_stack_version(int connfd){
-  rio_t client_rio;
-  char buf[MAXLINE], line[MAXLINE];
-  http_request_t req;
-
-  Rio_readinitb(&client_rio, connfd);
-
-  // 요청 라인 읽기
-  if (Rio_readlineb(&client_rio, buf, MAXLINE) <= 0)  // EOF면 연결 정리 
-    return;
-  sscanf(buf, "%s %s %s", req.method, req.uri, req.version);
-
-  // CONNECT일 경우 터널링 (양방향 TCP 패스쓰루)
-  if (!strcasecmp(req.method, "CONNECT")) {
-    char *colon = strchr(req.uri, ':');
-    if (colon) {
-      *colon = '\0';
-      strcpy(req.hostname, req.uri);
-      strcpy(req.port, colon + 1);
-    } else {
-      strcpy(req.hostname, req.uri);
-      strcpy(req.port, "443");
-    }
-    tunnel_relay(connfd, req.hostname, req.port);
-    return;
-  }
-
-  // 일반 HTTP 요청 처리 
-  if (!parse_uri(req.uri, req.hostname, req.port, req.path)) {
-    clienterror(connfd, req.uri, "400", "Bad Request", "URI 파싱 실패");
-    return;
-  }
-
-  // 나머지 헤더 수집 
-  req.header_count = 0;
-  while (Rio_readlineb(&client_rio, line, MAXLINE) > 0) {
-    if (!strcmp(line, "\r\n")) break;
-    if (req.header_count < MAX_HEADERS)
-      strcpy(req.headers[req.header_count++], line);
-  }
-  handle_http_request(connfd, &req);
-}
\ No newline at end of file
@@ -0,0 +1,571 @@
+/**
+ * resolver.c - 오리진 이름 조회(getaddrinfo) 결과를 프로세스 전체가 공유하는 TTL 캐시
+ *   - 성공은 RESOLVER_POSITIVE_TTL, 실패(없는 이름 등)는 RESOLVER_NEGATIVE_TTL 동안 기억
+ *   - 같은 이름을 동시에 조회하면 한 번만 getaddrinfo (나머지는 결과를 기다림)
+ *   - 이벤트 루프용 비블로킹 경로: 조회는 분리된 스레드가 하고 끝나면 notify_fd로 알림
+ *   - 연결은 비블로킹 connect를 시차를 두고 여러 주소로 경쟁 (Happy Eyeballs, RFC 8305) + 타임아웃
+ */
+#include "resolver.h"
+#include "sockopt.h"
+#include "coro.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+typedef struct resolver_waiter {
+    struct resolver_waiter* next;
+    int notify_fd;
+} resolver_waiter_t;
+
+typedef struct resolver_entry {
+    struct resolver_entry* next; // 버킷 체인
+    char key[RESOLVER_KEY_LEN]; // "host:port"
+    int pending; // 조회 중 - 아래 결과 필드는 아직 무효, 퇴출 대상 아님
+    int error; // 0 또는 EAI_* (네거티브 엔트리)
+    int unread_errors; // 이름과 무관한 실패(EAI_SYSTEM 등)를 아직 못 읽은 비동기 대기자 수 - 다 읽으면 엔트리를 지움
+    resolver_result_t result;
+    time_t expires_at;
+    resolver_waiter_t* waiters; // 비블로킹 경로의 대기자들 (조회가 끝나면 알리고 비움)
+} resolver_entry_t;
+
+// 비블로킹 경로의 조회 스레드 인자
+typedef struct {
+    resolver_entry_t* entry;
+    char hostname[RESOLVER_KEY_LEN];
+    char port[NI_MAXSERV];
+} resolve_arg_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done; // 어떤 조회든 끝나면 broadcast ==> 블로킹 대기자가 자기 엔트리를 다시 확인
+    resolver_entry_t* buckets[RESOLVER_BUCKETS];
+    int count;
+
+    // 통계 (lock 아래에서 갱신)
+    unsigned long hits;
+    unsigned long negative_hits;
+    unsigned long lookups; // 실제 getaddrinfo 호출 수
+    unsigned long coalesced; // 진행 중인 조회에 합류한 횟수
+    unsigned long lookup_ns; // getaddrinfo에 쓴 총 시간
+    unsigned long fallback_wins; // 첫 주소가 아닌 주소로 연결된 횟수
+    unsigned long connect_timeouts;
+} resolver = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static int connect_timeout_ms = RESOLVER_CONNECT_TIMEOUT_MS;
+
+/**
+ * now_sec - 단조 증가 시계 기준 현재 시각 (초). 만료 판정 전용.
+ */
+static time_t now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static unsigned long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static long now_ms(void) {
+    return now_ns() / 1000000;
+}
+
+static unsigned key_hash(const char* key) {
+    unsigned long hash = 5381;
+    for (int c = *key++; c != '\0'; c = *key++)
+        hash = ((hash << 5) + hash) + tolower(c);
+    return hash % RESOLVER_BUCKETS;
+}
+
+/**
+ * make_key - "host:port" (호스트 이름은 대소문자 무시하므로 소문자로)
+ */
+static void make_key(char* key, const char* hostname, const char* port) {
+    int n = snprintf(key, RESOLVER_KEY_LEN, "%s:%s", hostname, port);
+    if (n >= RESOLVER_KEY_LEN)
+        n = RESOLVER_KEY_LEN - 1;
+    for (int i = 0; i < n; ++i)
+        key[i] = tolower((unsigned char)key[i]);
+}
+
+/* 이하 _unmanaged 함수는 resolver.lock을 잡은 상태에서만 호출 */
+
+static resolver_entry_t* find_unmanaged(const char* key) {
+    for (resolver_entry_t* e = resolver.buckets[key_hash(key)]; e; e = e->next)
+        if (strcmp(e->key, key) == 0)
+            return e;
+    return NULL;
+}
+
+static void unlink_unmanaged(resolver_entry_t* victim) {
+    resolver_entry_t** pp = &resolver.buckets[key_hash(victim->key)];
+    while (*pp != victim)
+        pp = &(*pp)->next;
+    *pp = victim->next;
+    Free(victim);
+    --resolver.count;
+}
+
+/**
+ * evict_unmanaged - 자리를 하나 만듦: 만료된 엔트리를 모두 치우고, 없으면 가장 빨리 만료될 엔트리 하나를 퇴출
+ * 조회 중인(pending) 엔트리는 대기자가 포인터를 들고 있으므로 건드리지 않음.
+ */
+static void evict_unmanaged(void) {
+    time_t now = now_sec();
+    resolver_entry_t* oldest = NULL;
+
+    for (int b = 0; b < RESOLVER_BUCKETS; ++b) {
+        resolver_entry_t* e = resolver.buckets[b];
+        while (e) {
+            resolver_entry_t* next = e->next;
+            if (!e->pending) {
+                if (e->expires_at <= now)
+                    unlink_unmanaged(e);
+                else if (!oldest || e->expires_at < oldest->expires_at)
+                    oldest = e;
+            }
+            e = next;
+        }
+    }
+    if (resolver.count >= RESOLVER_MAX_ENTRIES && oldest)
+        unlink_unmanaged(oldest);
+}
+
+/**
+ * begin_unmanaged - key의 엔트리를 조회 중(pending) 상태로 (만료된 엔트리가 있으면 재사용)
+ */
+static resolver_entry_t* begin_unmanaged(resolver_entry_t* e, const char* key) {
+    if (e == NULL) {
+        if (resolver.count >= RESOLVER_MAX_ENTRIES)
+            evict_unmanaged();
+        e = Malloc(sizeof(resolver_entry_t));
+        strcpy(e->key, key);
+        e->waiters = NULL;
+        unsigned h = key_hash(key);
+        e->next = resolver.buckets[h];
+        resolver.buckets[h] = e;
+        ++resolver.count;
+    }
+    e->pending = 1;
+    e->unread_errors = 0;
+    return e;
+}
+
+/**
+ * lookup_fresh_unmanaged - 유효한 (조회 중도 만료도 아닌) 엔트리면 결과를 복사
+ * @param count_hit: 히트 통계에 넣을지 (진행 중이던 조회를 기다려 받은 결과면 0)
+ * @return 1 캐시 히트 (*rc에 0 또는 EAI_*), 0 미스
+ */
+static int lookup_fresh_unmanaged(resolver_entry_t* e, resolver_result_t* out, int* rc, int count_hit) {
+    if (e == NULL || e->pending || e->expires_at <= now_sec())
+        return 0;
+    if (count_hit) {
+        ++resolver.hits;
+        resolver.negative_hits += e->error != 0;
+    }
+    if (e->error) {
+        out->count = 0;
+    } else {
+        *out = e->result;
+    }
+    *rc = e->error;
+    return 1;
+}
+
+/**
+ * finish_unmanaged - 조회 결과를 엔트리에 기록하고 기다리던 쪽을 모두 깨움
+ * @return 알림을 보낸 비동기 대기자 수
+ */
+static int finish_unmanaged(resolver_entry_t* e, int rc, const resolver_result_t* result, unsigned long elapsed_ns) {
+    static const uint64_t one = 1;
+    int notified = 0;
+
+    e->error = rc;
+    e->result = *result;
+    e->expires_at = now_sec() + (rc ? RESOLVER_NEGATIVE_TTL : RESOLVER_POSITIVE_TTL);
+    e->pending = 0;
+    ++resolver.lookups;
+    resolver.lookup_ns += elapsed_ns;
+
+    while (e->waiters) {
+        resolver_waiter_t* w = e->waiters;
+        e->waiters = w->next;
+        if (write(w->notify_fd, &one, sizeof(one)) < 0) // eventfd든 파이프든 읽힐 수 있게만 되면 됨
+            fprintf(stderr, "resolver: notify failed: %s\n", strerror(errno));
+        Free(w);
+        ++notified;
+    }
+    pthread_cond_broadcast(&resolver.done);
+    return notified;
+}
+
+/**
+ * do_getaddrinfo - 실제 조회 (락 밖에서). open_clientfd와 같은 hints.
+ * 메모리 부족 같은 이름과 무관한 실패는 네거티브로 남기지 않도록 EAI_SYSTEM/EAI_MEMORY 그대로 돌려줌.
+ */
+static int do_getaddrinfo(const char* hostname, const char* port, resolver_result_t* out) {
+    struct addrinfo hints, *listp, *p;
+    int rc;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    out->count = 0;
+    if ((rc = getaddrinfo(hostname, port, &hints, &listp)) != 0) {
+        fprintf(stderr, "getaddrinfo failed (%s:%s): %s\n", hostname, port, gai_strerror(rc));
+        return rc;
+    }
+    for (p = listp; p && out->count < RESOLVER_MAX_ADDRS; p = p->ai_next) {
+        resolver_addr_t* a = &out->addrs[out->count++];
+        a->family = p->ai_family;
+        a->socktype = p->ai_socktype;
+        a->protocol = p->ai_protocol;
+        a->addrlen = p->ai_addrlen;
+        memcpy(&a->addr, p->ai_addr, p->ai_addrlen);
+    }
+    freeaddrinfo(listp);
+    return 0;
+}
+
+/**
+ * resolve_and_finish - 조회 중으로 표시해 둔 엔트리를 실제로 채움 (락 밖에서 호출)
+ * 이름과 무관한 실패면 캐시하지 않음 ==> 다음 요청이 다시 조회. 단 알림을 받은 비동기 대기자는 다시 불렀을 때
+ * 이 실패를 받아야 하므로 (안 그러면 또 RESOLVER_PENDING ==> 이벤트 루프가 끝없이 재조회) 그들이 다 읽을 때까지
+ * 이미 만료된 엔트리로 남겨 둠.
+ */
+static int resolve_and_finish(resolver_entry_t* e, const char* hostname, const char* port, resolver_result_t* out) {
+    resolver_result_t result;
+    unsigned long start = now_ns();
+    int rc = do_getaddrinfo(hostname, port, &result);
+    unsigned long elapsed = now_ns() - start;
+
+    pthread_mutex_lock(&resolver.lock);
+    int notified = finish_unmanaged(e, rc, &result, elapsed);
+    if (rc == EAI_SYSTEM || rc == EAI_MEMORY) {
+        if ((e->unread_errors = notified) == 0)
+            unlink_unmanaged(e);
+        else
+            e->expires_at = now_sec(); // 블로킹 조회와 새 비동기 조회에는 이미 만료 ==> 다시 조회
+    }
+    pthread_mutex_unlock(&resolver.lock);
+    if (out)
+        *out = result;
+    return rc;
+}
+
+/**
+ * resolver_lookup - host:port의 주소들 (블로킹). 캐시에 있으면 바로, 누가 조회 중이면 그 결과를 기다림.
+ * @return 0 성공, EAI_* 실패 (getaddrinfo와 같음)
+ */
+int resolver_lookup(const char* hostname, const char* port, resolver_result_t* out) {
+    char key[RESOLVER_KEY_LEN];
+    resolver_entry_t* e;
+    int rc, waited = 0;
+
+    make_key(key, hostname, port);
+    pthread_mutex_lock(&resolver.lock);
+    while ((e = find_unmanaged(key)) && e->pending) {
+        if (!waited++)
+            ++resolver.coalesced;
+        pthread_cond_wait(&resolver.done, &resolver.lock);
+    }
+    if (lookup_fresh_unmanaged(e, out, &rc, !waited)) {
+        pthread_mutex_unlock(&resolver.lock);
+        return rc;
+    }
+    e = begin_unmanaged(e, key);
+    pthread_mutex_unlock(&resolver.lock);
+
+    return resolve_and_finish(e, hostname, port, out);
+}
+
+static void* resolve_thread(void* void_arg_p) {
+    resolve_arg_t* arg = void_arg_p;
+
+    pthread_detach(pthread_self());
+    resolve_and_finish(arg->entry, arg->hostname, arg->port, NULL);
+    Free(arg);
+    return NULL;
+}
+
+/**
+ * resolver_lookup_async - 블로킹하지 않는 조회 (이벤트 루프용)
+ * 캐시에 있으면 바로 결과를 주고, 없으면 조회를 (이미 진행 중이 아니면) 분리된 스레드로 띄움.
+ * 조회가 끝나면 notify_fd에 8바이트(eventfd 카운터 1)를 씀 ==> 읽을 수 있게 되면 다시 호출하면 히트.
+ * 이름과 무관한 실패(EAI_SYSTEM/EAI_MEMORY)는 캐시하지 않지만 알림을 받은 대기자마다 한 번씩은 그대로 돌려줌.
+ * notify_fd는 알림이 올 때까지 닫으면 안 됨.
+ *
+ * @return 0 성공, EAI_* 실패, RESOLVER_PENDING 조회 중
+ */
+int resolver_lookup_async(const char* hostname, const char* port, resolver_result_t* out, int notify_fd) {
+    char key[RESOLVER_KEY_LEN];
+    resolver_entry_t* e;
+    int rc;
+
+    make_key(key, hostname, port);
+    pthread_mutex_lock(&resolver.lock);
+    e = find_unmanaged(key);
+    if (e && !e->pending && e->unread_errors > 0) { // 알림을 받은 대기자가 실패를 가져감
+        rc = e->error;
+        out->count = 0;
+        if (--e->unread_errors == 0)
+            unlink_unmanaged(e);
+        pthread_mutex_unlock(&resolver.lock);
+        return rc;
+    }
+    if (lookup_fresh_unmanaged(e, out, &rc, 1)) {
+        pthread_mutex_unlock(&resolver.lock);
+        return rc;
+    }
+
+    resolver_waiter_t* w = Malloc(sizeof(resolver_waiter_t));
+    w->notify_fd = notify_fd;
+    if (e && e->pending) {
+        ++resolver.coalesced;
+    } else {
+        resolve_arg_t* arg = Malloc(sizeof(resolve_arg_t));
+        pthread_t tid;
+
+        e = begin_unmanaged(e, key);
+        arg->entry = e;
+        snprintf(arg->hostname, sizeof(arg->hostname), "%s", hostname);
+        snprintf(arg->port, sizeof(arg->port), "%s", port);
+        if ((rc = pthread_create(&tid, NULL, resolve_thread, arg)) != 0) {
+            pthread_mutex_unlock(&resolver.lock);
+            Free(arg);
+            Free(w);
+            return resolve_and_finish(e, hostname, port, out); // 스레드를 못 띄우면 그냥 여기서 조회
+        }
+    }
+    w->next = e->waiters;
+    e->waiters = w;
+    pthread_mutex_unlock(&resolver.lock);
+    return RESOLVER_PENDING;
+}
+
+/**
+ * resolver_forget - host:port의 캐시된 결과를 버림 (모든 주소로 연결이 실패했을 때 - 주소가 바뀌었을 수 있음)
+ */
+void resolver_forget(const char* hostname, const char* port) {
+    char key[RESOLVER_KEY_LEN];
+    resolver_entry_t* e;
+
+    make_key(key, hostname, port);
+    pthread_mutex_lock(&resolver.lock);
+    if ((e = find_unmanaged(key)) && !e->pending)
+        unlink_unmanaged(e);
+    pthread_mutex_unlock(&resolver.lock);
+}
+
+/**
+ * resolver_set_connect_timeout - resolver_connect 전체 제한 시간 (밀리초, 0 이하면 기본값)
+ */
+void resolver_set_connect_timeout(int timeout_ms) {
+    connect_timeout_ms = timeout_ms > 0 ? timeout_ms : RESOLVER_CONNECT_TIMEOUT_MS;
+}
+
+/**
+ * interleave_families - 시도 순서: getaddrinfo 순서(RFC 6724)를 지키되 주소 패밀리를 번갈아 (RFC 8305 4절)
+ * 한 패밀리 경로가 통째로 죽어 있어도 두 번째 시도는 다른 패밀리로 감.
+ */
+static int interleave_families(const resolver_result_t* res, const resolver_addr_t** order) {
+    int used[RESOLVER_MAX_ADDRS] = {0};
+    int n = 0, want = res->count ? res->addrs[0].family : AF_UNSPEC;
+
+    while (n < res->count) {
+        int i, pick = -1;
+        for (i = 0; i < res->count; ++i) {
+            if (used[i])
+                continue;
+            if (pick < 0)
+                pick = i; // 원하는 패밀리가 더 없으면 남은 것 중 첫 번째
+            if (res->addrs[i].family == want) {
+                pick = i;
+                break;
+            }
+        }
+        used[pick] = 1;
+        order[n++] = &res->addrs[pick];
+        want = res->addrs[pick].family == AF_INET6 ? AF_INET : AF_INET6;
+    }
+    return n;
+}
+
+/**
+ * start_attempt - 비블로킹 소켓을 만들어 connect 시작
+ * @return 소켓 (*done이 1이면 이미 연결됨), 바로 실패하면 -1
+ */
+static int start_attempt(const resolver_addr_t* a, int* done) {
+    int fd = socket(a->family, a->socktype | SOCK_NONBLOCK, a->protocol);
+
+    *done = 0;
+    if (fd < 0)
+        return -1;
+    sockopt_apply_origin(fd);
+    if (connect(fd, (const SA*)&a->addr, a->addrlen) == 0) {
+        *done = 1; // 루프백 등에서는 바로 끝나기도 함
+        return fd;
+    }
+    if (errno == EINPROGRESS)
+        return fd;
+    close(fd);
+    return -1;
+}
+
+/**
+ * resolver_connect - 조회된 주소들로 연결 (Happy Eyeballs)
+ * 블로킹 connect로 하나씩 시도하면 응답 없는(블랙홀) 주소 하나에 커널 SYN 타임아웃(수 분)만큼 묶이므로,
+ * 비블로킹 connect를 RESOLVER_ATTEMPT_DELAY_MS 간격으로 하나씩 더 띄우며 먼저 성공한 것을 씀.
+ * 어떤 시도가 실패로 끝나면 간격을 기다리지 않고 바로 다음 주소를 띄움. 나머지는 닫음.
+ * 전체가 connect_timeout_ms를 넘으면 포기 (errno = ETIMEDOUT).
+ *
+ * @return 블로킹 모드로 되돌린 연결된 소켓, 실패 시 -1 (errno)
+ */
+int resolver_connect(const resolver_result_t* res) {
+    const resolver_addr_t* order[RESOLVER_MAX_ADDRS];
+    struct pollfd pfds[RESOLVER_MAX_ADDRS];
+    int idx[RESOLVER_MAX_ADDRS]; // pfds[k]가 몇 번째 시도인지
+    int count = interleave_families(res, order);
+    int started = 0, active = 0, winner = -1, win_idx = -1, last_err = ECONNREFUSED;
+    long deadline = now_ms() + connect_timeout_ms;
+    long next_start = 0; // 다음 시도를 띄울 수 있는 시각 (0이면 바로)
+
+    while (winner < 0) {
+        long now = now_ms();
+
+        if (started < count && now >= next_start) {
+            int done, fd = start_attempt(order[started], &done);
+            if (fd >= 0 && done) {
+                winner = fd;
+                win_idx = started++;
+                break;
+            }
+            if (fd < 0) {
+                last_err = errno;
+            } else {
+                pfds[active].fd = fd;
+                pfds[active].events = POLLOUT;
+                idx[active++] = started;
+            }
+            ++started;
+            next_start = fd < 0 ? 0 : now + RESOLVER_ATTEMPT_DELAY_MS;
+            continue;
+        }
+        if (active == 0 && started == count)
+            break; // 전부 실패
+        if (now >= deadline) {
+            last_err = ETIMEDOUT;
+            pthread_mutex_lock(&resolver.lock);
+            ++resolver.connect_timeouts;
+            pthread_mutex_unlock(&resolver.lock);
+            break;
+        }
+
+        long wait = deadline - now;
+        if (started < count && next_start - now < wait)
+            wait = next_start - now;
+        if (poll(pfds, active, wait) < 0 && errno != EINTR) {
+            last_err = errno;
+            break;
+        }
+
+        for (int k = 0; k < active; ++k) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (pfds[k].revents == 0)
+                continue;
+            if (getsockopt(pfds[k].fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                err = errno;
+            if (err == 0 && winner < 0) {
+                winner = pfds[k].fd;
+                win_idx = idx[k];
+            } else {
+                if (err)
+                    last_err = err;
+                close(pfds[k].fd);
+                next_start = 0; // 실패했으니 다음 주소를 바로
+            }
+            pfds[k] = pfds[--active]; // 마지막 것을 당겨옴 ==> 같은 k를 다시 봄
+            idx[k] = idx[active];
+            --k;
+        }
+    }
+
+    for (int k = 0; k < active; ++k)
+        close(pfds[k].fd);
+    if (winner < 0) {
+        errno = last_err;
+        return -1;
+    }
+    if (win_idx > 0) {
+        pthread_mutex_lock(&resolver.lock);
+        ++resolver.fallback_wins;
+        pthread_mutex_unlock(&resolver.lock);
+    }
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL) & ~O_NONBLOCK); // 이후 rio는 블로킹 I/O
+    return winner;
+}
+
+/**
+ * lookup_for_connect - 연결 전 조회. 코루틴 안에서는 getaddrinfo를 조회 스레드에 맡기고 eventfd를 poll로 기다림
+ *   (가로챈 poll이 양보 ==> 캐시 미스 동안에도 같은 스케줄러의 다른 코루틴이 돎). 그 밖에서는 블로킹 조회.
+ * @return resolver_lookup과 같음
+ */
+static int lookup_for_connect(const char* hostname, const char* port, resolver_result_t* out) {
+    int efd, rc;
+
+    if (!coro_running() || (efd = eventfd(0, EFD_CLOEXEC)) < 0)
+        return resolver_lookup(hostname, port, out);
+    while ((rc = resolver_lookup_async(hostname, port, out, efd)) == RESOLVER_PENDING) {
+        struct pollfd pfd = { .fd = efd, .events = POLLIN };
+        uint64_t count;
+
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            break; // 알림을 못 기다리면 fd를 닫을 수 없음 (조회 스레드가 쓸 것) ==> 아래에서 남겨 둠
+        if (pfd.revents && read(efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            break;
+    }
+    if (rc == RESOLVER_PENDING)
+        return EAI_SYSTEM;
+    close(efd);
+    return rc;
+}
+
+/**
+ * resolver_open_clientfd - open_clientfd와 같지만 이름 조회는 캐시에서, 연결은 resolver_connect로
+ * 모든 주소로 연결이 실패하면 캐시된 주소를 버림.
+ *
+ * @return 연결된 소켓, -2 이름 조회 실패, -1 연결 실패 (errno)
+ */
+int resolver_open_clientfd(char* hostname, char* port) {
+    resolver_result_t res;
+    int clientfd;
+
+    if (lookup_for_connect(hostname, port, &res) != 0)
+        return -2;
+    if ((clientfd = resolver_connect(&res)) < 0) {
+        int saved = errno;
+        resolver_forget(hostname, port);
+        errno = saved;
+    }
+    return clientfd;
+}
+
+/**
+ * resolver_print_stats - 조회 캐시 통계
+ *   - 절약한 시간 추정: 히트 수 * getaddrinfo 평균 시간 (합류한 쪽은 조회만큼 기다렸으므로 호출 수만 줄임)
+ */
+void resolver_print_stats(void) {
+    pthread_mutex_lock(&resolver.lock);
+    double avg_us = resolver.lookups ? resolver.lookup_ns / 1000.0 / resolver.lookups : 0.0;
+    printf("Resolver: %lu hits (%lu negative), %lu lookups (avg %.1f us), %lu coalesced, ~%.1f ms saved\n",
+           resolver.hits, resolver.negative_hits, resolver.lookups, avg_us, resolver.coalesced,
+           resolver.hits * avg_us / 1000.0);
+    printf("Connect: %lu won by a fallback address, %lu timed out\n", resolver.fallback_wins, resolver.connect_timeouts);
+    pthread_mutex_unlock(&resolver.lock);
+}
@@ -0,0 +1,44 @@
+#ifndef __RESOLVER_H__
+#define __RESOLVER_H__
+
+#include "csapp.h"
+
+#include <time.h>
+
+#define RESOLVER_BUCKETS 61 // 해시 버킷 수 (소수)
+#define RESOLVER_MAX_ENTRIES 512 // 넘으면 만료된 것부터, 그래도 꽉 차면 가장 빨리 만료될 것을 퇴출
+#define RESOLVER_MAX_ADDRS 8 // 이름 하나당 보관할 최대 주소 수 (getaddrinfo 결과 앞에서부터)
+#define RESOLVER_KEY_LEN 272 // host:port 최대 길이
+
+// getaddrinfo는 DNS 레코드의 TTL을 알려주지 않으므로 고정 TTL 사용 (초)
+#define RESOLVER_POSITIVE_TTL 60
+#define RESOLVER_NEGATIVE_TTL 5 // 없는 이름(EAI_NONAME 등)을 다시 묻지 않는 시간
+
+#define RESOLVER_CONNECT_TIMEOUT_MS 5000 // resolver_connect 전체 제한 시간 기본값 (PROXY_CONNECT_TIMEOUT_MS로 변경)
+#define RESOLVER_ATTEMPT_DELAY_MS 250 // 다음 주소로 연결 시도를 띄우기 전 기다리는 시간 (RFC 8305 권장값)
+
+#define RESOLVER_PENDING 1 // resolver_lookup_async: 조회 중 ==> notify_fd로 알림이 옴
+
+// 연결에 필요한 주소 하나 (addrinfo에서 복사 - 포인터가 없어 구조체째 복사 가능)
+typedef struct {
+    int family;
+    int socktype;
+    int protocol;
+    socklen_t addrlen;
+    struct sockaddr_storage addr;
+} resolver_addr_t;
+
+typedef struct {
+    int count;
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+} resolver_result_t;
+
+int resolver_lookup(const char* hostname, const char* port, resolver_result_t* out);
+int resolver_lookup_async(const char* hostname, const char* port, resolver_result_t* out, int notify_fd);
+void resolver_forget(const char* hostname, const char* port);
+void resolver_set_connect_timeout(int timeout_ms);
+int resolver_connect(const resolver_result_t* res);
+int resolver_open_clientfd(char* hostname, char* port);
+void resolver_print_stats(void);
+
+#endif
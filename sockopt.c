@@ -0,0 +1,125 @@
+/**
+ * sockopt.c - 리스너와 오리진 소켓에 거는 TCP 옵션 한 곳에서 관리
+ *   - 리스너: TFO, DEFER_ACCEPT + 연결별 옵션 (accept된 소켓이 리스너에서 물려받음 ==> accept마다 setsockopt 안 함)
+ *   - 오리진: connect 전에 연결별 옵션 (+ 켜져 있으면 TFO_CONNECT)
+ *   - 연결별 옵션: TCP_NODELAY, TCP_NOTSENT_LOWAT, SO_SNDBUF/SO_RCVBUF
+ */
+#include "sockopt.h"
+
+static sockopt_config_t config = {
+    .nodelay = SOCKOPT_NODELAY,
+    .fastopen_qlen = SOCKOPT_FASTOPEN_QLEN,
+    .fastopen_connect = SOCKOPT_FASTOPEN_CONNECT,
+    .defer_accept = SOCKOPT_DEFER_ACCEPT,
+    .notsent_lowat = SOCKOPT_NOTSENT_LOWAT,
+    .sndbuf = SOCKOPT_SNDBUF,
+    .rcvbuf = SOCKOPT_RCVBUF,
+};
+
+static void env_int(const char* name, int* value) {
+    const char* s = getenv(name);
+    if (s && *s)
+        *value = atoi(s);
+}
+
+/**
+ * sockopt_load_env - 환경 변수로 기본값 덮어쓰기 (소켓을 만들기 전에 한 번)
+ *   PROXY_TCP_NODELAY, PROXY_TCP_FASTOPEN(큐 길이), PROXY_TCP_FASTOPEN_CONNECT, PROXY_TCP_DEFER_ACCEPT(초),
+ *   PROXY_TCP_NOTSENT_LOWAT(바이트), PROXY_SO_SNDBUF, PROXY_SO_RCVBUF (바이트) - 0이면 끔 / 커널 기본
+ */
+void sockopt_load_env(void) {
+    env_int("PROXY_TCP_NODELAY", &config.nodelay);
+    env_int("PROXY_TCP_FASTOPEN", &config.fastopen_qlen);
+    env_int("PROXY_TCP_FASTOPEN_CONNECT", &config.fastopen_connect);
+    env_int("PROXY_TCP_DEFER_ACCEPT", &config.defer_accept);
+    env_int("PROXY_TCP_NOTSENT_LOWAT", &config.notsent_lowat);
+    env_int("PROXY_SO_SNDBUF", &config.sndbuf);
+    env_int("PROXY_SO_RCVBUF", &config.rcvbuf);
+}
+
+/* 실패해도 연결은 되므로 경고만 (옵션이 없는 커널일 수 있음) */
+static void set_int(int fd, int level, int opt, int value, const char* name) {
+    if (setsockopt(fd, level, opt, &value, sizeof(value)) < 0)
+        fprintf(stderr, "sockopt: %s=%d failed: %s\n", name, value, strerror(errno));
+}
+
+/**
+ * apply_connection_opts - 연결 하나에 거는 옵션 (버퍼 크기는 윈도 스케일이 정해지는 SYN 전에 걸어야 함)
+ */
+static void apply_connection_opts(int fd) {
+    if (config.nodelay)
+        set_int(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    if (config.notsent_lowat > 0)
+        set_int(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, config.notsent_lowat, "TCP_NOTSENT_LOWAT");
+    if (config.sndbuf > 0)
+        set_int(fd, SOL_SOCKET, SO_SNDBUF, config.sndbuf, "SO_SNDBUF");
+    if (config.rcvbuf > 0)
+        set_int(fd, SOL_SOCKET, SO_RCVBUF, config.rcvbuf, "SO_RCVBUF");
+}
+
+/**
+ * sockopt_apply_listener - 리스너 옵션. accept된 소켓은 NODELAY, NOTSENT_LOWAT, 버퍼 크기를 리스너에서 물려받음.
+ */
+void sockopt_apply_listener(int listenfd) {
+    apply_connection_opts(listenfd);
+    if (config.fastopen_qlen > 0)
+        set_int(listenfd, IPPROTO_TCP, TCP_FASTOPEN, config.fastopen_qlen, "TCP_FASTOPEN");
+    if (config.defer_accept > 0)
+        set_int(listenfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, config.defer_accept, "TCP_DEFER_ACCEPT");
+}
+
+/**
+ * sockopt_apply_origin - 오리진으로 connect 하기 직전의 소켓에
+ * TFO_CONNECT가 켜져 있으면 쿠키가 있는 오리진에는 SYN이 첫 write(요청)와 함께 나감 ==> 1 RTT 절약.
+ */
+void sockopt_apply_origin(int fd) {
+    apply_connection_opts(fd);
+    if (config.fastopen_connect)
+        set_int(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT");
+}
+
+static int get_int(int fd, int level, int opt) {
+    int value = -1;
+    socklen_t len = sizeof(value);
+    if (getsockopt(fd, level, opt, &value, &len) < 0)
+        return -1;
+    return value;
+}
+
+/**
+ * sockopt_print_config - 시작할 때 실제로 적용된 값을 출력 (커널이 되읽어 준 값 - SO_*BUF는 커널이 2배로 잡음)
+ * 오리진 쪽은 임시 소켓에 걸어 보고 되읽음. TFO는 net.ipv4.tcp_fastopen 비트(1 클라이언트, 2 서버)도 같이.
+ */
+void sockopt_print_config(int listenfd) {
+    int probe = socket(AF_INET, SOCK_STREAM, 0);
+    int sysctl_tfo = -1;
+    FILE* fp = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+
+    if (fp) {
+        if (fscanf(fp, "%d", &sysctl_tfo) != 1)
+            sysctl_tfo = -1;
+        fclose(fp);
+    }
+    if (probe >= 0)
+        sockopt_apply_origin(probe);
+
+    printf("====== Socket Options ======\n");
+    printf("Listener: TCP_NODELAY %d, TCP_FASTOPEN qlen %d, TCP_DEFER_ACCEPT %ds, TCP_NOTSENT_LOWAT %d, SO_SNDBUF %d, SO_RCVBUF %d\n",
+           get_int(listenfd, IPPROTO_TCP, TCP_NODELAY), get_int(listenfd, IPPROTO_TCP, TCP_FASTOPEN),
+           get_int(listenfd, IPPROTO_TCP, TCP_DEFER_ACCEPT), get_int(listenfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT),
+           get_int(listenfd, SOL_SOCKET, SO_SNDBUF), get_int(listenfd, SOL_SOCKET, SO_RCVBUF));
+    if (probe >= 0) {
+        printf("Origin: TCP_NODELAY %d, TCP_FASTOPEN_CONNECT %d, TCP_NOTSENT_LOWAT %d, SO_SNDBUF %d, SO_RCVBUF %d\n",
+               get_int(probe, IPPROTO_TCP, TCP_NODELAY), get_int(probe, IPPROTO_TCP, TCP_FASTOPEN_CONNECT),
+               get_int(probe, IPPROTO_TCP, TCP_NOTSENT_LOWAT), get_int(probe, SOL_SOCKET, SO_SNDBUF),
+               get_int(probe, SOL_SOCKET, SO_RCVBUF));
+        close(probe);
+    }
+    printf("net.ipv4.tcp_fastopen = %d", sysctl_tfo);
+    if (config.fastopen_qlen > 0 && sysctl_tfo >= 0 && !(sysctl_tfo & 2))
+        printf(" (server bit off - listener TFO inactive)");
+    if (config.fastopen_connect && sysctl_tfo >= 0 && !(sysctl_tfo & 1))
+        printf(" (client bit off - origin TFO inactive)");
+    printf("\n============================\n");
+    fflush(stdout); // 로그로 리다이렉트돼도 시작할 때 바로 보이게
+}
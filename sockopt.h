@@ -0,0 +1,32 @@
+#ifndef __SOCKOPT_H__
+#define __SOCKOPT_H__
+
+#include "csapp.h"
+
+#include <netinet/tcp.h>
+
+// 기본값 - 각각 환경 변수로 바꿀 수 있음 (sockopt_load_env)
+#define SOCKOPT_NODELAY 1 // 응답은 이미 writev로 모아 보냄 ==> 마지막 조각을 Nagle로 붙잡을 이유가 없음
+#define SOCKOPT_FASTOPEN_QLEN 16 // 리스너 TFO 대기 큐 길이 (0이면 끔)
+#define SOCKOPT_FASTOPEN_CONNECT 0 // 오리진 쪽 TFO - 켜면 connect가 첫 write까지 미뤄져 Happy Eyeballs 경쟁이 무의미해짐
+#define SOCKOPT_DEFER_ACCEPT 1 // 요청 바이트가 올 때까지 accept를 미룸 (초, 0이면 끔)
+#define SOCKOPT_NOTSENT_LOWAT (128<<10) // 아직 안 보낸 바이트가 이보다 적을 때만 쓰기 가능 (0이면 커널 기본)
+#define SOCKOPT_SNDBUF 0 // 0이면 커널 자동 조절 (직접 정하면 자동 조절이 꺼짐)
+#define SOCKOPT_RCVBUF 0
+
+typedef struct {
+    int nodelay; // TCP_NODELAY
+    int fastopen_qlen; // 리스너 TCP_FASTOPEN
+    int fastopen_connect; // 오리진 TCP_FASTOPEN_CONNECT
+    int defer_accept; // 리스너 TCP_DEFER_ACCEPT (초)
+    int notsent_lowat; // TCP_NOTSENT_LOWAT (바이트)
+    int sndbuf; // SO_SNDBUF (바이트)
+    int rcvbuf; // SO_RCVBUF (바이트)
+} sockopt_config_t;
+
+void sockopt_load_env(void);
+void sockopt_apply_listener(int listenfd);
+void sockopt_apply_origin(int fd);
+void sockopt_print_config(int listenfd);
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * happy_eyeballs_test.c - resolver_connect가 응답 없는 주소 패밀리를 버리고 다른 패밀리로 넘어가는지 확인
+ *   - 응답 없는(블랙홀) 주소: accept 큐가 꽉 찬 루프백 리스너. 커널이 SYN을 버리므로 connect가
+ *     원격의 라우팅 안 되는 주소처럼 끝나지 않음 (진짜 사설/폐기 주소는 경로가 없는 환경에서 바로
+ *     ENETUNREACH로 실패해서 시도 간격을 시험하지 못함)
+ *   - 한 패밀리(IPv6 ::1 / IPv4 127.0.0.1)를 블랙홀로, 다른 패밀리를 정상 리스너로 두고
+ *     RESOLVER_ATTEMPT_DELAY_MS 뒤 곧바로 넘어가는지 시간을 잼
+ *
+ * 빌드/실행: make check
+ */
+#include "resolver.h"
+
+#include <poll.h>
+
+#define HE_SLACK_MS 150 // 시도 간격 뒤 연결이 끝나기까지 허용하는 여유
+#define HE_FILLERS 8 // accept 큐를 채우는 연결 수 상한
+
+static int failures;
+
+static long now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static void expect(int cond, const char* what) {
+    printf("%s - %s\n", cond ? "ok" : "FAIL", what);
+    if (!cond)
+        ++failures;
+}
+
+/**
+ * loopback_addr - family의 루프백 주소 (port 0 ==> bind가 고름)
+ */
+static void loopback_addr(int family, resolver_addr_t* a) {
+    memset(a, 0, sizeof(*a));
+    a->family = family;
+    a->socktype = SOCK_STREAM;
+    a->protocol = IPPROTO_TCP;
+    if (family == AF_INET6) {
+        struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&a->addr;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = in6addr_loopback;
+        a->addrlen = sizeof(*sin6);
+    } else {
+        struct sockaddr_in* sin = (struct sockaddr_in*)&a->addr;
+        sin->sin_family = AF_INET;
+        sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a->addrlen = sizeof(*sin);
+    }
+}
+
+static int addr_port(const resolver_addr_t* a) {
+    if (a->family == AF_INET6)
+        return ntohs(((const struct sockaddr_in6*)&a->addr)->sin6_port);
+    return ntohs(((const struct sockaddr_in*)&a->addr)->sin_port);
+}
+
+/**
+ * open_listener - family의 루프백에 리스너를 열고 실제 주소를 a에 채움
+ * @param listen_too 0이면 bind만 하고 닫음 ==> 그 포트로 오는 연결은 바로 거절 (RST)
+ */
+static int open_listener(int family, int backlog, int listen_too, resolver_addr_t* a) {
+    int fd = Socket(family, SOCK_STREAM, 0);
+    int one = 1;
+
+    if (family == AF_INET6)
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+    loopback_addr(family, a);
+    if (bind(fd, (SA*)&a->addr, a->addrlen) < 0)
+        unix_error("open_listener: bind error");
+    getsockname(fd, (SA*)&a->addr, &a->addrlen);
+    if (!listen_too) {
+        Close(fd);
+        return -1;
+    }
+    Listen(fd, backlog);
+    return fd;
+}
+
+/**
+ * open_blackhole - SYN에 답하지 않는 주소를 만듦 (backlog 0 리스너를 accept 없이 채움)
+ * 연결 하나가 50ms 넘게 끝나지 않으면 그때부터 들어오는 SYN은 버려지는 것.
+ * @return 리스너 fd (채운 연결들은 fillers에, 끝나면 닫을 것)
+ */
+static int open_blackhole(int family, resolver_addr_t* a, int* fillers) {
+    int fd = open_listener(family, 0, 1, a);
+
+    for (int i = 0; i < HE_FILLERS; ++i) {
+        struct pollfd pfd;
+
+        fillers[i] = Socket(family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (connect(fillers[i], (SA*)&a->addr, a->addrlen) == 0)
+            continue;
+        pfd.fd = fillers[i];
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, 50) == 0)
+            return fd; // 이 연결이 매달림 ==> 큐가 꽉 참
+    }
+    app_error("open_blackhole: accept queue never filled");
+    return -1;
+}
+
+static void close_all(int listenfd, int* fillers) {
+    Close(listenfd);
+    for (int i = 0; i < HE_FILLERS; ++i)
+        if (fillers[i] >= 0)
+            Close(fillers[i]);
+}
+
+/**
+ * race - res로 연결하고 걸린 시간과 붙은 주소를 돌려줌
+ * @return resolver_connect 반환값
+ */
+static int race(const resolver_result_t* res, long* elapsed_ms, resolver_addr_t* peer) {
+    long start = now_ms();
+    int fd = resolver_connect(res);
+
+    *elapsed_ms = now_ms() - start;
+    if (fd >= 0) {
+        peer->addrlen = sizeof(peer->addr);
+        getpeername(fd, (SA*)&peer->addr, &peer->addrlen);
+        peer->family = peer->addr.ss_family;
+        Close(fd);
+    }
+    return fd;
+}
+
+/**
+ * fallback_from_blackhole - dead 패밀리를 블랙홀로, 다른 패밀리를 정상으로 두고 넘어가는지 확인
+ */
+static void fallback_from_blackhole(int dead, int live) {
+    resolver_result_t res = { .count = 2 };
+    resolver_addr_t peer;
+    int fillers[HE_FILLERS], hole, listenfd, fd;
+    long elapsed;
+    char what[MAXLINE];
+
+    memset(fillers, -1, sizeof(fillers));
+    hole = open_blackhole(dead, &res.addrs[0], fillers);
+    listenfd = open_listener(live, LISTENQ, 1, &res.addrs[1]);
+
+    fd = race(&res, &elapsed, &peer);
+    snprintf(what, sizeof(what), "%s unroutable: connected over %s in %ld ms (attempt delay %d ms)",
+             dead == AF_INET6 ? "IPv6" : "IPv4", live == AF_INET6 ? "IPv6" : "IPv4", elapsed, RESOLVER_ATTEMPT_DELAY_MS);
+    expect(fd >= 0 && peer.family == live && addr_port(&peer) == addr_port(&res.addrs[1]), what);
+    expect(elapsed >= RESOLVER_ATTEMPT_DELAY_MS - 10, "  the first family was really tried first (blackhole held)");
+    expect(elapsed < RESOLVER_ATTEMPT_DELAY_MS + HE_SLACK_MS, "  fallback started within the attempt delay");
+
+    Close(listenfd);
+    close_all(hole, fillers);
+}
+
+/**
+ * fallback_from_refused - 첫 주소가 바로 거절하면 시도 간격을 기다리지 않고 넘어가는지 확인
+ */
+static void fallback_from_refused(void) {
+    resolver_result_t res = { .count = 2 };
+    resolver_addr_t peer;
+    int listenfd, fd;
+    long elapsed;
+
+    open_listener(AF_INET6, 0, 0, &res.addrs[0]);
+    listenfd = open_listener(AF_INET, LISTENQ, 1, &res.addrs[1]);
+    fd = race(&res, &elapsed, &peer);
+    expect(fd >= 0 && peer.family == AF_INET && elapsed < RESOLVER_ATTEMPT_DELAY_MS / 2,
+           "refused first address: next address starts without waiting");
+    Close(listenfd);
+}
+
+/**
+ * timeout_on_blackhole_only - 블랙홀뿐이면 전체 제한 시간에 ETIMEDOUT
+ */
+static void timeout_on_blackhole_only(void) {
+    resolver_result_t res = { .count = 1 };
+    resolver_addr_t peer;
+    int fillers[HE_FILLERS], hole, fd;
+    long elapsed;
+
+    memset(fillers, -1, sizeof(fillers));
+    hole = open_blackhole(AF_INET, &res.addrs[0], fillers);
+    resolver_set_connect_timeout(300);
+    fd = race(&res, &elapsed, &peer);
+    expect(fd < 0 && errno == ETIMEDOUT && elapsed >= 290 && elapsed < 300 + HE_SLACK_MS,
+           "blackhole only: gives up with ETIMEDOUT at the connect timeout");
+    resolver_set_connect_timeout(0);
+    close_all(hole, fillers);
+}
+
+int main(void) {
+    fallback_from_blackhole(AF_INET6, AF_INET);
+    fallback_from_blackhole(AF_INET, AF_INET6);
+    fallback_from_refused();
+    timeout_on_blackhole_only();
+
+    printf("%s\n", failures ? "happy_eyeballs_test: FAILED" : "happy_eyeballs_test: all passed");
+    return failures != 0;
+}
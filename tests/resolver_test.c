@@ -0,0 +1,243 @@
+/**
+ * resolver_test.c - 리졸버 캐시의 히트, TTL 만료, 네거티브 캐시, 비블로킹 경로, 동시 조회 합치기 확인
+ *   - 내부 통계(coalesced)를 보려고 resolver.c를 통째로 포함함
+ *   - getaddrinfo는 -Wl,--wrap으로 가로채서 hosts 파일 픽스처(tests/hosts.fixture)에서 이름을 찾음
+ *     (DNS나 /etc/hosts와 무관하게 결과가 고정, 호출 수를 셀 수 있음)
+ *   - clock_gettime도 가로채서 시계를 앞으로 돌림 ==> TTL(60초/5초)을 실제로 기다리지 않음
+ *   - 코루틴 안의 캐시 미스가 스케줄러를 멈추지 않는지 (같은 스케줄러의 다른 코루틴이 그동안 도는지)
+ *
+ * 빌드/실행: make check
+ * 사용: tests/resolver_test <hosts 파일>
+ */
+#include "resolver.c"
+
+#include <sys/eventfd.h>
+
+int __real_getaddrinfo(const char* node, const char* service, const struct addrinfo* hints, struct addrinfo** res);
+int __real_clock_gettime(clockid_t clk, struct timespec* ts);
+
+static const char* hosts_path;
+static int gai_calls; // 실제로 조회한 횟수 (캐시가 막아줬으면 그대로) - 조회 스레드에서도 올리므로 __sync
+static int gai_delay_ms; // 조회마다 이만큼 끌어서 동시에 들어온 조회가 겹치게 함
+static int gai_force_rc; // 0이 아니면 이름과 무관하게 이 값으로 실패 (EAI_SYSTEM ==> fd 고갈 흉내)
+static time_t clock_skew; // 시계를 앞으로 돌린 초
+static int failures;
+
+/**
+ * __wrap_getaddrinfo - hosts 파일에서 node와 같은 이름의 주소를 순서대로 모아 돌려줌
+ * 주소마다 숫자 주소로 진짜 getaddrinfo를 불러 이어 붙임 (glibc freeaddrinfo는 노드를 하나씩 풀므로 안전)
+ */
+int __wrap_getaddrinfo(const char* node, const char* service, const struct addrinfo* hints, struct addrinfo** res) {
+    char line[MAXLINE], addr[MAXLINE], name[MAXLINE];
+    struct addrinfo numeric = *hints, *head = NULL, **tail = &head;
+    FILE* fp;
+
+    __sync_fetch_and_add(&gai_calls, 1);
+    if (gai_delay_ms)
+        usleep(gai_delay_ms * 1000);
+    if (gai_force_rc) {
+        errno = EMFILE;
+        return gai_force_rc;
+    }
+    numeric.ai_flags = (hints->ai_flags & ~AI_ADDRCONFIG) | AI_NUMERICHOST;
+    if ((fp = fopen(hosts_path, "r")) == NULL)
+        return EAI_SYSTEM;
+    while (fgets(line, sizeof(line), fp)) {
+        char* p = line;
+        int n;
+
+        if (line[0] == '#' || sscanf(p, "%s%n", addr, &n) != 1)
+            continue;
+        for (p += n; sscanf(p, "%s%n", name, &n) == 1; p += n) {
+            if (strcasecmp(name, node) == 0 && __real_getaddrinfo(addr, service, &numeric, tail) == 0) {
+                while (*tail)
+                    tail = &(*tail)->ai_next;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    if (head == NULL)
+        return EAI_NONAME;
+    *res = head;
+    return 0;
+}
+
+int __wrap_clock_gettime(clockid_t clk, struct timespec* ts) {
+    int rc = __real_clock_gettime(clk, ts);
+
+    ts->tv_sec += clock_skew;
+    return rc;
+}
+
+static void expect(int cond, const char* what) {
+    printf("%s - %s\n", cond ? "ok" : "FAIL", what);
+    if (!cond)
+        ++failures;
+}
+
+/**
+ * lookup - 이름 하나를 조회하고 그 사이 getaddrinfo가 불렸는지 알려줌
+ * @return resolver_lookup 반환값
+ */
+static int lookup(const char* host, resolver_result_t* res, int* called) {
+    int before = gai_calls;
+    int rc = resolver_lookup(host, "80", res);
+
+    *called = gai_calls != before;
+    return rc;
+}
+
+/**
+ * wait_notify - 비동기 조회가 끝났다는 알림을 기다려 읽음
+ * @return 2초 안에 왔으면 1
+ */
+static int wait_notify(int efd) {
+    struct pollfd pfd = { .fd = efd, .events = POLLIN };
+    uint64_t count;
+
+    return poll(&pfd, 1, 2000) == 1 && read(efd, &count, sizeof(count)) == sizeof(count);
+}
+
+static volatile int coro_ticks, coro_lookup_rc = -1, coro_ticks_during_lookup;
+
+static void coro_lookup(void* arg) {
+    resolver_result_t res;
+
+    coro_lookup_rc = lookup_for_connect("coro.test", "80", &res);
+    coro_ticks_during_lookup = coro_ticks;
+}
+
+static void coro_ticker(void* arg) {
+    while (coro_lookup_rc < 0) {
+        ++coro_ticks;
+        coro_sleep(10);
+    }
+}
+
+static void* lookup_thread(void* arg) {
+    resolver_result_t res;
+
+    return (void*)(long)resolver_lookup(arg, "80", &res);
+}
+
+int main(int argc, char** argv) {
+    resolver_result_t res, res2;
+    int rc, rc2, called, before, efd, efd2;
+    unsigned long coalesced;
+    pthread_t t1, t2;
+    void *r1, *r2;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <hosts file>\n", argv[0]);
+        exit(1);
+    }
+    hosts_path = argv[1];
+
+    /* 긍정 캐시 */
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && res.count == 1 && res.addrs[0].family == AF_INET && called, "first lookup resolves from the hosts file");
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && res.count == 1 && !called, "second lookup is a cache hit");
+    rc = lookup("ORIGIN.TEST", &res, &called);
+    expect(rc == 0 && !called, "names are matched case-insensitively");
+    rc = lookup("dual.test", &res, &called);
+    expect(rc == 0 && res.count == 2 && res.addrs[0].family == AF_INET6 && res.addrs[1].family == AF_INET,
+           "every address of a name is kept, in order");
+
+    /* 네거티브 캐시 */
+    rc = lookup("missing.test", &res, &called);
+    expect(rc == EAI_NONAME && called, "unknown name fails with EAI_NONAME");
+    rc = lookup("missing.test", &res, &called);
+    expect(rc == EAI_NONAME && !called, "failure is cached");
+
+    /* TTL 만료 */
+    clock_skew += RESOLVER_NEGATIVE_TTL + 1;
+    rc = lookup("missing.test", &res, &called);
+    expect(rc == EAI_NONAME && called, "negative entry expires after RESOLVER_NEGATIVE_TTL");
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && !called, "positive entry outlives the negative TTL");
+    clock_skew += RESOLVER_POSITIVE_TTL;
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && called, "positive entry expires after RESOLVER_POSITIVE_TTL");
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && !called, "refreshed entry is a hit again");
+
+    /* 잊기 */
+    resolver_forget("origin.test", "80");
+    rc = lookup("origin.test", &res, &called);
+    expect(rc == 0 && called, "resolver_forget drops the entry");
+    rc = lookup("other.test", &res, &called);
+    expect(rc == 0 && called && ((struct sockaddr_in*)&res.addrs[0].addr)->sin_addr.s_addr == htonl(0x7f000002),
+           "distinct names get distinct entries");
+
+    /* 비블로킹 경로 */
+    efd = eventfd(0, EFD_CLOEXEC);
+    efd2 = eventfd(0, EFD_CLOEXEC);
+    before = gai_calls;
+    rc = resolver_lookup_async("async.test", "80", &res, efd);
+    expect(rc == RESOLVER_PENDING, "async miss returns RESOLVER_PENDING");
+    expect(wait_notify(efd), "eventfd fires when the lookup finishes");
+    rc = resolver_lookup_async("async.test", "80", &res, efd);
+    expect(rc == 0 && res.count == 1 && gai_calls == before + 1, "repeat async call after the eventfd is a cache hit");
+
+    /* 동시 조회 합치기 */
+    gai_delay_ms = 100;
+    before = gai_calls;
+    coalesced = resolver.coalesced;
+    Pthread_create(&t1, NULL, lookup_thread, "slow.test");
+    usleep(20000);
+    Pthread_create(&t2, NULL, lookup_thread, "slow.test");
+    Pthread_join(t1, &r1);
+    Pthread_join(t2, &r2);
+    expect(r1 == NULL && r2 == NULL && gai_calls == before + 1 && resolver.coalesced == coalesced + 1,
+           "two parallel blocking lookups share one getaddrinfo");
+    clock_skew += RESOLVER_POSITIVE_TTL + 1;
+    before = gai_calls;
+    coalesced = resolver.coalesced;
+    rc = resolver_lookup_async("slow.test", "80", &res, efd);
+    rc2 = resolver_lookup_async("slow.test", "80", &res2, efd2);
+    expect(rc == RESOLVER_PENDING && rc2 == RESOLVER_PENDING && wait_notify(efd) && wait_notify(efd2),
+           "both async waiters of one lookup are notified");
+    expect(gai_calls == before + 1 && resolver.coalesced == coalesced + 1, "  and the lookup ran once");
+    gai_delay_ms = 0;
+
+    /* 이름과 무관한 실패 (EMFILE 같은 EAI_SYSTEM) - 캐시하지 않지만 알림을 받은 쪽은 받아 감 */
+    gai_force_rc = EAI_SYSTEM;
+    rc = lookup("flaky.test", &res, &called);
+    expect(rc == EAI_SYSTEM && called, "blocking lookup reports EAI_SYSTEM");
+    rc = lookup("flaky.test", &res, &called);
+    expect(rc == EAI_SYSTEM && called, "  and does not cache it");
+    before = gai_calls;
+    rc = resolver_lookup_async("flaky.test", "80", &res, efd);
+    rc2 = resolver_lookup_async("flaky.test", "80", &res2, efd2);
+    expect(rc == RESOLVER_PENDING && rc2 == RESOLVER_PENDING && wait_notify(efd) && wait_notify(efd2),
+           "async lookup that fails still notifies");
+    gai_force_rc = 0;
+    rc = resolver_lookup_async("flaky.test", "80", &res, efd);
+    rc2 = resolver_lookup_async("flaky.test", "80", &res2, efd2);
+    expect(rc == EAI_SYSTEM && rc2 == EAI_SYSTEM && gai_calls == before + 1,
+           "each notified waiter gets the EAI_SYSTEM on its next call (no endless RESOLVER_PENDING)");
+    rc = resolver_lookup_async("flaky.test", "80", &res, efd);
+    expect(rc == RESOLVER_PENDING && wait_notify(efd), "after that the failure is forgotten and the name is looked up again");
+    rc = resolver_lookup_async("flaky.test", "80", &res, efd);
+    expect(rc == 0 && res.count == 1 && gai_calls == before + 2, "  and the new result is cached");
+    Close(efd);
+    Close(efd2);
+
+    /* 코루틴 안의 캐시 미스: 조회(200ms) 동안 같은 스케줄러의 다른 코루틴이 계속 돌아야 함 */
+    gai_delay_ms = 200;
+    before = gai_calls;
+    coro_start(1, 0);
+    coro_submit(coro_lookup, NULL);
+    coro_submit(coro_ticker, NULL);
+    while (coro_lookup_rc < 0)
+        usleep(10000);
+    expect(coro_lookup_rc == 0 && gai_calls == before + 1 && coro_ticks_during_lookup >= 5,
+           "a miss inside a coroutine does not stall its scheduler");
+    gai_delay_ms = 0;
+
+    resolver_print_stats();
+    printf("%s\n", failures ? "resolver_test: FAILED" : "resolver_test: all passed");
+    return failures != 0;
+}
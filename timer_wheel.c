@@ -0,0 +1,165 @@
+/**
+ * timer_wheel.c - 연결 타임아웃용 계층형 타이머 휠 (Varghese & Lauck, 리눅스 커널의 옛 타이머와 같은 구조)
+ *   - 단계 L의 슬롯 하나는 64^L 틱 구간. 타이머는 남은 시간에 맞는 단계의 슬롯 리스트에 들어감.
+ *   - 등록/취소 O(1): 슬롯 계산 + 이중 연결 리스트 연결/해제. 연결이 10만 개여도 정렬이나 힙 없음.
+ *   - 매 틱 0단계 슬롯 하나만 처리. 0단계가 한 바퀴 돌면 윗단계 슬롯 하나를 아래로 다시 나눠 넣음 (cascade).
+ * 타이머 스레드 하나가 TIMER_TICK_MS마다 깨어 만료된 타이머의 콜백을 부름.
+ */
+#include "timer_wheel.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define TIMER_MAX_TICKS ((1ul << (TIMER_LEVEL_BITS * TIMER_LEVELS)) - 1)
+
+static struct {
+    pthread_mutex_t lock;
+    unsigned long next; // 다음에 처리할 틱
+    timer_node_t slots[TIMER_LEVELS][TIMER_SLOTS]; // 리스트 머리 (센티널)
+    int started;
+} wheel = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static unsigned long now_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000ul + ts.tv_nsec / 1000000) / TIMER_TICK_MS;
+}
+
+/* 이하 _unmanaged 함수는 wheel.lock을 잡은 상태에서만 호출 */
+
+static void list_add_unmanaged(timer_node_t* head, timer_node_t* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void list_del_unmanaged(timer_node_t* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+}
+
+/**
+ * enqueue_unmanaged - 남은 틱 수에 맞는 단계의 슬롯에 넣음 (이미 지난 시각이면 다음 틱)
+ */
+static void enqueue_unmanaged(timer_node_t* timer) {
+    unsigned long expires = timer->expires;
+    unsigned long delta;
+    int level;
+
+    if ((long)(expires - wheel.next) < 0)
+        expires = timer->expires = wheel.next;
+    delta = expires - wheel.next;
+    if (delta > TIMER_MAX_TICKS)
+        expires = timer->expires = wheel.next + TIMER_MAX_TICKS;
+    for (level = 0; level < TIMER_LEVELS - 1; ++level)
+        if (delta < 1ul << (TIMER_LEVEL_BITS * (level + 1)))
+            break;
+    list_add_unmanaged(&wheel.slots[level][(expires >> (TIMER_LEVEL_BITS * level)) & TIMER_MASK], timer);
+}
+
+/**
+ * cascade_unmanaged - 윗단계 슬롯 하나를 비우며 아래 단계로 다시 넣음
+ * @return 그 슬롯 번호 (0이면 그 단계도 한 바퀴 돈 것 ==> 한 단계 더 위를 cascade)
+ */
+static int cascade_unmanaged(int level) {
+    int idx = (wheel.next >> (TIMER_LEVEL_BITS * level)) & TIMER_MASK;
+    timer_node_t* head = &wheel.slots[level][idx];
+
+    while (head->next != head) {
+        timer_node_t* timer = head->next;
+        list_del_unmanaged(timer);
+        enqueue_unmanaged(timer);
+    }
+    return idx;
+}
+
+/**
+ * tick_unmanaged - wheel.next 틱 하나를 처리 (필요하면 cascade 후, 0단계 슬롯의 타이머를 모두 만료)
+ */
+static void tick_unmanaged(void) {
+    int idx = wheel.next & TIMER_MASK;
+    timer_node_t* head = &wheel.slots[0][idx];
+
+    for (int level = 1; idx == 0 && level < TIMER_LEVELS; ++level)
+        idx = cascade_unmanaged(level);
+    ++wheel.next;
+
+    while (head->next != head) {
+        timer_node_t* timer = head->next;
+        list_del_unmanaged(timer);
+        timer->fn(timer->arg); // 휠 락을 잡은 채 ==> 콜백 안에서 timer_add/timer_cancel 금지
+    }
+}
+
+static void* timer_thread(void* unused) {
+    pthread_detach(pthread_self());
+    while (1) {
+        struct timespec ts = { 0, TIMER_TICK_MS * 1000000l };
+        nanosleep(&ts, NULL);
+
+        unsigned long now = now_ticks();
+        pthread_mutex_lock(&wheel.lock);
+        while ((long)(now - wheel.next) >= 0) // 늦게 깨어났으면 밀린 틱을 모두 처리
+            tick_unmanaged();
+        pthread_mutex_unlock(&wheel.lock);
+    }
+    return NULL;
+}
+
+/**
+ * timer_wheel_start - 슬롯 초기화 + 타이머 스레드 시작 (프로세스에서 한 번, 타이머를 걸기 전에)
+ */
+void timer_wheel_start(void) {
+    pthread_t tid;
+
+    pthread_mutex_lock(&wheel.lock);
+    if (!wheel.started) {
+        for (int l = 0; l < TIMER_LEVELS; ++l)
+            for (int s = 0; s < TIMER_SLOTS; ++s)
+                wheel.slots[l][s].next = wheel.slots[l][s].prev = &wheel.slots[l][s];
+        wheel.next = now_ticks();
+        wheel.started = 1;
+        if (pthread_create(&tid, NULL, timer_thread, NULL) != 0)
+            posix_error(errno, "timer_wheel_start: pthread_create error");
+    }
+    pthread_mutex_unlock(&wheel.lock);
+}
+
+void timer_init(timer_node_t* timer, void (*fn)(void*), void* arg) {
+    timer->next = timer->prev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+/**
+ * timer_add - timeout_ms 뒤에 만료되도록 걺. 이미 걸려 있으면 새 시각으로 옮김 (유휴 타이머 갱신).
+ */
+void timer_add(timer_node_t* timer, long timeout_ms) {
+    unsigned long ticks = (timeout_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+
+    pthread_mutex_lock(&wheel.lock);
+    if (timer->next)
+        list_del_unmanaged(timer);
+    timer->expires = now_ticks() + (ticks ? ticks : 1);
+    enqueue_unmanaged(timer);
+    pthread_mutex_unlock(&wheel.lock);
+}
+
+/**
+ * timer_cancel - 타이머를 뗌. 콜백은 휠 락 안에서 돌기 때문에, 돌아온 뒤에는 콜백이 돌고 있지도 않고
+ * 앞으로 불리지도 않음 ==> 콜백이 쓰는 자원(fd 등)을 이제 정리해도 안전.
+ * @return 걸려 있었으면 1, 이미 만료됐거나 안 걸려 있었으면 0
+ */
+int timer_cancel(timer_node_t* timer) {
+    int pending;
+
+    pthread_mutex_lock(&wheel.lock);
+    pending = timer->next != NULL;
+    if (pending)
+        list_del_unmanaged(timer);
+    pthread_mutex_unlock(&wheel.lock);
+    return pending;
+}
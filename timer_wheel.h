@@ -0,0 +1,28 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include "csapp.h"
+
+#define TIMER_TICK_MS 100 // 해상도 - 타임아웃은 이 단위로 올림
+#define TIMER_LEVEL_BITS 6
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS) // 단계당 슬롯 수
+#define TIMER_LEVELS 4 // 64^4 틱 = 약 19일까지 (넘으면 최대값으로 자름)
+
+/**
+ * 타이머 하나 - 보통 연결 구조체 안에 들어 있음 (따로 할당하지 않음)
+ * 만료되면 fn(arg)를 타이머 스레드에서 휠 락을 잡은 채로 부름 ==> 짧게 (shutdown 정도).
+ */
+typedef struct timer_node {
+    struct timer_node* next; // 슬롯의 이중 원형 리스트 (NULL이면 걸려 있지 않음)
+    struct timer_node* prev;
+    unsigned long expires; // 만료 틱
+    void (*fn)(void* arg);
+    void* arg;
+} timer_node_t;
+
+void timer_wheel_start(void);
+void timer_init(timer_node_t* timer, void (*fn)(void*), void* arg);
+void timer_add(timer_node_t* timer, long timeout_ms);
+int timer_cancel(timer_node_t* timer);
+
+#endif
@@ -154,30 +154,30 @@ int parse_uri(char* uri, char* filename, char* cgiargs){
  */
 void serve_static(int fd, char* filename, int filesize){
   int srcfd;
-  char* srcp, filetype[MAXLINE], buf[MAXBUF];
+  char* srcp, filetype[MAXLINE];
+  wio_t wio;
 
-  // 리스폰스 헤더를 준비
+  // 리스폰스 헤더를 준비 (쓰기 버퍼에 모아둠 - 아직 송신 안 함)
   get_filetype(filename, filetype);
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-  sprintf(buf, "%sConnection: close\r\n", buf);
-  sprintf(buf, "%sContent-length: %d\r\n", buf, filesize);
-  sprintf(buf, "%sContent-type: %s\r\n\r\n", buf, filetype);
-  
-  // 클라이언트에게 리스폰스 헤더를 송신
-  Rio_writen(fd, buf, strlen(buf));
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_printfb(&wio, "Connection: close\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n", filesize);
+  Wio_printfb(&wio, "Content-type: %s\r\n\r\n", filetype);
 
   // 헤더 출력 (디버깅)
   printf("Response headers:\n");
-  printf("%s", buf);
+  printf("%.*s", wio.wio_cnt, wio.wio_buf);
 
   // 리스폰스 보디를 준비
   srcfd = Open(filename, O_RDONLY, 0); // 해당 파일을 읽기 전용으로 `open()`.
   srcp = Mmap(0, filesize, PROT_READ, MAP_PRIVATE, srcfd, 0); // 가상메모리에 매핑 ("파일의 이 구간은 이 가상 주소와 대응된다")
   Close(srcfd);
   
-  // 리스폰스 보디를 송신
-  Rio_writen(fd, srcp, filesize); //  매핑된 주소들에 실제 접근 시 page fault가 나면서 디스크를 거침
+  // 리스폰스 헤더 + 보디를 writev 한 번으로 송신
+  Wio_writeb(&wio, srcp, filesize); //  매핑된 주소들에 실제 접근 시 page fault가 나면서 디스크를 거침
+  Wio_flushb(&wio);
 
   // 송신 후 메모리 매핑 해제
   Munmap(srcp, filesize);
@@ -188,22 +188,24 @@ void serve_static(int fd, char* filename, int filesize){
  */
 void serve_static_head(int fd, char* filename, int filesize){
   int srcfd;
-  char* srcp, filetype[MAXLINE], buf[MAXBUF];
+  char* srcp, filetype[MAXLINE];
+  wio_t wio;
 
   // 리스폰스 헤더를 준비
   get_filetype(filename, filetype);
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-  sprintf(buf, "%sConnection: close\r\n", buf);
-  sprintf(buf, "%sContent-length: %d\r\n", buf, filesize);
-  sprintf(buf, "%sContent-type: %s\r\n\r\n", buf, filetype);
-  
-  // 클라이언트에게 리스폰스 헤더를 송신
-  Rio_writen(fd, buf, strlen(buf));
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_printfb(&wio, "Connection: close\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n", filesize);
+  Wio_printfb(&wio, "Content-type: %s\r\n\r\n", filetype);
 
   // 헤더 출력 (디버깅)
   printf("Response headers:\n");
-  printf("%s", buf);
+  printf("%.*s", wio.wio_cnt, wio.wio_buf);
+
+  // 클라이언트에게 리스폰스 헤더를 송신
+  Wio_flushb(&wio);
 
   // // 리스폰스 보디를 준비
   // srcfd = Open(filename, O_RDONLY, 0); // 해당 파일을 읽기 전용으로 `open()`.
@@ -223,13 +225,13 @@ void serve_static_head(int fd, char* filename, int filesize){
  *   - char* cgiargs는 URI에서 파싱된 쿼리 문자열. 예: num1=3&num2=5
  */
 void serve_dynamic(int fd, char* filename, char* cgiargs){
-  char buf[MAXLINE];
   char* emptylist[] = {NULL};
+  wio_t wio;
 
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Server: Tiny Web Server\r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_flushmoreb(&wio); // 나머지 헤더와 본문은 CGI가 바로 씀 ==> 같은 세그먼트로 묶이도록 MSG_MORE
 
   printf("cgiargs: %s\n", cgiargs);
 
@@ -246,13 +248,13 @@ void serve_dynamic(int fd, char* filename, char* cgiargs){
 }
 
 void serve_dynamic_head(int fd, char* filename, char* cgiargs){
-  char buf[MAXLINE];
   char* emptylist[] = {NULL};
+  wio_t wio;
 
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Server: Tiny Web Server\r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_flushb(&wio);
 
   printf("cgiargs: %s\n", cgiargs);
 
@@ -273,29 +275,30 @@ void serve_dynamic_head(int fd, char* filename, char* cgiargs){
  */
 void serve_static_revised(int fd, char* filename, int filesize) {
   int srcfd;
-  char filetype[MAXLINE], buf[MAXBUF];
+  char filetype[MAXLINE];
   char readbuf[8192];  // 8KB씩 버퍼에 읽어 소켓에 전송
   ssize_t n;
+  wio_t wio;
 
   // 리스폰스 헤더를 준비
   get_filetype(filename, filetype);
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf + strlen(buf), "Server: Tiny Web Server\r\n");
-  sprintf(buf + strlen(buf), "Connection: close\r\n");
-  sprintf(buf + strlen(buf), "Content-length: %d\r\n", filesize);
-  sprintf(buf + strlen(buf), "Content-type: %s\r\n\r\n", filetype);
-
-  // 클라이언트에게 리스폰스 헤더를 송신
-  Rio_writen(fd, buf, strlen(buf));
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_printfb(&wio, "Connection: close\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n", filesize);
+  Wio_printfb(&wio, "Content-type: %s\r\n\r\n", filetype);
 
-  // printf("Response headers:\n%s", buf);
+  // 헤더는 쓰기 버퍼에 남겨 두고 본문 첫 블록과 함께 보냄
+  // printf("Response headers:\n%.*s", wio.wio_cnt, wio.wio_buf);
 
   // 리스폰스 보디를 준비, 파일 열기
   srcfd = Open(filename, O_RDONLY, 0);
 
   // read + write 루프로 본문 전송
   while ((n = read(srcfd, readbuf, sizeof(readbuf))) > 0) 
-    Rio_writen(fd, readbuf, n);
+    Wio_writeb(&wio, readbuf, n);
+  Wio_flushb(&wio);
   
   // 끝났으니 파일 닫기
   Close(srcfd);
@@ -307,20 +310,22 @@ void serve_static_revised(int fd, char* filename, int filesize) {
 void serve_static_splice(int fd, char* filename, int filesize) {
   int srcfd;
   int pipefd[2];
-  char filetype[MAXLINE], buf[MAXBUF];
+  char filetype[MAXLINE];
   ssize_t n;
+  wio_t wio;
 
   // 1. Content-Type 및 응답 헤더 구성
   get_filetype(filename, filetype);
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf + strlen(buf), "Server: Tiny Web Server\r\n");
-  sprintf(buf + strlen(buf), "Connection: close\r\n");
-  sprintf(buf + strlen(buf), "Content-length: %d\r\n", filesize);
-  sprintf(buf + strlen(buf), "Content-type: %s\r\n\r\n", filetype);
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 200 OK\r\n");
+  Wio_printfb(&wio, "Server: Tiny Web Server\r\n");
+  Wio_printfb(&wio, "Connection: close\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n", filesize);
+  Wio_printfb(&wio, "Content-type: %s\r\n\r\n", filetype);
 
-  // 2. 응답 헤더 전송
-  Rio_writen(fd, buf, strlen(buf));
-  printf("Response headers:\n%s", buf);
+  // 2. 응답 헤더 전송 (MSG_MORE - 뒤따르는 splice 본문과 같은 세그먼트로)
+  printf("Response headers:\n%.*s", wio.wio_cnt, wio.wio_buf);
+  Wio_flushmoreb(&wio);
 
   // 3. 정적 파일 열기
   srcfd = Open(filename, O_RDONLY, 0);
@@ -389,7 +394,8 @@ void get_filetype(char* filename, char* filetype){
  *        - longmsg: 장문 설명
  */
 void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longmsg ){
-  char buf[MAXLINE], body[MAXBUF];
+  char body[MAXBUF];
+  wio_t wio;
   
   // HTTP response body를 만듦
   /* 이때, printf vs. fprintf vs. sprintf?
@@ -401,12 +407,11 @@ void clienterror(int fd, char* cause, char* errnum, char* shortmsg, char* longms
   sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
   sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
 
-  /* Print the HTTP response */
-  sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf)); // 클라이언트의 소켓에 전송. 클라이언트는 여기서부터 실제 HTML 콘텐츠를 렌더링하게 됨.
-  sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-  Rio_writen(fd, buf, strlen(buf));
-  Rio_writen(fd, body, strlen(body));
+  /* Print the HTTP response - 헤더와 본문을 쓰기 버퍼에 모았다가 한 번에 */
+  Wio_writeinitb(&wio, fd);
+  Wio_printfb(&wio, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
+  Wio_printfb(&wio, "Content-type: text/html\r\n");
+  Wio_printfb(&wio, "Content-length: %d\r\n\r\n", (int)strlen(body));
+  Wio_writeb(&wio, body, strlen(body));
+  Wio_flushb(&wio); // 클라이언트의 소켓에 전송. 클라이언트는 여기서부터 실제 HTML 콘텐츠를 렌더링하게 됨.
 }
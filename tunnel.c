@@ -0,0 +1,319 @@
+/**
+ * tunnel.c - CONNECT 터널을 소수의 릴레이 스레드가 epoll로 한꺼번에 중계
+ *   - 연결 스레드는 오리진 연결 + 200 응답까지만 하고 두 fd를 넘긴 뒤 끝남 ==> 터널마다 스레드(스택)를 붙잡지 않음.
+ *   - 엣지 트리거: 두 fd 중 어느 쪽 이벤트든 터널 전체를 펌프 (양방향으로 EAGAIN까지 읽고 씀).
+ *   - 역압: 받는 쪽이 꽉 차면 못 보낸 나머지만 pending에 두고 보내는 쪽은 더 읽지 않음 ==> 커널 버퍼가 흐름 제어.
+ *   - half-close: 한쪽 EOF는 다른 쪽에 SHUT_WR로 전달, 양방향이 다 끝나면 닫음.
+ * splice는 쓰지 않음: 터널마다 파이프 두 개(fd 4개 + 파이프 버퍼)가 필요해서 유휴 터널을 가볍게 하려는 목적과 반대.
+ */
+#include "tunnel.h"
+#include "timer_wheel.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+// 한 방향 (src에서 읽어 dst로) - 못 보낸 나머지가 있을 때만 pending을 할당
+typedef struct {
+    int src;
+    int dst;
+    char* pending; // dst가 아직 받지 못한 바이트 (NULL이면 없음)
+    int pending_off;
+    int pending_len;
+    int eof; // src에서 EOF ==> pending을 다 보내면 dst에 SHUT_WR
+    int done; // SHUT_WR까지 보냄
+} tunnel_dir_t;
+
+struct relay;
+
+/* 터널 하나 - 유휴일 때는 이 구조체(수백 바이트)가 전부 */
+typedef struct tunnel {
+    int fds[2]; // 0 클라이언트, 1 오리진
+    tunnel_dir_t dirs[2]; // 0 클라이언트 ==> 오리진, 1 오리진 ==> 클라이언트
+    struct relay* relay; // 맡은 릴레이 스레드
+    struct tunnel* next; // 넘겨받기 대기열 / 해제 대기 리스트
+    int closed; // 닫았음 (같은 epoll_wait 묶음의 남은 이벤트는 무시, 묶음이 끝나면 해제)
+    int idle_ms;
+    int expired; // 유휴 타임아웃 (타이머 콜백이 씀, timer_cancel 뒤에 읽음)
+    timer_node_t idle;
+} tunnel_t;
+
+typedef struct relay {
+    int epfd;
+    int wakefd; // eventfd - 새 터널이 대기열에 들어왔음 (epoll data.ptr == NULL)
+    pthread_mutex_t lock; // incoming
+    tunnel_t* incoming; // 연결 스레드가 넘긴 터널 (등록은 릴레이 스레드가 직접)
+    tunnel_t* dead; // 이번 묶음에서 닫은 터널
+} relay_t;
+
+static struct {
+    relay_t* relays;
+    int count;
+    unsigned long next; // 라운드 로빈
+    // 통계 (__sync로 갱신)
+    unsigned long opened;
+    unsigned long active;
+    unsigned long bytes;
+    unsigned long stalls; // 받는 쪽이 꽉 차서 pending을 잡은 횟수
+    unsigned long idle_timeouts;
+} tunnels;
+
+#define TUNNEL_EVENTS (EPOLLIN | EPOLLOUT | EPOLLET)
+
+/* 타이머 콜백 (휠 락 안) - shutdown만 하면 릴레이 스레드가 EOF/오류를 보고 정리 */
+static void tunnel_idle_expired(void* arg) {
+    tunnel_t* t = arg;
+    t->expired = 1;
+    shutdown(t->fds[0], SHUT_RDWR);
+    shutdown(t->fds[1], SHUT_RDWR);
+}
+
+/**
+ * tunnel_close - fd를 닫고 해제 대기 리스트로 (같은 묶음에 이 터널의 이벤트가 더 있을 수 있어서 바로 Free하지 않음)
+ */
+static void tunnel_close(tunnel_t* t) {
+    timer_cancel(&t->idle); // 돌아온 뒤에는 콜백이 fd를 건드리지 않음
+    if (t->expired) {
+        __sync_fetch_and_add(&tunnels.idle_timeouts, 1);
+        fprintf(stderr, "tunnel idle timeout - connection dropped\n");
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (t->dirs[i].pending)
+            Free(t->dirs[i].pending);
+        Close(t->fds[i]); // epoll에서도 빠짐
+    }
+    t->closed = 1;
+    t->next = t->relay->dead;
+    t->relay->dead = t;
+    __sync_fetch_and_sub(&tunnels.active, 1);
+}
+
+/**
+ * send_some - 논블로킹 fd에 EAGAIN까지 씀
+ * @return 보낸 바이트 수 (len보다 작으면 꽉 찬 것), 오류면 -1
+ */
+static ssize_t send_some(int fd, const char* p, size_t len) {
+    size_t off = 0;
+
+    while (off < len) {
+        ssize_t n = send(fd, p + off, len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n < 0)
+            return -1;
+        off += n;
+    }
+    return off;
+}
+
+/**
+ * pump_dir - 한 방향: pending부터 비우고, 그다음 src를 EAGAIN(또는 상한)까지 읽어 dst로
+ * @return 옮긴 바이트 수, 오류면 -1
+ */
+static long pump_dir(tunnel_t* t, tunnel_dir_t* d, char* buf) {
+    long moved = 0;
+    ssize_t n, w;
+
+    if (d->pending) {
+        if ((w = send_some(d->dst, d->pending + d->pending_off, d->pending_len)) < 0)
+            return -1;
+        d->pending_off += w;
+        d->pending_len -= w;
+        moved += w;
+        if (d->pending_len > 0)
+            return moved; // 아직 꽉 참 ==> dst의 EPOLLOUT을 기다림
+        Free(d->pending);
+        d->pending = NULL;
+    }
+
+    while (!d->eof && moved < TUNNEL_PUMP_LIMIT) {
+        n = read(d->src, buf, TUNNEL_READ_SIZE);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n < 0)
+            return -1;
+        if (n == 0) {
+            d->eof = 1;
+            break;
+        }
+        if ((w = send_some(d->dst, buf, n)) < 0)
+            return -1;
+        moved += w;
+        if (w < n) { // 역압 - 나머지만 들고 src는 그만 읽음
+            d->pending_len = n - w;
+            d->pending_off = 0;
+            d->pending = Malloc(d->pending_len);
+            memcpy(d->pending, buf + w, d->pending_len);
+            __sync_fetch_and_add(&tunnels.stalls, 1);
+            return moved;
+        }
+    }
+
+    if (!d->eof && moved >= TUNNEL_PUMP_LIMIT) {
+        // 상한에서 멈춤 ==> 엣지가 새로 안 올 수 있으니 MOD로 다시 걸어 다음 epoll_wait에 이벤트가 오게
+        struct epoll_event ev = { .events = TUNNEL_EVENTS, .data.ptr = t };
+        epoll_ctl(t->relay->epfd, EPOLL_CTL_MOD, d->src, &ev);
+    }
+    if (d->eof && !d->done) { // half-close 전달 (pending은 위에서 비었음)
+        shutdown(d->dst, SHUT_WR);
+        d->done = 1;
+    }
+    return moved;
+}
+
+static void tunnel_pump(tunnel_t* t, char* buf) {
+    long moved = 0, n;
+
+    for (int i = 0; i < 2; ++i) {
+        if ((n = pump_dir(t, &t->dirs[i], buf)) < 0) {
+            tunnel_close(t);
+            return;
+        }
+        moved += n;
+    }
+    if (t->dirs[0].done && t->dirs[1].done) {
+        tunnel_close(t);
+        return;
+    }
+    if (moved > 0) {
+        __sync_fetch_and_add(&tunnels.bytes, moved);
+        if (t->idle_ms > 0)
+            timer_add(&t->idle, t->idle_ms);
+    }
+}
+
+/**
+ * relay_take_incoming - 대기열의 터널을 이 스레드의 epoll에 등록 (등록 직후 준비된 쪽은 바로 이벤트가 옴)
+ */
+static void relay_take_incoming(relay_t* relay) {
+    uint64_t count;
+    tunnel_t* list;
+
+    if (read(relay->wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        unix_error("relay_take_incoming: eventfd read error");
+    pthread_mutex_lock(&relay->lock);
+    list = relay->incoming;
+    relay->incoming = NULL;
+    pthread_mutex_unlock(&relay->lock);
+
+    while (list) {
+        tunnel_t* t = list;
+        list = t->next;
+        t->next = NULL;
+        for (int i = 0; i < 2; ++i) {
+            struct epoll_event ev = { .events = TUNNEL_EVENTS, .data.ptr = t };
+            if (epoll_ctl(relay->epfd, EPOLL_CTL_ADD, t->fds[i], &ev) < 0) {
+                fprintf(stderr, "tunnel: epoll_ctl ADD failed: %s\n", strerror(errno));
+                tunnel_close(t);
+                break;
+            }
+        }
+    }
+}
+
+static void* relay_thread(void* arg) {
+    relay_t* relay = arg;
+    struct epoll_event events[TUNNEL_MAX_EVENTS];
+    char buf[TUNNEL_READ_SIZE];
+
+    pthread_detach(pthread_self());
+    while (1) {
+        int n = epoll_wait(relay->epfd, events, TUNNEL_MAX_EVENTS, -1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            unix_error("relay_thread: epoll_wait error");
+
+        for (int i = 0; i < n; ++i) {
+            tunnel_t* t = events[i].data.ptr;
+            if (t == NULL)
+                relay_take_incoming(relay);
+            else if (!t->closed)
+                tunnel_pump(t, buf);
+        }
+        while (relay->dead) {
+            tunnel_t* t = relay->dead;
+            relay->dead = t->next;
+            Free(t);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * tunnel_start - 릴레이 스레드 nthreads개 시작 (0이면 안 띄움 ==> tunnel_submit이 -1)
+ */
+void tunnel_start(int nthreads) {
+    pthread_t tid;
+
+    if (nthreads <= 0)
+        return;
+    tunnels.relays = Calloc(nthreads, sizeof(relay_t));
+    for (int i = 0; i < nthreads; ++i) {
+        relay_t* relay = &tunnels.relays[i];
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+
+        if ((relay->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            unix_error("tunnel_start: epoll_create1 error");
+        if ((relay->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            unix_error("tunnel_start: eventfd error");
+        if (epoll_ctl(relay->epfd, EPOLL_CTL_ADD, relay->wakefd, &ev) < 0)
+            unix_error("tunnel_start: epoll_ctl error");
+        pthread_mutex_init(&relay->lock, NULL);
+        if (pthread_create(&tid, NULL, relay_thread, relay) != 0)
+            posix_error(errno, "tunnel_start: pthread_create error");
+    }
+    tunnels.count = nthreads;
+}
+
+/**
+ * tunnel_submit - 연결된 터널의 두 fd를 릴레이 스레드에 넘김 (200 응답은 이미 보낸 뒤)
+ * 넘긴 뒤에는 릴레이 스레드가 fd를 닫음 ==> 호출한 쪽은 두 fd를 더 쓰지도 닫지도 말 것.
+ * @param idle_ms: 양방향 모두 진행이 없으면 끊는 시간 (0이면 끔)
+ * @return 넘겼으면 0, 릴레이 스레드가 없으면 -1 (fd는 그대로 호출한 쪽 소유)
+ */
+int tunnel_submit(int clientfd, int serverfd, int idle_ms) {
+    tunnel_t* t;
+    relay_t* relay;
+    uint64_t one = 1;
+
+    if (tunnels.count == 0)
+        return -1;
+
+    t = Calloc(1, sizeof(tunnel_t));
+    t->fds[0] = clientfd;
+    t->fds[1] = serverfd;
+    t->dirs[0].src = t->dirs[1].dst = clientfd;
+    t->dirs[0].dst = t->dirs[1].src = serverfd;
+    t->idle_ms = idle_ms;
+    for (int i = 0; i < 2; ++i)
+        fcntl(t->fds[i], F_SETFL, fcntl(t->fds[i], F_GETFL) | O_NONBLOCK);
+    timer_init(&t->idle, tunnel_idle_expired, t);
+    if (idle_ms > 0)
+        timer_add(&t->idle, idle_ms);
+
+    relay = &tunnels.relays[__sync_fetch_and_add(&tunnels.next, 1) % tunnels.count];
+    t->relay = relay;
+    __sync_fetch_and_add(&tunnels.opened, 1);
+    __sync_fetch_and_add(&tunnels.active, 1);
+
+    pthread_mutex_lock(&relay->lock);
+    t->next = relay->incoming;
+    relay->incoming = t;
+    pthread_mutex_unlock(&relay->lock);
+    if (write(relay->wakefd, &one, sizeof(one)) < 0)
+        unix_error("tunnel_submit: eventfd write error");
+    return 0;
+}
+
+/**
+ * tunnel_print_stats - 터널 통계
+ */
+void tunnel_print_stats(void) {
+    printf("Tunnel: %d relay threads, %lu opened, %lu active, %.1f MB relayed, %lu backpressure stalls, %lu idle timeouts\n",
+           tunnels.count, tunnels.opened, tunnels.active, tunnels.bytes / 1048576.0, tunnels.stalls,
+           tunnels.idle_timeouts);
+}
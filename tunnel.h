@@ -0,0 +1,15 @@
+#ifndef __TUNNEL_H__
+#define __TUNNEL_H__
+
+#include "csapp.h"
+
+#define TUNNEL_RELAY_THREADS 2 // 기본 릴레이 스레드 수 (PROXY_TUNNEL_THREADS, 0이면 예전처럼 연결 스레드가 직접 중계)
+#define TUNNEL_READ_SIZE (16<<10) // 릴레이 스레드가 한 번에 읽는 양 (스레드당 버퍼 하나 - 터널마다 두지 않음)
+#define TUNNEL_PUMP_LIMIT (256<<10) // 한 번 깨어날 때 한 방향으로 옮기는 최대 바이트 (다른 터널도 차례가 오게)
+#define TUNNEL_MAX_EVENTS 128 // epoll_wait 한 번에 받는 이벤트 수
+
+void tunnel_start(int nthreads);
+int tunnel_submit(int clientfd, int serverfd, int idle_ms);
+void tunnel_print_stats(void);
+
+#endif